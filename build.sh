@@ -2,7 +2,8 @@
 
 
 export CC=gcc
-# nan boxing slower on linux??? 
+# nan boxing (-DBLAZINGLY_FAST) is within code layout noise of the tagged union here,
+# test/values.lox times both
 export CCF="-Ofast -flto -DOBJSTR_FLEXIBLE_ARR -Wall -Wextra -Wpedantic"
 export LDF="-flto"
 
@@ -23,12 +23,62 @@ void Clox_Init(Clox_t *clox, size_t allocator_capacity)
     VM_Init(&clox->vm, &clox->alloc);
     clox->err = CLOX_NOERR;
     clox->use_jit = false;
+    clox->flags = 0;
+    clox->snapshot = NULL;
+    clox->snapshot_size = 0;
+    clox->script_mark = NULL;
+}
+
+
+void Clox_InitArena(Clox_t* clox, size_t allocator_capacity, bool collect_garbage)
+{
+    Allocator_InitArena(&clox->alloc, allocator_capacity);
+    VM_Init(&clox->vm, &clox->alloc);
+    clox->err = CLOX_NOERR;
+    clox->flags = CLOX_FLAG_ARENA;
+    clox->snapshot = NULL;
+    clox->snapshot_size = 0;
+    clox->script_mark = NULL;
+    if (!collect_garbage)
+        clox->vm.next_gc = SIZE_MAX;
+
+    uint8_t* vm_end = Allocator_Mark(&clox->alloc);
+    if (NULL == vm_end) /* not an arena */
+        return;
+
+    /* the vm's objects are changed by the scripts (interned strings, globals...), so they are saved too */
+    size_t state_size = VM_StateSize();
+    clox->snapshot_size = vm_end - clox->alloc.head;
+    clox->snapshot = Allocator_Alloc(&clox->alloc, state_size + clox->snapshot_size);
+    VM_SaveState(&clox->vm, clox->snapshot);
+    memcpy(clox->snapshot + state_size, clox->alloc.head, clox->snapshot_size);
+    clox->script_mark = Allocator_Mark(&clox->alloc);
+}
+
+
+void Clox_ResetArena(Clox_t* clox)
+{
+    if (NULL == clox->snapshot)
+    {
+        VM_Reset(&clox->vm);
+        return;
+    }
+
+    /* the gc's threads are the only things living outside of the arena */
+    GC_FreeThreads(&clox->vm);
+    memcpy(clox->alloc.head, clox->snapshot + VM_StateSize(), clox->snapshot_size);
+    VM_RestoreState(&clox->vm, clox->snapshot);
+    Allocator_Release(&clox->alloc, clox->script_mark);
 }
 
 
 void Clox_Free(Clox_t* clox)
 {
-    VM_Free(&clox->vm);
+    /* the objects are not freed one by one, the arena is gone with them */
+    if (NULL != clox->snapshot)
+        GC_FreeThreads(&clox->vm);
+    else
+        VM_Free(&clox->vm);
     Allocator_KillEmAll(&clox->alloc);
 }
 
@@ -55,6 +105,14 @@ void Clox_RunFile(Clox_t* clox, const char* file_path)
 }
 
 
+InterpretResult_t Clox_RunScript(Clox_t* clox, const char* src)
+{
+    InterpretResult_t ret = VM_Interpret(&clox->vm, src);
+    Clox_ResetArena(clox);
+    return ret;
+}
+
+
 void Clox_Repl(Clox_t* clox)
 {
     char line[1024] = { 0 };
@@ -72,7 +130,7 @@ void Clox_Repl(Clox_t* clox)
         }
         else if (strncmp(line, "reset\n", sizeof("reset")) == 0)
         {
-            VM_Reset(&clox->vm);
+            Clox_ResetArena(clox);
             continue;
         }
 
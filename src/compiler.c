@@ -1217,7 +1217,11 @@ static void expr_literal(Compiler_t* compiler, bool can_assign)
 static void expr_number(Compiler_t* compiler, bool can_assign)
 {
     (void)can_assign;
-    const Value_t val = NUMBER_VAL(strtod(compiler->parser.prev.start, NULL));
+    const double number = strtod(compiler->parser.prev.start, NULL);
+    /* whole numbers in range are small ints, they still behave like any other number */
+    const Value_t val = (number <= INT32_MAX && number == (int32_t)number)
+        ? INT_VAL((int32_t)number)
+        : NUMBER_VAL(number);
     emit_constant(compiler, val);
 }
 
@@ -1453,7 +1457,7 @@ static void expr_dot(Compiler_t* compiler, bool can_assign)
     else if (match(compiler, TOKEN_LEFT_PAREN))
     {
         uint8_t argc = arglist(compiler);
-        emit_bytes(compiler, 3, OP_INVOKE, name, argc);
+        emit_bytes(compiler, 4, OP_INVOKE, name, argc, 0);
     }
     else if (name <= UINT8_MAX)
     {
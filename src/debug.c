@@ -28,7 +28,7 @@ static size_t jump_instruction(FILE* fout,
 
 
 static size_t invoke_instruction(FILE* fout,
-    const char *mnemonic, const Chunk_t *chunk, size_t offset, size_t name_size
+    const char *mnemonic, const Chunk_t *chunk, size_t offset, size_t name_size, size_t cache_size
 );
 
 
@@ -193,11 +193,11 @@ size_t Disasm_Instruction(FILE* fout, const Chunk_t* chunk, size_t offset)
         break;
 
     case OP_INVOKE:
-        offset = invoke_instruction(fout, "OP_INVOKE", chunk, offset, 1);
+        offset = invoke_instruction(fout, "OP_INVOKE", chunk, offset, 1, 1);
         break;
 
     case OP_SUPER_INVOKE:
-        offset = invoke_instruction(fout, "OP_SUPER_INVOKE", chunk, offset, 1);
+        offset = invoke_instruction(fout, "OP_SUPER_INVOKE", chunk, offset, 1, 0);
         break;
 
     case OP_SET_UPVALUE:
@@ -369,7 +369,7 @@ static size_t jump_instruction(FILE* fout,
 
 
 static size_t invoke_instruction(FILE* fout,
-    const char *mnemonic, const Chunk_t *chunk, size_t offset, size_t name_size
+    const char *mnemonic, const Chunk_t *chunk, size_t offset, size_t name_size, size_t cache_size
 )
 {
     unsigned name = read_arg(chunk, offset, name_size);
@@ -378,5 +378,5 @@ static size_t invoke_instruction(FILE* fout,
     fprintf(fout, INS_FMTSTR"(%d args) %4u ", mnemonic, argc, name);
     Value_Print(fout, chunk->consts.vals[name]);
     fputc('\n', fout);
-    return offset + 1 + name_size + 1;
+    return offset + 1 + name_size + 1 + cache_size;
 }
@@ -13,6 +13,7 @@
 #define CLOX_DEFAULT_ALLOC_MEMSIZE (5 * 1024 * 1024)
 #define CLOX_FLAG_MEM ((unsigned)1 << 0)
 #define CLOX_FLAG_JIT ((unsigned)1 << 1)
+#define CLOX_FLAG_ARENA ((unsigned)1 << 2)
 
 typedef enum CloxUnixErr_t
 {
@@ -34,6 +35,11 @@ typedef struct Clox_t
     Allocator_t alloc;
     CloxUnixErr_t err;
     unsigned flags;
+
+    /* CLOX_FLAG_ARENA: the vm's state and memory right after VM_Init, kept in the arena */
+    uint8_t* snapshot;
+    size_t snapshot_size;
+    void* script_mark; /* the scripts' memory starts here */
 } Clox_t;
 
 
@@ -44,6 +50,23 @@ typedef struct Clox_t
 */
 void Clox_Init(Clox_t* clox, size_t allocator_capacity);
 
+/*
+*   initializes the Clox struct for running many short scripts:
+*   the vm allocates from an arena of allocator_capacity bytes (the memory cap),
+*   and is brought back to the state it had right after VM_Init by Clox_ResetArena,
+*   without freeing its objects one by one
+*   if collect_garbage is false, the gc never runs and the arena only ever grows until the reset
+*   NOTE: with ALLOCATOR_DEFAULT, this is Clox_Init, and Clox_ResetArena is VM_Reset
+*/
+void Clox_InitArena(Clox_t* clox, size_t allocator_capacity, bool collect_garbage);
+
+/*
+*   discards everything the scripts did in one step, 
+*   the objects they created, the globals they defined... are all gone
+*   calls VM_Reset if the Clox struct was not initialized by Clox_InitArena
+*/
+void Clox_ResetArena(Clox_t* clox);
+
 /*
 *   frees allocated memory in the Clox struct
 */
@@ -58,6 +81,11 @@ void Clox_Free(Clox_t* clox);
 */
 void Clox_RunFile(Clox_t* clox, const char* file_path);
 
+/*
+*   compile and run src, then reset the arena (see Clox_InitArena) 
+*/
+InterpretResult_t Clox_RunScript(Clox_t* clox, const char* src);
+
 /*
 *   runs clox in command line mode
 */
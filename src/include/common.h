@@ -50,6 +50,19 @@
 
 
 
+/* 
+ *  CLOX_NOINLINE keeps the rare path of a function that gets inlined into the interpreter loop out of it,
+ *  CLOX_ALWAYS_INLINE pulls in one that the compiler finds too big for it (across files only with -flto)
+ */
+#if defined(__GNUC__)
+#  define CLOX_NOINLINE __attribute__((noinline))
+#  define CLOX_ALWAYS_INLINE __attribute__((always_inline)) inline
+#else
+#  define CLOX_NOINLINE
+#  define CLOX_ALWAYS_INLINE
+#endif /* __GNUC__ */
+
+
 #define UINT8_COUNT (UINT8_MAX + 1)
 #define STATIC_ARRSZ(comptime_array) (sizeof(comptime_array) / sizeof(comptime_array[0])) 
 
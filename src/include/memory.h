@@ -10,6 +10,93 @@
 /* CLox macros */
 
 #define GC_HEAP_GROW_FACTOR 2
+/* the threshold never goes below this, a small live heap would otherwise be collected every few allocations */
+#ifndef GC_MIN_NEXT_GC
+#  define GC_MIN_NEXT_GC (1024 * 1024)
+#endif /* GC_MIN_NEXT_GC */
+
+/* 
+ * parallel marking, compile with -DGC_THREADS and link with pthread
+ *  GC_MARK_THREADS_DEFAULT: number of threads marking the heap (including the collecting thread),
+ *      can be changed at runtime through vm->gc_mark_threads, 1 means marking stays serial
+ *  GC_PARALLEL_MARK_MIN_HEAP: heaps smaller than this are marked serially,
+ *      starting the workers costs more than they would save
+ */
+#ifndef GC_MARK_THREADS_DEFAULT
+#  define GC_MARK_THREADS_DEFAULT 4
+#endif /* GC_MARK_THREADS_DEFAULT */
+#ifndef GC_PARALLEL_MARK_MIN_HEAP
+#  define GC_PARALLEL_MARK_MIN_HEAP (8 * 1024 * 1024)
+#endif /* GC_PARALLEL_MARK_MIN_HEAP */
+#define GC_MARK_THREADS_MAX 64
+
+/*
+ * background sweeping, also needs -DGC_THREADS
+ *  the pages of heaps at least GC_BACKGROUND_SWEEP_MIN_HEAP big are swept by a sweeper thread 
+ *  instead of waiting for the vm to need them, can be turned off at runtime through vm->gc_background_sweep
+ */
+#ifndef GC_BACKGROUND_SWEEP_MIN_HEAP
+#  define GC_BACKGROUND_SWEEP_MIN_HEAP (4 * 1024 * 1024)
+#endif /* GC_BACKGROUND_SWEEP_MIN_HEAP */
+
+/*
+ * the gc's heap
+ *  objects up to GC_LARGE_OBJ_SIZE bytes are rounded up to one of GC_SIZE_CLASS_COUNT sizes, 
+ *  and live in GC_PAGE_SIZE pages holding cells of a single size,
+ *  their mark bits are kept in a bitmap at the start of the page instead of in the objects, 
+ *  and the dead cells of a page are only swept when the page is needed for allocation
+ *
+ *  bigger objects are allocated on their own and kept in a list
+ */
+#ifndef GC_PAGE_SIZE
+#  define GC_PAGE_SIZE (16 * 1024) /* must be a power of 2 */
+#endif /* GC_PAGE_SIZE */
+#define GC_GRANULE 16
+#define GC_LARGE_OBJ_SIZE 512
+#define GC_SIZE_CLASS_COUNT 16
+#define GC_PAGE_BITMAP_WORDS (GC_PAGE_SIZE / GC_GRANULE / 64)
+
+/*
+ * object pools
+ *  the objects allocated the most (bound methods, upvalues, closures and short strings) 
+ *  get pages of their own instead of sharing the size class of their size,
+ *  a page keeps the cells freed by sweeping in a free list that allocation takes from first
+ */
+#define GC_POOL_COUNT 4
+#define GC_CLASS_COUNT (GC_SIZE_CLASS_COUNT + GC_POOL_COUNT)
+
+typedef struct GCHeap_t
+{
+    struct {
+        GCPage_t* pages;
+        GCPage_t* tail;
+        GCPage_t* alloc; /* allocations are served from this page on, the ones after it might not be swept yet */
+    } classes[GC_CLASS_COUNT]; /* the size classes, then the pools */
+    GCLargeObj_t* large;
+    size_t page_count;
+    size_t freed_bufs; /* buffers given back to the allocator since the last defrag, the pools give back none */
+
+    /* 
+     * what the dead objects own is only known once they are swept, 
+     * next_gc is guessed from the last collection and corrected once every page is swept 
+     */
+    bool unswept;
+    size_t bytes_at_gc;
+    size_t dead_at_gc;
+    size_t swept_bytes;
+    double owned_ratio; /* bytes owned per byte of dead cells */
+} GCHeap_t;
+
+/*
+ * compaction, only with the built-in allocator
+ *  live objects and the buffers they own are slid towards the start of the allocator's region,
+ *  done at a safe point (at the end of VM_Interpret) once the allocator's fragmentation 
+ *  (1 - biggest free block / free memory) reaches GC_COMPACT_FRAGMENTATION,
+ *  can be turned off at runtime through vm->gc_compact
+ */
+#ifndef GC_COMPACT_FRAGMENTATION
+#  define GC_COMPACT_FRAGMENTATION 0.5
+#endif /* GC_COMPACT_FRAGMENTATION */
 
 #define ALLOCATE(p_vm, type, nbytes)\
 	GC_Reallocate(p_vm, NULL, 0, sizeof(type) * nbytes)
@@ -44,6 +131,11 @@ typedef struct Allocator_t
 	bufsize_t capacity;
 	FreeHeader_t* free_head;
     bool auto_defrag;
+    uint8_t* top; /* arena mode when not NULL, the next buffer is bumped from here */
+#ifdef GC_THREADS
+    FreeHeader_t* pending; /* freed by other threads, moved to free_head by the owner on its next alloc */
+    GCSweeper_t* sweeper; /* the background sweeper freeing into pending, waited for before running out of memory */
+#endif /* GC_THREADS */
 } Allocator_t;
 
 /* 
@@ -53,6 +145,20 @@ typedef struct Allocator_t
  */
 void Allocator_Init(Allocator_t* allocator, bufsize_t capacity);
 
+/* 
+ *   initializes the allocator in arena mode: buffers are bumped off the start of its memory,
+ *   freeing a buffer gives nothing back unless it is the last one allocated, 
+ *   everything allocated after a mark is given back at once with Allocator_Release
+ *   NOTE: with ALLOCATOR_DEFAULT, this is the same as Allocator_Init
+ */
+void Allocator_InitArena(Allocator_t* allocator, bufsize_t capacity);
+
+/* \returns a mark to pass to Allocator_Release, NULL if the allocator is not in arena mode */
+void* Allocator_Mark(const Allocator_t* allocator);
+
+/* gives back every buffer allocated after the mark in one step, the buffers before it are untouched */
+void Allocator_Release(Allocator_t* allocator, void* mark);
+
 /* 
  * free ALL memory allocated by the allocator,
  * even ones that have not been passed to Allocator_Free
@@ -68,8 +174,19 @@ void Allocator_KillEmAll(Allocator_t* allocator);
 */
 void* Allocator_Alloc(Allocator_t* allocator, bufsize_t nbytes);
 
+/*
+ *   same as Allocator_Alloc, but the returned buffer's address is a multiple of alignment (a power of 2)
+ *   free it with Allocator_FreeAligned
+ */
+void* Allocator_AllocAligned(Allocator_t* allocator, bufsize_t nbytes, bufsize_t alignment);
+
+/* frees a buffer returned by Allocator_AllocAligned */
+void Allocator_FreeAligned(Allocator_t* allocator, void* ptr);
+
 /*
  *   frees a buffer returned by Allocator_Alloc or Allocator_Realloc
+ *   NOTE: when called from the gc's sweeper thread, the buffer is handed to 
+ *      the allocator's pending list instead, and reused after the owning thread's next alloc
  */
 void Allocator_Free(Allocator_t* allocator, void* ptr);
 
@@ -78,6 +195,7 @@ void Allocator_Free(Allocator_t* allocator, void* ptr);
  *   resize the buffer given by this function or Allocator_Alloc
  *   if NULL == ptr, return pointer given by Allocatro_Alloc, 
  *   if 0 == newsize, acts like Allocator_Free and returns NULL
+ *   a smaller newsize gives the buffer's tail back to the free list, the buffer stays where it is
  */
 void* Allocator_Realloc(Allocator_t* allocator, void* ptr, bufsize_t newsize);
 
@@ -99,17 +217,64 @@ void* GC_Reallocate(VM_t* vm, void* ptr, bufsize_t oldsize, bufsize_t newsize);
  */
 void GC_CollectGarbage(VM_t* vm);
 
+/* 
+ * allocates nbytes for an object of the given type (ObjType_t) in the gc's heap, may trigger a collection 
+ * the object is freed by the gc once it is no longer reachable
+ */
+Obj_t* GC_AllocateObj(VM_t* vm, bufsize_t nbytes, int type);
+
+/* \returns true if the object was reached by the last marking */
+bool GC_IsMarked(const Obj_t* obj);
+
+/* initializes an empty heap */
+void GC_InitHeap(GCHeap_t* heap);
+
+/* frees every object in the vm's heap and the heap's pages, automatically called by VM_Free */
+void GC_FreeHeap(VM_t* vm);
+
 /* mark a value as reachable */
 void GC_MarkVal(VM_t* vm, Value_t val);
 
 /* mark an object as reachable */
 void GC_MarkObj(VM_t* vm, Obj_t* obj);
 
+/* 
+ * waits for the background sweep of the last collection to finish (if there is one),
+ * automatically called by VM_Free and GC_CollectGarbage 
+ */
+void GC_FinishSweep(VM_t* vm);
 
+/* 
+ * collects garbage, then compacts the heap: 
+ * the objects of sparse pages are moved to the other pages of their size, 
+ * and the buffers the vm owns (large objects included) are slid over the free blocks of the allocator,
+ * every reference to them is updated (stack, frames, upvalues, tables, arrays, closures, functions...)
+ *
+ * the blocks of the allocator that the vm does not know about are never moved
+ * NOTE: the objects held in C variables are not updated,
+ *  so this must not be called while the vm is compiling or running (the natives included)
+ *
+ * \returns false if the heap could not be compacted (ALLOCATOR_DEFAULT, arena mode, or the vm is compiling)
+ */
+bool GC_Compact(VM_t* vm);
+
+/* calls GC_Compact if vm->gc_compact is set and the allocator is fragmented enough, same rules apply */
+bool GC_MaybeCompact(VM_t* vm);
+
+/* free the mark workers' gray stacks and the sweeper, automatically called by VM_Free */
+void GC_FreeThreads(VM_t* vm);
 
 
 
 
+
+
+/* 
+ * \returns how fragmented the free memory is, 
+ * 0 when it is all in one block, close to 1 when the biggest free block is a tiny part of it 
+ */
+double Allocator_Fragmentation(const Allocator_t* allocator);
+
 /* 
  * defragments memory manually, 
  * highly recommended to use in places that does not need to be performant
@@ -9,8 +9,43 @@
 
 Value_t Native_Clock(VM_t* vm, int argc, Value_t* argv);
 Value_t Native_ToStr(VM_t* vm, int argc, Value_t* argv);
+/* Array(), Array(n) with room for n elements, Array(n, fill) with n of fill */
 Value_t Native_Array(VM_t* vm, int argc, Value_t* argv);
 Value_t Native_ArrayCpy(VM_t* vm, int argc, Value_t* argv);
+Value_t Native_Map(VM_t* vm, int argc, Value_t* argv);
+/* Deque(), PriorityQueue() ordered by number keys, PriorityQueue(cmp) ordered by a comparator, Set() */
+Value_t Native_Deque(VM_t* vm, int argc, Value_t* argv);
+Value_t Native_PriorityQueue(VM_t* vm, int argc, Value_t* argv);
+Value_t Native_Set(VM_t* vm, int argc, Value_t* argv);
+/* PVector() and PMap() are empty, PVector(array) and PMap(map) have the elements or pairs of what they are given */
+Value_t Native_PVector(VM_t* vm, int argc, Value_t* argv);
+Value_t Native_PMap(VM_t* vm, int argc, Value_t* argv);
+
+/*
+ *  Float64Array(n) and Int32Array(n) are n zeros, stored unboxed (see ObjTypedArr_t),
+ *  sum(a), dot(a, b), min(a) and max(a) are numbers, min and max of an empty array are nil,
+ *  scale(a, factor) and add(a, b) change a in place and return it,
+ *  b is of the same kind and size as a, and any argument of the wrong type gives nil
+ */
+Value_t Native_Float64Array(VM_t* vm, int argc, Value_t* argv);
+Value_t Native_Int32Array(VM_t* vm, int argc, Value_t* argv);
+Value_t Native_Sum(VM_t* vm, int argc, Value_t* argv);
+Value_t Native_Dot(VM_t* vm, int argc, Value_t* argv);
+Value_t Native_Min(VM_t* vm, int argc, Value_t* argv);
+Value_t Native_Max(VM_t* vm, int argc, Value_t* argv);
+Value_t Native_Scale(VM_t* vm, int argc, Value_t* argv);
+Value_t Native_Add(VM_t* vm, int argc, Value_t* argv);
+
+/* 
+ *  substr(str, start, len), charAt(str, index), indexOf(str, substr), split(str, separator)
+ *  the substrings share str's characters (see ObjSlice_t), 
+ *  out of range indexes are clamped, except for charAt which gives nil, 
+ *  and any argument of the wrong type gives nil
+ */
+Value_t Native_Substr(VM_t* vm, int argc, Value_t* argv);
+Value_t Native_CharAt(VM_t* vm, int argc, Value_t* argv);
+Value_t Native_IndexOf(VM_t* vm, int argc, Value_t* argv);
+Value_t Native_Split(VM_t* vm, int argc, Value_t* argv);
 
 
 #endif /* _CLOX_NATIVES_H_ */
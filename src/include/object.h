@@ -7,6 +7,7 @@
 #include "value.h"
 #include "chunk.h"
 #include "table.h"
+#include "sort.h"
 
 
 
@@ -22,6 +23,15 @@ typedef Value_t (*NativeFn_t)(VM_t* vm, int argc, Value_t* argv);
 #define IS_INSTANCE(value)  is_objtype(value, OBJ_INSTANCE)
 #define IS_BOUND_METHOD(val)is_objtype(val, OBJ_BOUND_METHOD)
 #define IS_ARRAY(value)     is_objtype(value, OBJ_ARRAY)
+#define IS_ROPE(value)      is_objtype(value, OBJ_ROPE)
+#define IS_SLICE(value)     is_objtype(value, OBJ_SLICE)
+#define IS_MAP(value)       is_objtype(value, OBJ_MAP)
+#define IS_TYPED_ARRAY(val) is_objtype(val, OBJ_TYPED_ARRAY)
+#define IS_DEQUE(value)     is_objtype(value, OBJ_DEQUE)
+#define IS_PQUEUE(value)    is_objtype(value, OBJ_PQUEUE)
+#define IS_SET(value)       is_objtype(value, OBJ_SET)
+#define IS_PVEC(value)      is_objtype(value, OBJ_PVEC)
+#define IS_PMAP(value)      is_objtype(value, OBJ_PMAP)
 
 #define AS_STR(value)       ((ObjString_t*)AS_OBJ(value))
 #define AS_CSTR(value)      (AS_STR(value)->cstr)
@@ -32,6 +42,16 @@ typedef Value_t (*NativeFn_t)(VM_t* vm, int argc, Value_t* argv);
 #define AS_INSTANCE(value)  ((ObjInstance_t*)AS_OBJ(value))
 #define AS_BOUND_METHOD(val)((ObjBoundMethod_t*)AS_OBJ(val))
 #define AS_ARRAY(value)     ((ObjArray_t*)AS_OBJ(value))
+#define AS_ROPE(value)      ((ObjRope_t*)AS_OBJ(value))
+#define AS_SLICE(value)     ((ObjSlice_t*)AS_OBJ(value))
+#define AS_MAP(value)       ((ObjMap_t*)AS_OBJ(value))
+#define AS_TYPED_ARRAY(val) ((ObjTypedArr_t*)AS_OBJ(val))
+#define AS_DEQUE(value)     ((ObjDeque_t*)AS_OBJ(value))
+#define AS_PQUEUE(value)    ((ObjPQueue_t*)AS_OBJ(value))
+#define AS_SET(value)       ((ObjSet_t*)AS_OBJ(value))
+#define AS_PNODE(value)     ((ObjPNode_t*)AS_OBJ(value))
+#define AS_PVEC(value)      ((ObjPVec_t*)AS_OBJ(value))
+#define AS_PMAP(value)      ((ObjPMap_t*)AS_OBJ(value))
 
 
 typedef enum ObjType_t
@@ -45,13 +65,69 @@ typedef enum ObjType_t
     OBJ_INSTANCE,
     OBJ_BOUND_METHOD,
     OBJ_ARRAY,
+    OBJ_ROPE,
+    OBJ_SLICE,
+    OBJ_MAP,
+    OBJ_TYPED_ARRAY,
+    OBJ_DEQUE,
+    OBJ_PQUEUE,
+    OBJ_SET,
+    OBJ_PNODE,
+    OBJ_PVEC,
+    OBJ_PMAP,
 } ObjType_t;
+#define OBJ_TYPE_COUNT (OBJ_PMAP + 1)
 
+/*
+ * GC_COMPRESSED_REFS
+ *  the references from an object to another that has no reason to be anything else 
+ *  (closure to function and upvalues, upvalue to the next open one, bound method to method)
+ *  are 32 bits counted in 8 bytes from GC_RefBase, 0 is NULL,
+ *  every allocator must be within reach of it, see Allocator_Init
+ *
+ *  OBJREF(type) declares such a field, REF() stores a pointer in it, 
+ *  DEREF() gets back one that is known not to be NULL and DEREF_NULLABLE() one that may be
+ */
+#ifdef GC_COMPRESSED_REFS
+#  ifdef ALLOCATOR_DEFAULT
+#    error "GC_COMPRESSED_REFS needs the objects to be in the allocator's memory, ALLOCATOR_DEFAULT puts them anywhere"
+#  endif /* ALLOCATOR_DEFAULT */
+
+#  define GC_REF_SHIFT 3
+#  define GC_REF_REACH ((uint64_t)UINT32_MAX << GC_REF_SHIFT)
+
+typedef uint32_t ObjRef_t;
+extern uint8_t* GC_RefBase; /* not an integer, so that the stores of NaN boxed values can not alias it */
+
+static inline ObjRef_t obj_to_ref(const void* obj)
+{
+    return NULL == obj ? 0 : (ObjRef_t)(((const uint8_t*)obj - GC_RefBase) >> GC_REF_SHIFT);
+}
+static inline void* ref_to_obj(ObjRef_t ref)
+{
+    return GC_RefBase + ((size_t)ref << GC_REF_SHIFT);
+}
+
+#  define OBJREF(type)                  ObjRef_t
+#  define REF(obj)                      obj_to_ref(obj)
+#  define DEREF(type, ref)              ((type*)ref_to_obj(ref))
+#  define DEREF_NULLABLE(type, ref)     (0 == (ref) ? NULL : DEREF(type, ref))
+#else
+#  define OBJREF(type)                  type*
+#  define REF(obj)                      (obj)
+#  define DEREF(type, ref)              (ref)
+#  define DEREF_NULLABLE(type, ref)     (ref)
+#endif /* GC_COMPRESSED_REFS */
+
+
+/* 
+ * the header is 2 bytes, the mark bits are kept in the pages' bitmaps, 
+ * so the 4 byte fields right after it go in what used to be padding 
+ */
 struct Obj_t
 {
-    ObjType_t type;
-    bool is_marked;
-    Obj_t* next;
+    uint8_t type; /* ObjType_t */
+    bool is_large; /* allocated outside of the gc's pages, see memory.c */
 };
 
 
@@ -59,11 +135,165 @@ struct Obj_t
 
 
 
+/*
+ *  the elements of an array that only ever had numbers stored in it are packed doubles (ELEMS_NUMBERS),
+ *  which the gc does not look through, the first value of another type turns them into values 
+ *  for good (ELEMS_VALUES), see ObjArr_Set
+ *
+ *  NAN_BOXING
+ *  a double already is the value of the number, so the elements only change kind
+ */
+typedef enum ElemKind_t
+{
+    ELEMS_NUMBERS,
+    ELEMS_VALUES,
+} ElemKind_t;
+
+/*
+ *  copies and slices of ARRAY_SHARE_MIN_LEN elements or more share them until one of them is written to:
+ *  the buffer is handed to a frozen array that no script can reach, 
+ *  the arrays sharing it point into its elements from start on and keep it alive (like ObjSlice_t),
+ *  storing in, pushing onto or changing the kind of one of them copies its elements first (see ObjArr_Own),
+ *  the gc marks the frozen array's elements once however many arrays share them
+ */
+#ifndef ARRAY_SHARE_MIN_LEN
+#  define ARRAY_SHARE_MIN_LEN 16
+#endif /* ARRAY_SHARE_MIN_LEN */
+/* popping does not shrink an array's room below this many elements */
+#ifndef ARRAY_MIN_SHRINK
+#  define ARRAY_MIN_SHRINK 8
+#endif /* ARRAY_MIN_SHRINK */
 struct ObjArray_t
 {
     Obj_t obj;
 
-    ValueArr_t array;
+    uint8_t kind; /* ElemKind_t */
+    OBJREF(ObjArray_t) shared; /* NULL unless the elements are the frozen array's */
+    size_t size;
+    size_t capacity;
+    size_t start; /* of the elements within the frozen array's */
+    union {
+        double* nums;
+        Value_t* vals;
+    } as;
+};
+
+
+struct ObjMap_t
+{
+    Obj_t obj;
+
+    Map_t map;
+};
+
+
+/*
+ *  a Float64Array or an Int32Array, its numbers are not boxed in values 
+ *  but stored right after it, its size is fixed when it is created
+ */
+typedef enum TypedKind_t
+{
+    TYPED_F64,
+    TYPED_I32,
+} TypedKind_t;
+
+struct ObjTypedArr_t
+{
+    Obj_t obj;
+
+    uint8_t kind; /* TypedKind_t */
+    int len;
+    double f64[]; /* int32_t elements for TYPED_I32, see TYPED_I32() */
+};
+#define TYPED_F64(arr)      ((arr)->f64)
+#define TYPED_I32(arr)      ((int32_t*)(arr)->f64)
+
+
+/* 
+ *  a ring buffer, the i-th element from the front is vals[(head + i) & (capacity - 1)],
+ *  the capacity is 0 or a power of 2 
+ */
+struct ObjDeque_t
+{
+    Obj_t obj;
+
+    size_t head;
+    size_t count;
+    size_t capacity;
+    Value_t* vals;
+};
+
+
+/*
+ *  a binary heap with the first element on top: the one with the lowest key, 
+ *  or the first one according to cmp when the queue was made with a comparator (cmp is nil otherwise)
+ */
+typedef struct PQEntry_t
+{
+    double key; /* unused with a comparator */
+    Value_t val;
+} PQEntry_t;
+
+struct ObjPQueue_t
+{
+    Obj_t obj;
+
+    bool busy; /* while its comparator runs, which must not push or pop */
+    size_t count;
+    size_t capacity;
+    Value_t cmp;
+    PQEntry_t* entries;
+};
+
+
+/* a Map_t of the elements to nil */
+struct ObjSet_t
+{
+    Obj_t obj;
+
+    Map_t map;
+};
+
+
+/*
+ *  a node of the tries of the persistent vectors and maps (see persistent.h), 
+ *  which no script can reach, it never changes once it is filled in,
+ *  the slots are right after it, the child nodes are in them as values
+ *
+ *  a vector's node holds its elements or its child nodes,
+ *  a map's node holds the key value pairs in its datamap first, then the child nodes in its nodemap,
+ *  a map's collision node holds the pairs of keys with the same hash, one after the other
+ */
+#define PNODE_BITS 5
+#define PNODE_WIDTH (1 << PNODE_BITS)
+struct ObjPNode_t
+{
+    Obj_t obj;
+
+    bool collision;
+    uint32_t len; /* of the slots */
+    uint32_t datamap; /* a bit for each of the hash's PNODE_BITS wide parts with a pair in the node */
+    uint32_t nodemap; /* and with a child node */
+    Value_t slots[];
+};
+
+/* the elements from the tail offset on are in the tail, the rest in the trie under root */
+struct ObjPVec_t
+{
+    Obj_t obj;
+
+    uint32_t shift; /* of the index for the root's slot */
+    size_t count;
+    OBJREF(ObjPNode_t) root; /* NULL while all the elements fit in the tail */
+    OBJREF(ObjPNode_t) tail; /* NULL when empty */
+};
+
+struct ObjPMap_t
+{
+    Obj_t obj;
+
+    size_t count;
+    OBJREF(ObjPNode_t) root; /* NULL when empty */
 };
 
 
@@ -71,8 +301,50 @@ struct ObjBoundMethod_t
 {
     Obj_t obj;
 
+    OBJREF(ObjClosure_t) method;
     Value_t receiver;
-    ObjClosure_t* method;
+};
+
+
+/*
+ * a concatenation that is not copied into a string until it has to be
+ * (compared, printed, padded or turned into a string by toStr),
+ * left and right are strings or other ropes, 
+ * once flattened left is the string and right is NULL
+ *
+ * the concatenations of 2 strings shorter than ROPE_MIN_LEN are copied right away 
+ */
+#ifndef ROPE_MIN_LEN
+#  define ROPE_MIN_LEN 64
+#endif /* ROPE_MIN_LEN */
+struct ObjRope_t
+{
+    Obj_t obj;
+
+    int len;
+    int depth; /* a string is 0 deep */
+    OBJREF(Obj_t) left;
+    OBJREF(Obj_t) right;
+};
+
+
+/*
+ * a substring that shares the characters of its parent string, which it keeps alive,
+ * a slice of a slice shares the same parent, 
+ * its characters are not followed by a '\0', see ObjStr_View 
+ *
+ * substrings shorter than SLICE_MIN_LEN are copied, a slice is as big as a short string
+ */
+#ifndef SLICE_MIN_LEN
+#  define SLICE_MIN_LEN 16
+#endif /* SLICE_MIN_LEN */
+struct ObjSlice_t
+{
+    Obj_t obj;
+
+    int len;
+    int start;
+    OBJREF(ObjString_t) parent;
 };
 
 
@@ -95,6 +367,8 @@ struct ObjInstance_t
 
 
 
+/* the arity of a native that takes any number of arguments and checks argc itself */
+#define NATIVE_VARIADIC UINT8_MAX
 struct ObjNativeFn_t
 {
     Obj_t obj;
@@ -109,9 +383,9 @@ struct ObjUpval_t
 {
     Obj_t obj;
 
+    OBJREF(struct ObjUpval_t) next;
     Value_t* location;
     Value_t closed;
-    struct ObjUpval_t* next;
 };
 
 struct ObjFunction_t
@@ -128,16 +402,27 @@ struct ObjClosure_t
 {
     Obj_t obj;
 
-    ObjFunction_t* fun;
-    ObjUpval_t** upvals;
-    int upval_count; // fuck gc
+    uint16_t upval_count; // fuck gc
+    OBJREF(ObjFunction_t) fun;
+    OBJREF(ObjUpval_t) upvals[]; /* allocated with the closure */
 };
 
 
 
+/* 
+ *  only the strings in vm->strings are interned, they are the only ones usable as table keys 
+ *  and the only ones hashed up front, every other string is compared by its content
+ *  and gets its hash the first time it is used as a map key (0 until then)
+ *
+ *  HASH_RANDOM_SEED
+ *  the hash is seeded with vm->hash_seed, 0 unless compiled with -DHASH_RANDOM_SEED,
+ *  which gives each vm a different seed so that the keys colliding in a table cannot be picked in advance,
+ *  the order tables are walked in (toStr of an instance) then changes from one run to the next
+ */
 struct ObjString_t
 {
     Obj_t obj;
+    bool is_interned;
     int len;
     uint32_t hash;
 #ifdef OBJSTR_FLEXIBLE_ARR
@@ -150,7 +435,7 @@ struct ObjString_t
 
 
 /* 
- *  Free the obj pointer and the underlying object iself
+ *  Free what the object owns, the object itself belongs to the gc's heap
  */
 void Obj_Free(VM_t* vm, Obj_t* obj);
 
@@ -201,26 +486,183 @@ ObjBoundMethod_t* ObjBmd_Create(VM_t* vm, Value_t receiver, ObjClosure_t* method
  */
 ObjArray_t* ObjArr_Create(VM_t* vm);
 
+/*
+ *  Creates an array with the same elements as arr
+ */
+ObjArray_t* ObjArr_Copy(VM_t* vm, ObjArray_t* arr);
 
+/*
+ *  Creates an array of arr's elements from start up to end, which are within arr
+ */
+ObjArray_t* ObjArr_Slice(VM_t* vm, ObjArray_t* arr, size_t start, size_t end);
 
+/* gives an array that shares its elements a copy of its own */
+void ObjArr_Own(VM_t* vm, ObjArray_t* arr);
+static inline bool ObjArr_IsShared(const ObjArray_t* arr)
+{
+    return 0 != arr->shared;
+}
+
+/* makes room for extra more elements, at least twice as much as there was if it has to grow */
+void ObjArr_Reserve(VM_t* vm, ObjArray_t* arr, size_t extra);
+/* gives back the room past the last element */
+void ObjArr_ShrinkToFit(VM_t* vm, ObjArray_t* arr);
+void ObjArr_Push(VM_t* vm, ObjArray_t* arr, Value_t val);
+/* the array is not empty, half of its room is given back once it uses less than a quarter of it */
+Value_t ObjArr_Pop(VM_t* vm, ObjArray_t* arr);
+/* pushes count values, which are kept somewhere the gc sees them (like the vm's stack) */
+void ObjArr_Append(VM_t* vm, ObjArray_t* arr, const Value_t* vals, size_t count);
+/* turns the packed numbers into values */
+void ObjArr_ToValues(VM_t* vm, ObjArray_t* arr);
 
 /*
- *  Creates a new ObjString_t object by copying the cstr given
- *  \returns a pointer to the newly created ObjString_t object
+ *  Creates an array of a's elements followed by b's
  */
-ObjString_t* ObjStr_Copy(VM_t* vm, const char* cstr, int len);
+ObjArray_t* ObjArr_Concat(VM_t* vm, ObjArray_t* a, ObjArray_t* b);
+/* 
+ *  the bulk operations of the array methods, 
+ *  like ObjArr_Set the caller keeps the array and val where the gc sees them
+ */
+/* inserts val before the element at i, which is at most the array's size */
+void ObjArr_Insert(VM_t* vm, ObjArray_t* arr, size_t i, Value_t val);
+/* stores val in every element */
+void ObjArr_Fill(VM_t* vm, ObjArray_t* arr, Value_t val);
+void ObjArr_Reverse(VM_t* vm, ObjArray_t* arr);
+/* the index of the first element equal (==) to val, -1 if there is none */
+int64_t ObjArr_IndexOf(const ObjArray_t* arr, Value_t val);
+/* a gets b's elements and b gets a's */
+void ObjArr_SwapElems(ObjArray_t* a, ObjArray_t* b);
+/* true if a and b have the same elements, bit for bit */
+bool ObjArr_SameElems(const ObjArray_t* a, const ObjArray_t* b);
+
+/* the element at i, which must be within the array */
+static inline Value_t ObjArr_Get(const ObjArray_t* arr, size_t i)
+{
+    if (ELEMS_NUMBERS == arr->kind)
+        return NUMBER_VAL(arr->as.nums[i]);
+    return arr->as.vals[i];
+}
+
+/* copying shared elements or turning them into values allocates, so the caller keeps the array and val where the gc sees them */
+static inline void ObjArr_Set(VM_t* vm, ObjArray_t* arr, size_t i, Value_t val)
+{
+    if (ObjArr_IsShared(arr))
+        ObjArr_Own(vm, arr);
+    if (ELEMS_NUMBERS == arr->kind)
+    {
+        if (IS_NUMBER(val))
+        {
+            arr->as.nums[i] = AS_NUMBER(val);
+            return;
+        }
+        ObjArr_ToValues(vm, arr);
+    }
+    arr->as.vals[i] = val;
+}
+
+/* 
+ * Creates a new empty map object 
+ */
+ObjMap_t* ObjMap_Create(VM_t* vm);
+
+/* 
+ *  Creates an empty deque
+ */
+ObjDeque_t* ObjDeque_Create(VM_t* vm);
+/* 
+ *  pushing grows the ring buffer, so the caller keeps the deque and val where the gc sees them,
+ *  popping an empty deque is nil 
+ */
+void ObjDeque_PushFront(VM_t* vm, ObjDeque_t* deque, Value_t val);
+void ObjDeque_PushBack(VM_t* vm, ObjDeque_t* deque, Value_t val);
+Value_t ObjDeque_PopFront(ObjDeque_t* deque);
+Value_t ObjDeque_PopBack(ObjDeque_t* deque);
+
+/* the i-th element from the front, which must be within the deque */
+static inline Value_t ObjDeque_Get(const ObjDeque_t* deque, size_t i)
+{
+    return deque->vals[(deque->head + i) & (deque->capacity - 1)];
+}
+
+/* 
+ *  Creates an empty priority queue, ordered by the keys if cmp is nil 
+ */
+ObjPQueue_t* ObjPQueue_Create(VM_t* vm, Value_t cmp);
+/*
+ *  the entries are ordered with less when given, which may run clox code, and by their keys otherwise,
+ *  pushing grows the heap, so the caller keeps the queue and val where the gc sees them,
+ *  popping drops the top entry (the queue is not empty), the caller keeps its value where the gc sees it first
+ */
+void ObjPQueue_Push(VM_t* vm, ObjPQueue_t* pq, Value_t val, double key, SortLess_t less, void* ctx);
+void ObjPQueue_Pop(ObjPQueue_t* pq, SortLess_t less, void* ctx);
+
+/* 
+ *  Creates an empty set 
+ */
+ObjSet_t* ObjSet_Create(VM_t* vm);
+
+/*
+ *  Creates a node of len nil slots, or with the first len slots and the maps of node when it is not NULL,
+ *  node is kept where the gc sees it by the caller
+ */
+ObjPNode_t* ObjPNode_Create(VM_t* vm, const ObjPNode_t* node, uint32_t len);
+/* 
+ *  Creates a persistent vector or map of the nodes given, 
+ *  which the caller keeps where the gc sees them
+ */
+ObjPVec_t* ObjPVec_Create(VM_t* vm, size_t count, uint32_t shift, ObjPNode_t* root, ObjPNode_t* tail);
+ObjPMap_t* ObjPMap_Create(VM_t* vm, size_t count, ObjPNode_t* root);
+
+/* 
+ *  Creates a typed array of len zeros
+ */
+ObjTypedArr_t* ObjTyped_Create(VM_t* vm, TypedKind_t kind, int len);
+
+/* 
+ *  Creates a rope of a followed by b, both are strings or ropes
+ */
+ObjRope_t* ObjRope_Create(VM_t* vm, Obj_t* a, Obj_t* b);
+
+/*
+ *  Copies the rope into one string, the rope keeps it
+ *  \returns the string
+ */
+ObjString_t* ObjRope_Flatten(VM_t* vm, ObjRope_t* rope);
+
+
+/*
+ *  the substring of str (a string or a slice) that is len long from start, 
+ *  which must be within str, 
+ *  a slice of str's parent, or a new string under SLICE_MIN_LEN
+ */
+Obj_t* ObjSlice_Create(VM_t* vm, Obj_t* str, int start, int len);
+
+/*
+ *  Copies the slice's characters into a new string
+ *  \returns the string
+ */
+ObjString_t* ObjSlice_Flatten(VM_t* vm, const ObjSlice_t* slice);
+
+
 
-/* compare if the strings in a and b are equal */
-#define ObjStr_Equal(a, b) ((a) == (b))
 
 /*
- *  \returns the hash of multiple strings, the given strings are treated as one
+ *  Creates a new interned ObjString_t object by copying the cstr given,
+ *  for the compiler's and the vm's own strings, which can end up as table keys
+ *  \returns a pointer to the interned ObjString_t object
  */
-uint32_t ObjStr_HashStrs(int count, const ObjString_t* strings[]);
+ObjString_t* ObjStr_Copy(VM_t* vm, const char* cstr, int len);
+
+/* compare if the strings in a and b are equal, 2 interned strings are only equal to themselves */
+bool ObjStr_Equal(const ObjString_t* a, const ObjString_t* b);
+
+/* the hash of a string's or a slice's characters, which an interned string with them has as well */
+uint32_t ObjStr_Hash(VM_t* vm, Obj_t* str);
+
 
 
     /* 
-     *  Creates a new ObjString_t object and reserve len + 1 bytes of memory
+     *  Creates a new ObjString_t object that is not interned and reserve len + 1 bytes of memory
      *  \returns a pointer to the newly created ObjString_t object
      */
     ObjString_t* ObjStr_Reserve(VM_t* vm, int len);
@@ -228,10 +670,9 @@ uint32_t ObjStr_HashStrs(int count, const ObjString_t* strings[]);
     /* 
      *  Hashes the given string, and set it in the vm's string table if
      *  the string did not exist before
-     *  \returns true if the string already exist in the string table
-     *  \returns false otherwise
+     *  \returns the string in the vm's string table, string itself if it was not there
      */
-    bool ObjStr_Intern(VM_t* vm, ObjString_t* string);
+    ObjString_t* ObjStr_Intern(VM_t* vm, ObjString_t* string);
 
     /*
      *  steals the pointer to the heapstr, 
@@ -245,6 +686,38 @@ uint32_t ObjStr_HashStrs(int count, const ObjString_t* strings[]);
     ObjString_t* ObjStr_Steal(VM_t* vm, char* heapstr, int len);
 
 
+/*
+ *  builds a string piece by piece in a buffer of its own,
+ *  nothing is allocated on the gc's heap or interned until StrBld_Finish
+ */
+typedef struct StrBuilder_t
+{
+    VM_t* vm;
+    char* buf;
+    int len;
+    int capacity;
+} StrBuilder_t;
+
+typedef struct StrView_t
+{
+    const char* chars;
+    int len;
+} StrView_t;
+
+/* the characters of a string or of a slice */
+StrView_t ObjStr_View(const Obj_t* obj);
+
+
+void StrBld_Init(StrBuilder_t* builder, VM_t* vm);
+void StrBld_Append(StrBuilder_t* builder, const char* cstr, int len);
+
+/*
+ *  frees the builder's buffer, the builder can be used again after this
+ *  \returns the string that was built
+ */
+ObjString_t* StrBld_Finish(StrBuilder_t* builder);
+
+
 /* prints a val to fout stream */
 void Obj_Print(FILE* fout, const Value_t val);
 
@@ -0,0 +1,62 @@
+#ifndef _CLOX_PERSISTENT_H_
+#define _CLOX_PERSISTENT_H_
+
+
+#include "common.h"
+#include "value.h"
+#include "object.h"
+
+
+
+/*
+ *  persistent vectors and maps: an update gives a new version that shares
+ *  all the nodes but the ones on the path to what changed with the old one,
+ *  which is left as it was
+ *
+ *  a vector is a trie of PNODE_WIDTH wide nodes indexed by PNODE_BITS of the index at a time
+ *  plus a tail node for the last elements, so that pushing copies a node only once every PNODE_WIDTH pushes,
+ *  a map is a hash array mapped trie indexed by PNODE_BITS of the key's hash at a time,
+ *  whose nodes are kept compact (CHAMP): only a node with at least 2 pairs in it is a child
+ *
+ *  the vectors and maps given are kept where the gc sees them by the caller, and so are the values
+ */
+
+
+/* the element at i, which must be below the vector's count */
+Value_t PVec_Get(const ObjPVec_t* vec, size_t i);
+/* i must be below the vector's count */
+ObjPVec_t* PVec_Set(VM_t* vm, ObjPVec_t* vec, size_t i, Value_t val);
+ObjPVec_t* PVec_Push(VM_t* vm, ObjPVec_t* vec, Value_t val);
+/* the vector must not be empty */
+ObjPVec_t* PVec_Pop(VM_t* vm, ObjPVec_t* vec);
+/* the elements of the array in a vector of their own, built a node at a time */
+ObjPVec_t* PVec_FromArray(VM_t* vm, ObjArray_t* arr);
+
+
+/*
+ *  the keys of a map are numbers (1 and 1.0 are the same key), strings and slices by their content, bools and nil,
+ *  an object is hashed by its address, which the compaction changes,
+ *  and a map can not be rehashed in place since its nodes are shared with the other versions
+ */
+static inline bool PMap_IsKey(Value_t key)
+{
+    return !IS_OBJ(key) || IS_STRING(key) || IS_SLICE(key);
+}
+
+/*
+ *  \returns true if the key was found
+ *  \returns false if the key was not found, val_out is untouched
+ */
+bool PMap_Get(VM_t* vm, const ObjPMap_t* map, Value_t key, Value_t* val_out);
+ObjPMap_t* PMap_Set(VM_t* vm, ObjPMap_t* map, Value_t key, Value_t val);
+/* the map itself if it does not have the key */
+ObjPMap_t* PMap_Delete(VM_t* vm, ObjPMap_t* map, Value_t key);
+/* NULL if a key of the map is not a key that a persistent map can have */
+ObjPMap_t* PMap_FromMap(VM_t* vm, Map_t* map);
+
+/* calls visit with every pair of the map */
+typedef void (*PMapVisit_t)(void* ctx, Value_t key, Value_t val);
+void PMap_Each(const ObjPMap_t* map, PMapVisit_t visit, void* ctx);
+
+
+#endif /* _CLOX_PERSISTENT_H_ */
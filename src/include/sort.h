@@ -0,0 +1,36 @@
+#ifndef _CLOX_SORT_H_
+#define _CLOX_SORT_H_
+
+
+#include "common.h"
+#include "value.h"
+
+
+
+/* true when a goes before b, it may run clox code and so the gc */
+typedef bool (*SortLess_t)(void* ctx, Value_t a, Value_t b);
+
+
+/*
+ *  introsorts: quicksort on a median of 3,
+ *  heapsort once it goes too deep and insertion sort for the short runs,
+ *  they are not stable
+ */
+
+/* NaNs end up anywhere */
+void Sort_Numbers(double* nums, size_t n);
+/* the numbers compared with less as values */
+void Sort_NumbersBy(double* nums, size_t n, SortLess_t less, void* ctx);
+
+/*
+ *  the elements are only ever swapped so that all of them are still in vals whenever less runs,
+ *  a less that is not a strict weak ordering gives some order of the elements, but nothing worse
+ */
+void Sort_Values(Value_t* vals, size_t n, SortLess_t less, void* ctx);
+
+/* less for numbers, and for strings and slices compared byte by byte */
+bool Sort_NumLess(void* ctx, Value_t a, Value_t b);
+bool Sort_StrLess(void* ctx, Value_t a, Value_t b);
+
+
+#endif /* _CLOX_SORT_H_ */
@@ -7,22 +7,44 @@
 #include "memory.h"
 #include "typedefs.h"
 
-typedef struct Entry_t
-{
-    ObjString_t* key;
-    Value_t val;
-} Entry_t;
-
+/*
+ *  open addressing over groups of TABLE_GROUP_WIDTH slots, a probe checks a whole group at once:
+ *  ctrl has a byte per slot holding the low 7 bits of the key's hash when the slot is full,
+ *  or TABLE_CTRL_EMPTY / TABLE_CTRL_DELETED otherwise, so the keys are only read on a likely match
+ *
+ *  keys and vals are parallel arrays, the 3 arrays share one allocation that starts at keys,
+ *  a slot that is not full has a NULL key and a val that must not be read
+ *
+ *  a deleted slot only stays deleted when its group is full, the deleted slots are dropped 
+ *  and the table shrinks when it is rehashed, which Table_Set does before a key goes in
+ *  if the table is too full or too empty
+ */
+#define TABLE_GROUP_WIDTH 16
+#define TABLE_CTRL_EMPTY 0x80
+#define TABLE_CTRL_DELETED 0xFE
 
 typedef struct Table_t
 {
     VM_t* vm;
     size_t count;
+    size_t deleted;
     size_t capacity;
-    Entry_t* entries;
+    ObjString_t** keys;
+    Value_t* vals;
+    uint8_t* ctrl;
 } Table_t;
 
 
+typedef struct TableStats_t
+{
+    size_t count;
+    size_t deleted;
+    size_t capacity;
+    size_t max_probe; /* in groups, 1 when a key is in its first group */
+    double avg_probe;
+} TableStats_t;
+
+
 /*
  *  Initializes the hash table
  */
@@ -56,7 +78,7 @@ bool Table_Get(Table_t* table, const ObjString_t* key, Value_t* val_out);
 bool Table_Set(Table_t* table, ObjString_t* key, Value_t val);
 
 /* 
- *  marks an entry of the table that has the key as tombstone
+ *  removes the entry of the table that has the key
  *  \returns true if the key exits
  *  \returns false if it doesn't, and do nothing
  */
@@ -75,17 +97,6 @@ void Table_AddAll(const Table_t* src, Table_t* dst);
  */
 ObjString_t* Table_FindStr(Table_t* table, const char* cstr, int len, uint32_t hash);
 
-/*
- *  find a key corresponding to the substrs and the hash given
- *  the substr will be combined together to form a full string
- *  that string will be used to find the key
- *  \returns NULL if not found
- *  \returns a pointer to the entry's key if found
- */
-ObjString_t* Table_FindStrs(Table_t* table, 
-    int substr_count, const ObjString_t* substr[], 
-    uint32_t hash, int total_len
-);
 
 
 /*
@@ -95,11 +106,87 @@ void Table_Mark(Table_t* table);
 
 
 /* 
- *  Removes any strings that were not marked during the GC's mark phase 
+ *  Removes any strings that were not marked during the GC's mark phase,
+ *  the table is not shrunk here since it can't allocate during a collection
  */
 void Table_RemoveWhite(Table_t* table);
 
 
+/*
+ *  counts how far the lookups of the keys in the table have to probe, for diagnostics
+ */
+TableStats_t Table_Stats(const Table_t* table);
+
+
+
+
+
+
+
+/*
+ *  the same layout as Table_t, keyed by any value: numbers by their value (1 and 1.0 are the same key),
+ *  strings and slices by their content, and the rest by identity,
+ *  the slots are told apart by their ctrl byte since nil is a key like any other
+ *
+ *  an object's identity is its address, which the compaction changes: 
+ *  a map that had one of its keys moved is rehashed in place the next time it is used
+ */
+typedef struct Map_t
+{
+    VM_t* vm;
+    size_t count;
+    size_t deleted;
+    size_t capacity;
+    Value_t* keys;
+    Value_t* vals;
+    uint8_t* ctrl;
+    bool moved;
+} Map_t;
+
+
+void Map_Init(Map_t* map, VM_t* vm);
+
+/*
+ *  Frees the map itself, the keys and values are left in tact
+ */
+void Map_Free(Map_t* map);
+
+/*
+ *  \returns true if the key was found
+ *  \returns false if the key was not found, val_out is untouched
+ */
+bool Map_Get(Map_t* map, Value_t key, Value_t* val_out);
+
+/*
+ *  \returns true if the key did not exist before
+ *  \returns false if the key already exist, its value is overwritten
+ *
+ *  NOTE: the key must not be a rope, and both the key and the value must be reachable 
+ *  by the gc since the map may grow
+ */
+bool Map_Set(Map_t* map, Value_t key, Value_t val);
+
+/*
+ *  \returns true if the key existed and was removed
+ *  \returns false if it doesn't, and do nothing
+ */
+bool Map_Delete(Map_t* map, Value_t key);
+
+/*
+ *  Marks any object that is in the map, both key and value
+ */
+void Map_Mark(Map_t* map);
+
+/* the hash and the equality of the map's keys, for what is keyed the same way */
+uint32_t Map_HashKey(VM_t* vm, Value_t key);
+bool Map_KeyEqual(Value_t a, Value_t b);
+
+static inline bool Map_IsFull(const Map_t* map, size_t index)
+{
+    return map->ctrl[index] < TABLE_CTRL_EMPTY;
+}
+
+
 #endif /* _CLOX_TABLE_H_ */
 
 
@@ -0,0 +1,53 @@
+#ifndef _CLOX_TYPEDARR_H_
+#define _CLOX_TYPEDARR_H_
+
+
+#include "common.h"
+#include "value.h"
+#include "object.h"
+
+
+
+/* the element at i, which must be within the array */
+static inline Value_t TypedArr_Get(const ObjTypedArr_t* arr, int i)
+{
+    if (TYPED_I32 == arr->kind)
+        return INT_VAL(TYPED_I32(arr)[i]);
+    return NUMBER_VAL(TYPED_F64(arr)[i]);
+}
+
+/* a number that does not fit in an int32_t wraps around like it would in C, NaN and infinities are 0 */
+static inline int32_t TypedArr_ToI32(double number)
+{
+    if (!(-9.2e18 < number && number < 9.2e18))
+        return 0;
+    return (int32_t)(uint32_t)(int64_t)number;
+}
+
+static inline void TypedArr_Set(ObjTypedArr_t* arr, int i, double number)
+{
+    if (TYPED_I32 == arr->kind)
+        TYPED_I32(arr)[i] = TypedArr_ToI32(number);
+    else
+        TYPED_F64(arr)[i] = number;
+}
+
+
+
+/*
+ *  the kernels of the typed arrays' natives (see Native_Sum),
+ *  the Float64Array ones are written for sse2 and avx2,
+ *  whichever the cpu has is picked the first time one of them runs
+ *
+ *  a and b are of the same kind and size,
+ *  min and max need an element at least
+ */
+double TypedArr_Sum(const ObjTypedArr_t* arr);
+double TypedArr_Dot(const ObjTypedArr_t* a, const ObjTypedArr_t* b);
+double TypedArr_Min(const ObjTypedArr_t* arr);
+double TypedArr_Max(const ObjTypedArr_t* arr);
+void TypedArr_Scale(ObjTypedArr_t* arr, double factor);
+void TypedArr_Add(ObjTypedArr_t* a, const ObjTypedArr_t* b);
+
+
+#endif /* _CLOX_TYPEDARR_H_ */
@@ -14,7 +14,21 @@ typedef struct ObjClass_t ObjClass_t;
 typedef struct ObjInstance_t ObjInstance_t;
 typedef struct ObjBoundMethod_t ObjBoundMethod_t;
 typedef struct ObjArray_t ObjArray_t;
+typedef struct ObjRope_t ObjRope_t;
+typedef struct ObjSlice_t ObjSlice_t;
+typedef struct ObjMap_t ObjMap_t;
+typedef struct ObjTypedArr_t ObjTypedArr_t;
+typedef struct ObjDeque_t ObjDeque_t;
+typedef struct ObjPQueue_t ObjPQueue_t;
+typedef struct ObjSet_t ObjSet_t;
+typedef struct ObjPNode_t ObjPNode_t;
+typedef struct ObjPVec_t ObjPVec_t;
+typedef struct ObjPMap_t ObjPMap_t;
 typedef struct Obj_t Obj_t;
+typedef struct GCWorker_t GCWorker_t;
+typedef struct GCSweeper_t GCSweeper_t;
+typedef struct GCPage_t GCPage_t;
+typedef struct GCLargeObj_t GCLargeObj_t;
 
 #endif /* _CLOX_TYPEDEFS_H_ */
 
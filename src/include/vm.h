@@ -31,7 +31,6 @@ typedef struct CallFrame_t
 typedef struct NativeStr_t
 {
     struct {
-        ObjString_t *push, *pop, *size;
         ObjString_t *open_bracket, *comma, *close_bracket;
     } array;
     struct {
@@ -42,26 +41,57 @@ typedef struct NativeStr_t
 } NativeStr_t;
 
 
+/* 
+ *  a method of a builtin type, args[0] is the receiver and its argc arguments follow,
+ *  it returns false if it raised a runtime error, and what it returns goes in ret otherwise
+ */
+typedef bool (*NativeMethodFn_t)(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+
+typedef struct NativeMethod_t
+{
+    NativeMethodFn_t fn;
+    uint8_t type; /* ObjType_t of the receiver */
+    uint8_t arity; /* or NATIVE_VARIADIC */
+} NativeMethod_t;
+
+/* an OP_INVOKE's cache byte is the index of the method it called last, index 0 is no method */
+#define VM_NATIVE_METHODS_MAX UINT8_MAX
+
+
 struct VM_t
 {
     Allocator_t* alloc;
     Table_t strings;
     Table_t globals;
     ObjUpval_t* open_upvals;
-    Obj_t* head;
+    GCHeap_t heap;
 
     ObjString_t* init_str;
     NativeStr_t native;
 
+    /* the names of each builtin type's methods, to their index in native_methods */
+    Table_t methods[OBJ_TYPE_COUNT];
+    NativeMethod_t native_methods[VM_NATIVE_METHODS_MAX];
+    int native_method_count;
+
     int gray_count;
     int gray_capacity;
     Obj_t** gray_stack;
 
+    int gc_mark_threads;
+    int gc_worker_count;
+    GCWorker_t* gc_workers;
+    bool gc_background_sweep;
+    GCSweeper_t* gc_sweeper;
+    bool gc_compact;
+
     size_t bytes_allocated;
     size_t next_gc;
+    uint64_t hash_seed;
 
     Value_t* sp;
     int frame_count;
+    bool native_failed; /* set by VM_NativeError */
 
     Value_t stack[VM_STACK_MAX];
     CallFrame_t frames[VM_FRAMES_MAX];
@@ -80,6 +110,19 @@ void VM_Reset(VM_t* vm);
 /* free vm's data */
 void VM_Free(VM_t* vm);
 
+/* the size of the state copied by VM_SaveState */
+size_t VM_StateSize(void);
+/* 
+ * copies the vm's state to state (VM_StateSize bytes), 
+ * the stack and the call frames are left out, so the vm must not be running 
+ */
+void VM_SaveState(const VM_t* vm, void* state);
+/* 
+ * brings back the state saved by VM_SaveState without freeing anything,
+ * the objects are not part of it: the memory they were in at the time must be brought back as well 
+ */
+void VM_RestoreState(VM_t* vm, const void* state);
+
 
 /* pushes a value onto the vm's stack 
  *  \returns true on success, 
@@ -102,9 +145,22 @@ void VM_PrintStack(FILE* fout, const VM_t* vm);
  */
 bool VM_DefineNative(VM_t* vm, const char* name, NativeFn_t fn, uint8_t argc);
 
+/*
+ *  raises a runtime error from a native function, 
+ *  which should return right after: its call fails and what it returns is ignored
+ */
+void VM_NativeError(VM_t* vm, const char* fmt, ...);
+
+/*
+ *  defines a method of a builtin type, the methods of strings are the slices' and the ropes' as well
+ *  \returns true on success, 
+ *  \returns false on failure
+ */
+bool VM_DefineMethod(VM_t* vm, ObjType_t type, const char* name, NativeMethodFn_t fn, uint8_t arity);
+
 
 
-/* concatenate a with b and intern the result 
+/* concatenate a with b, the result is not interned 
  *  \returns the concatenation of a and b
  *
  *  NOTE: a and b will be pushed onto the stack as a precaution against the gc
@@ -11,6 +11,11 @@
 #include "include/value.h"
 #include "include/compiler.h"
 
+#ifdef GC_THREADS
+#  include <pthread.h>
+#  include <sched.h>
+#endif /* GC_THREADS */
+
 
 
 
@@ -56,17 +61,217 @@ typedef struct Split_t
 
 static bool extend_capacity(Allocator_t* allocator, FreeHeader_t* header, NodeType_t type, bufsize_t newcap);
 static FreeHeader_t* get_free_node(Allocator_t* allocator, bufsize_t nbytes);
+static FreeHeader_t* get_aligned_node(Allocator_t* allocator, bufsize_t nbytes, bufsize_t alignment, uint8_t** aligned_out);
 static void insert_free_node(Allocator_t* allocator, FreeHeader_t* node);
 static Split_t split_node(FreeHeader_t* node, NodeType_t type, bufsize_t new_size);
 static void set_header(FreeHeader_t* header, size_t capacity, FreeHeader_t* next, NodeType_t type);
 static void dbg_print_nodes(const Allocator_t allocator, const char* title);
+static void* try_alloc(Allocator_t* allocator, bufsize_t nbytes);
+static void* try_alloc_aligned(Allocator_t* allocator, bufsize_t nbytes, bufsize_t alignment);
+static void* try_realloc(Allocator_t* allocator, void* ptr, bufsize_t newsize);
+#ifndef ALLOCATOR_DEFAULT
+static void merge_free_nodes(Allocator_t* allocator);
+static void* arena_alloc(Allocator_t* allocator, bufsize_t nbytes, bufsize_t alignment);
+static void arena_free(Allocator_t* allocator, void* ptr);
+static void* arena_realloc(Allocator_t* allocator, void* ptr, bufsize_t newsize);
+#endif /* ALLOCATOR_DEFAULT */
 
 
 static void gc_mark_root(VM_t* vm);
 static void gc_trace_references(VM_t* vm);
 static void gc_blacken_obj(VM_t* vm, Obj_t* obj);
-static void gc_mark_valarr(VM_t* vm, ValueArr_t* va);
-static void gc_sweep(VM_t* vm);
+static void gc_gray_push(VM_t* vm, Obj_t* obj);
+static void gc_mark_vals(VM_t* vm, const Value_t* vals, size_t count);
+static void gc_maybe_collect(VM_t* vm);
+static bool gc_reclaim(VM_t* vm, int attempt);
+static size_t gc_next_threshold(size_t live_bytes);
+static uint64_t* gc_mark_word(const Obj_t* obj, uint64_t* mask);
+static void gc_sweep_large(VM_t* vm);
+static void gc_sweep_all_pages(VM_t* vm);
+static size_t gc_count_dead(VM_t* vm);
+
+static int gc_size_class(bufsize_t nbytes);
+static int gc_obj_class(bufsize_t nbytes, int type);
+static uint32_t gc_cell_size(int size_class);
+static GCPage_t* gc_page_create(VM_t* vm, int size_class);
+static Obj_t* gc_page_alloc(GCPage_t* page);
+static void gc_page_ensure_swept(VM_t* vm, GCPage_t* page);
+static size_t gc_sweep_page(VM_t* vm, GCPage_t* page);
+
+#ifndef ALLOCATOR_DEFAULT
+static void gc_evacuate_pages(VM_t* vm);
+static bool gc_evacuate_class(VM_t* vm, int size_class);
+static void gc_free_evacuated(VM_t* vm, int size_class);
+static void gc_slide(VM_t* vm);
+static void gc_release_gap(Allocator_t* allocator, uint8_t* from, uint8_t* to, FreeHeader_t* last);
+#endif /* ALLOCATOR_DEFAULT */
+
+
+typedef enum GCPageState_t
+{
+    GC_PAGE_SWEPT,
+    GC_PAGE_UNSWEPT, /* still has the mark bits of the last collection */
+    GC_PAGE_SWEEPING,
+    GC_PAGE_EVACUATED, /* being compacted, its objects were moved to other pages */
+} GCPageState_t;
+
+struct GCPage_t
+{
+    GCPage_t* next;
+    uint32_t cell_size;
+    uint32_t cell_count;
+    uint32_t live_count; /* allocated cells */
+    uint32_t cursor; /* the cells from here on have never been allocated */
+    uint32_t free_cell; /* offset of the first cell of the free list, each free cell holds the next one's, 0 ends it */
+    int state; /* GCPageState_t */
+    /* one bit per granule, only the bits of the granules starting a cell are used */
+    uint64_t alloc_bits[GC_PAGE_BITMAP_WORDS];
+    uint64_t mark_bits[GC_PAGE_BITMAP_WORDS];
+};
+
+struct GCLargeObj_t
+{
+    GCLargeObj_t* next;
+    bufsize_t size;
+    uint64_t mark; /* a whole word so that marking treats it like a page's bitmap */
+};
+
+#define GC_PAGE_OF(p_obj) ((GCPage_t*)((uintptr_t)(p_obj) & ~(uintptr_t)(GC_PAGE_SIZE - 1)))
+#define GC_PAGE_FIRST_CELL ((sizeof(GCPage_t) + GC_GRANULE - 1) & ~(size_t)(GC_GRANULE - 1))
+#define GC_LARGE_HEADER(p_obj) (((GCLargeObj_t*)(p_obj)) - 1)
+
+#ifndef ALLOCATOR_DEFAULT
+/* what is left of an object moved out of an evacuated page */
+typedef struct GCForward_t
+{
+    Obj_t obj;
+    Obj_t* to;
+} GCForward_t;
+
+/* 
+ * compaction walks every reference of the vm 3 times:
+ *  COMPACT_EVACUATE: points the references to objects of evacuated pages to where they were moved
+ *  COMPACT_FLAG: flags the allocator's blocks that the vm owns and may move
+ *  COMPACT_UPDATE: points the references to the flagged blocks to where they will be slid
+ */
+typedef enum CompactPhase_t
+{
+    COMPACT_EVACUATE,
+    COMPACT_FLAG,
+    COMPACT_UPDATE,
+} CompactPhase_t;
+
+/* a block's capacity is a multiple of MIN_SIZE, its low bits are free to hold the flags during compaction */
+#define COMPACT_FREE 1
+#define COMPACT_MOVABLE 2
+#define COMPACT_PAGE 4 /* keeps its alignment when moved */
+#define COMPACT_FLAGS (MIN_SIZE - 1)
+
+static void compact_visit_all(VM_t* vm, CompactPhase_t phase);
+static void compact_visit_obj(Obj_t* obj, CompactPhase_t phase);
+static void compact_table(Table_t* table, CompactPhase_t phase);
+static void compact_valarr(ValueArr_t* va, CompactPhase_t phase);
+static void compact_array(ObjArray_t* arr, CompactPhase_t phase);
+static void compact_map(Map_t* map, CompactPhase_t phase);
+static void compact_deque(ObjDeque_t* deque, CompactPhase_t phase);
+static void compact_pqueue(ObjPQueue_t* pq, CompactPhase_t phase);
+static void* compact_buf(void* buf, CompactPhase_t phase);
+static Obj_t* compact_obj(Obj_t* obj, CompactPhase_t phase);
+static Value_t compact_val(Value_t val, CompactPhase_t phase);
+#endif /* ALLOCATOR_DEFAULT */
+
+static const uint16_t s_size_classes[GC_SIZE_CLASS_COUNT] = {
+    16, 32, 48, 64, 80, 96, 112, 128, 
+    160, 192, 224, 256, 320, 384, 448, 512,
+};
+
+#define GC_ROUND_GRANULE(nbytes) (((nbytes) + GC_GRANULE - 1) & ~(size_t)(GC_GRANULE - 1))
+
+/* the strings up to this size have a pool, most of the ones the programs make are */
+#define GC_SHORT_STR_SIZE 32
+
+static const struct {
+    int type; /* ObjType_t */
+    uint16_t cell_size;
+} s_pools[GC_POOL_COUNT] = {
+    { OBJ_BOUND_METHOD, GC_ROUND_GRANULE(sizeof(ObjBoundMethod_t)) },
+    { OBJ_UPVAL, GC_ROUND_GRANULE(sizeof(ObjUpval_t)) },
+    { OBJ_CLOSURE, GC_ROUND_GRANULE(sizeof(ObjClosure_t) + 2 * sizeof(OBJREF(ObjUpval_t))) }, /* the ones made in loops capture something */
+    { OBJ_STRING, GC_SHORT_STR_SIZE },
+};
+
+
+#ifdef GC_THREADS
+/* 
+ * Chase-Lev work stealing deque, 
+ * the owner pushes and takes from the bottom, other workers steal from the top 
+ */
+typedef struct GCDequeBuf_t
+{
+    int64_t capacity; /* power of 2 */
+    struct GCDequeBuf_t* retired; /* smaller buffers that thieves might still be reading */
+    Obj_t* objs[];
+} GCDequeBuf_t;
+
+struct GCWorker_t
+{
+    VM_t* vm;
+    int64_t top;
+    int64_t bottom;
+    GCDequeBuf_t* buf;
+
+    GCWorker_t* all;
+    int count;
+    int* idle;
+    uint32_t seed;
+    bool started;
+    pthread_t thread;
+
+    uint8_t pad[64]; /* keeps the workers' top and bottom off each other's cache line */
+};
+
+#define GC_DEQUE_INITIAL_CAPACITY 1024
+
+/* guards the vm's gray stack, which takes what the workers' deques can not while they mark */
+static pthread_mutex_t s_overflow_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* the worker the current thread is marking for, NULL outside of parallel marking */
+static __thread GCWorker_t* s_worker = NULL;
+
+static void gc_trace_parallel(VM_t* vm);
+static void* gc_worker_run(void* worker);
+static bool gc_workers_reserve(VM_t* vm, int count);
+
+/* false if the deque was full and could not grow */
+static bool worker_push(GCWorker_t* worker, Obj_t* obj);
+static void worker_overflow(GCWorker_t* worker, Obj_t* obj);
+static Obj_t* worker_take(GCWorker_t* worker);
+static Obj_t* worker_steal(GCWorker_t* victim);
+static Obj_t* worker_steal_any(GCWorker_t* thief);
+static bool worker_can_steal(const GCWorker_t* thief);
+static GCDequeBuf_t* deque_buf_create(int64_t capacity);
+
+
+
+struct GCSweeper_t
+{
+    VM_t* vm;
+    size_t freed_count;
+    size_t freed_bufs;
+    size_t freed_bytes; /* what the dead objects owned, their cells were already taken off bytes_allocated */
+    bool running;
+    pthread_t thread;
+};
+
+/* set on the sweeper thread, the memory it frees goes to the allocator's pending list */
+static __thread GCSweeper_t* s_sweeper = NULL;
+
+static void gc_sweep_background(VM_t* vm);
+static void* gc_sweeper_run(void* sweeper);
+static void hand_off_free_node(Allocator_t* allocator, FreeHeader_t* node);
+static void take_pending_nodes(Allocator_t* allocator);
+static bool finish_pending(Allocator_t* allocator);
+#endif /* GC_THREADS */
 
 #define GET_HEADER(ptr) ((FreeHeader_t*)(((uint8_t*)(ptr)) - sizeof(FreeHeader_t)))
 #define GET_PTR(header_ptr) (((uint8_t*)(header_ptr)) + sizeof(FreeHeader_t))
@@ -76,16 +281,55 @@ static void gc_sweep(VM_t* vm);
 #define MIN_CAPACITY (MIN_SIZE + sizeof(FreeHeader_t))
 
 
+#ifdef GC_COMPRESSED_REFS
+uint8_t* GC_RefBase = NULL;
+
+/* 
+ * the first allocator puts the base half the reach below itself,
+ * so that the ones malloc'd later on either side of it are in reach too
+ */
+static void check_ref_reach(const Allocator_t* allocator)
+{
+    static bool base_set = false;
+    uintptr_t head = (uintptr_t)allocator->head;
+    if (!base_set)
+    {
+        if (head > GC_REF_REACH / 2)
+            GC_RefBase = (uint8_t*)((head - GC_REF_REACH / 2) & ~(((uintptr_t)1 << GC_REF_SHIFT) - 1));
+        base_set = true;
+    }
+
+    uintptr_t base = (uintptr_t)GC_RefBase;
+    if (head <= base || head + allocator->capacity - base > GC_REF_REACH)
+    {
+        fprintf(stderr, 
+            "Cannot initialize allocator because its memory is out of reach of compressed references, "
+            "at %p, base %p\n", 
+            (void*)allocator->head, (void*)GC_RefBase
+        );
+        exit(EXIT_FAILURE);
+    }
+}
+#endif /* GC_COMPRESSED_REFS */
+
+
 
 
 
 void Allocator_Init(Allocator_t* allocator, bufsize_t initial_capacity)
 {
+#ifdef GC_THREADS
+    allocator->pending = NULL;
+    allocator->sweeper = NULL;
+#endif /* GC_THREADS */
 #ifdef ALLOCATOR_DEFAULT
     (void)allocator, (void)initial_capacity;
 #else
+    /* the blocks' capacities stay multiples of MIN_SIZE */
+    initial_capacity &= ~(bufsize_t)(MIN_SIZE - 1);
 	allocator->capacity = initial_capacity + sizeof(FreeHeader_t);
     allocator->auto_defrag = false;
+    allocator->top = NULL;
 	allocator->head = malloc(initial_capacity + sizeof(FreeHeader_t));
 	if (NULL == allocator->head)
 	{
@@ -97,6 +341,10 @@ void Allocator_Init(Allocator_t* allocator, bufsize_t initial_capacity)
 		exit(EXIT_FAILURE);
 	}
 
+#  ifdef GC_COMPRESSED_REFS
+    check_ref_reach(allocator);
+#  endif /* GC_COMPRESSED_REFS */
+
 	allocator->free_head = (FreeHeader_t*)allocator->head;
     allocator->free_head->next = NULL;
     allocator->free_head->capacity = initial_capacity;
@@ -104,6 +352,38 @@ void Allocator_Init(Allocator_t* allocator, bufsize_t initial_capacity)
 }
 
 
+void Allocator_InitArena(Allocator_t* allocator, bufsize_t capacity)
+{
+    Allocator_Init(allocator, capacity);
+#ifndef ALLOCATOR_DEFAULT
+    allocator->free_head = NULL;
+    allocator->top = allocator->head;
+#endif /* ALLOCATOR_DEFAULT */
+}
+
+
+void* Allocator_Mark(const Allocator_t* allocator)
+{
+#ifdef ALLOCATOR_DEFAULT
+    (void)allocator;
+    return NULL;
+#else
+    return allocator->top;
+#endif /* ALLOCATOR_DEFAULT */
+}
+
+
+void Allocator_Release(Allocator_t* allocator, void* mark)
+{
+#ifdef ALLOCATOR_DEFAULT
+    (void)allocator, (void)mark;
+#else
+    CLOX_ASSERT(NULL != allocator->top && (uint8_t*)mark <= allocator->top);
+    allocator->top = mark;
+#endif /* ALLOCATOR_DEFAULT */
+}
+
+
 void Allocator_KillEmAll(Allocator_t* allocator)
 {
 #ifdef ALLOCATOR_DEFAULT
@@ -112,6 +392,7 @@ void Allocator_KillEmAll(Allocator_t* allocator)
 	free(allocator->head);
 	allocator->head = NULL;
 	allocator->free_head = NULL;
+    allocator->top = NULL;
 	allocator->capacity = 0;
 #endif /* ALLOCATOR_DEFAULT */
 }
@@ -122,67 +403,51 @@ void Allocator_KillEmAll(Allocator_t* allocator)
 
 void* Allocator_Alloc(Allocator_t* allocator, bufsize_t nbytes)
 {
-#ifdef ALLOCATOR_DEFAULT
-    (void)allocator;
-    void* ptr = malloc(nbytes);
-    if (NULL == ptr) goto out_of_mem;
+    void* ptr = try_alloc(allocator, nbytes);
+    if (NULL == ptr)
+    {
+        fprintf(stderr, "Alloc: Out of memory trying to allocate %zu bytes\n", nbytes);
+        exit(EXIT_FAILURE);
+    }
     return ptr;
-#else
-	FreeHeader_t* node = get_free_node(allocator, nbytes);
-	if (NULL == node) goto out_of_mem;
-    DEBUG_ALLOC_PRINT("\nAllocated pointer: %p, size: %u\n", GET_PTR(node), (unsigned)node->capacity);
-    dbg_print_nodes(*allocator, "Allocating");
+}
 
 
-	return GET_PTR(node);
-#endif /* ALLOCATOR_DEFAULT */
 
+void* Allocator_AllocAligned(Allocator_t* allocator, bufsize_t nbytes, bufsize_t alignment)
+{
+    void* ptr = try_alloc_aligned(allocator, nbytes, alignment);
+    if (NULL == ptr)
+    {
+        fprintf(stderr, "Alloc: Out of memory trying to allocate %zu bytes\n", nbytes);
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
 
-out_of_mem:
-    fprintf(stderr, "Alloc: Out of memory trying to allocate %zu bytes\n", nbytes);
-    exit(EXIT_FAILURE);
-    return NULL;
+
+void Allocator_FreeAligned(Allocator_t* allocator, void* ptr)
+{
+#ifdef ALLOCATOR_DEFAULT
+    (void)allocator;
+    if (NULL != ptr)
+        free(((void**)ptr)[-1]);
+#else
+    Allocator_Free(allocator, ptr);
+#endif /* ALLOCATOR_DEFAULT */
 }
 
 
 
 void* Allocator_Realloc(Allocator_t* allocator, void* ptr, bufsize_t newsize)
 {
-    if (NULL == ptr)
-    {
-        return Allocator_Alloc(allocator, newsize);
-    }
-    if (0 == newsize)
-    {
-        Allocator_Free(allocator, ptr);
-        return NULL;
-    }
-#ifdef ALLOCATOR_DEFAULT
-    ptr = realloc(ptr, newsize);
-    if (NULL == ptr)
+    void* newbuf = try_realloc(allocator, ptr, newsize);
+    if (NULL == newbuf && 0 != newsize)
     {
         fprintf(stderr, "Realloc: Out of memory trying to allocate %zu bytes\n", newsize);
         exit(EXIT_FAILURE);
-        return NULL;
-    }
-    return ptr;
-#else
-    FreeHeader_t* header = GET_HEADER(ptr);
-    if (header->capacity < newsize)
-    {
-        DEBUG_ALLOC_PRINT("Resizing pointer %p from %zu to %zu\n", 
-            ptr, header->capacity, newsize
-        );
-        if (!extend_capacity(allocator, header, NODE_ALIVE, newsize))
-        {
-            void* newbuf = Allocator_Alloc(allocator, newsize);
-            memcpy(newbuf, ptr, header->capacity);
-            Allocator_Free(allocator, ptr);
-            return newbuf;
-        }
     }
-    return ptr;
-#endif /* ALLOCATOR_DEFAULT */
+    return newbuf;
 }
 
 
@@ -219,6 +484,25 @@ void Allocator_Free(Allocator_t* allocator, void* ptr)
     memset(ptr, 0, GET_HEADER(ptr)->capacity);
 #endif /* DEBUG_ALLOCATION_CHK */
 
+#ifndef ALLOCATOR_DEFAULT
+    if (NULL != allocator->top)
+    {
+#  ifdef GC_THREADS
+        if (NULL != s_sweeper) /* only the owner moves top */
+            return;
+#  endif /* GC_THREADS */
+        arena_free(allocator, ptr);
+        return;
+    }
+#endif /* ALLOCATOR_DEFAULT */
+
+#ifdef GC_THREADS
+    if (NULL != s_sweeper)
+    {
+        hand_off_free_node(allocator, GET_HEADER(ptr));
+        return;
+    }
+#endif /* GC_THREADS */
 
     DEBUG_ALLOC_PRINT("\nFreeing pointer: %p, size: %zu\n", ptr, (GET_HEADER(ptr)->capacity));
     dbg_print_nodes(*allocator, "Freeing");
@@ -227,6 +511,28 @@ void Allocator_Free(Allocator_t* allocator, void* ptr)
 
 
 
+double Allocator_Fragmentation(const Allocator_t* allocator)
+{
+#ifdef ALLOCATOR_DEFAULT
+    (void)allocator;
+    return 0;
+#else
+    /* the free list is sorted by capacity, the last one is the biggest */
+    size_t total = 0;
+    size_t biggest = 0;
+    for (const FreeHeader_t* node = allocator->free_head;
+        NULL != node;
+        node = node->next)
+    {
+        total += node->capacity;
+        biggest = node->capacity;
+    }
+    return 0 == total ? 0 : 1.0 - (double)biggest / total;
+#endif /* ALLOCATOR_DEFAULT */
+}
+
+
+
 #if 0
 /* TODO: loop instead of recursion */
 void Allocator_Defrag(Allocator_t* allocator, size_t num_pointers)
@@ -260,6 +566,9 @@ void Allocator_Defrag(Allocator_t* alloc, size_t num_pointers)
     (void)alloc, (void)num_pointers;
     return;
 #endif /* ALLOCATOR_DEFAULT */
+#ifdef GC_THREADS
+    take_pending_nodes(alloc);
+#endif /* GC_THREADS */
 
     for (size_t i = 0; 
         NULL != alloc->free_head 
@@ -290,30 +599,44 @@ void Allocator_Defrag(Allocator_t* alloc, size_t num_pointers)
 
 void* GC_Reallocate(VM_t* vm, void* ptr, bufsize_t oldsize, bufsize_t newsize)
 {
+#ifdef GC_THREADS
+    if (NULL != s_sweeper) /* the sweeper only ever frees */
+    {
+        s_sweeper->freed_bytes += oldsize;
+        s_sweeper->freed_bufs += NULL != ptr;
+        Allocator_Free(vm->alloc, ptr);
+        return NULL;
+    }
+#endif /* GC_THREADS */
+
     vm->bytes_allocated += newsize - oldsize;
     if (oldsize < newsize)
     {
-#ifdef DEBUG_STRESS_GC
-        GC_CollectGarbage(vm);
-#endif /* DEBUG_STRESS_GC */
-        if (vm->bytes_allocated > vm->next_gc)
-        {
-            GC_CollectGarbage(vm);
-        }
+        gc_maybe_collect(vm);
     }
 
 
     if (0 == newsize)
     {
+        vm->heap.freed_bufs += NULL != ptr;
         Allocator_Free(vm->alloc, ptr);
         return NULL;
     }
-    return Allocator_Realloc(vm->alloc, ptr, newsize);
+    void* newbuf;
+    for (int attempt = 0; NULL == (newbuf = try_realloc(vm->alloc, ptr, newsize)); attempt++)
+    {
+        if (!gc_reclaim(vm, attempt))
+            return Allocator_Realloc(vm->alloc, ptr, newsize);
+    }
+    return newbuf;
 }
 
 
 void GC_CollectGarbage(VM_t* vm)
 {
+    GC_FinishSweep(vm);
+    /* the mark bits of the last collection go away with the sweep */
+    gc_sweep_all_pages(vm);
     DEBUG_GC_PRINT("-- gc begin\n");
 
     size_t before_gc = vm->bytes_allocated;
@@ -321,9 +644,39 @@ void GC_CollectGarbage(VM_t* vm)
 
     gc_mark_root(vm);
     gc_trace_references(vm);
+    /* the dead strings leave the intern table before anything is freed */
     Table_RemoveWhite(&vm->strings);
-    gc_sweep(vm);
-    vm->next_gc = vm->bytes_allocated * GC_HEAP_GROW_FACTOR;
+#ifdef DEBUG_LOG_GC
+    TableStats_t stats = Table_Stats(&vm->strings);
+    fprintf(GC_LOG_FILE, "   interned %zu strings in %zu slots (%zu deleted), probing %g groups on average and %zu at most\n",
+        stats.count, stats.capacity, stats.deleted, stats.avg_probe, stats.max_probe
+    );
+#endif /* DEBUG_LOG_GC */
+
+    gc_sweep_large(vm);
+    /* 
+     * the dead cells are freed lazily, but they are taken off bytes_allocated right away,
+     * what they own is only freed when they are swept
+     */
+    size_t dead = gc_count_dead(vm);
+    vm->bytes_allocated -= dead;
+    vm->heap.unswept = true;
+    vm->heap.bytes_at_gc = vm->bytes_allocated;
+    vm->heap.dead_at_gc = dead;
+    vm->heap.swept_bytes = 0;
+
+    size_t owned = dead * vm->heap.owned_ratio;
+    if (owned > vm->bytes_allocated)
+        owned = vm->bytes_allocated;
+    vm->next_gc = gc_next_threshold(vm->bytes_allocated - owned);
+
+#ifdef GC_THREADS
+    if (vm->gc_background_sweep
+    && vm->bytes_allocated >= GC_BACKGROUND_SWEEP_MIN_HEAP)
+    {
+        gc_sweep_background(vm);
+    }
+#endif /* GC_THREADS */
 
     DEBUG_GC_PRINT("-- gc end\n");
     DEBUG_GC_PRINT("   collected %zu bytes (from %zu to %zu) next at %zu\n",
@@ -334,6 +687,122 @@ void GC_CollectGarbage(VM_t* vm)
 }
 
 
+Obj_t* GC_AllocateObj(VM_t* vm, bufsize_t nbytes, int type)
+{
+    if (nbytes > GC_LARGE_OBJ_SIZE)
+    {
+        vm->bytes_allocated += nbytes;
+        gc_maybe_collect(vm);
+
+        GCLargeObj_t* large;
+        for (int attempt = 0; NULL == (large = try_alloc(vm->alloc, sizeof(*large) + nbytes)); attempt++)
+        {
+            if (!gc_reclaim(vm, attempt))
+                large = Allocator_Alloc(vm->alloc, sizeof(*large) + nbytes);
+        }
+        large->size = nbytes;
+        large->mark = 0;
+        large->next = vm->heap.large;
+        vm->heap.large = large;
+
+        Obj_t* obj = (Obj_t*)(large + 1);
+        obj->is_large = true;
+        return obj;
+    }
+
+
+    int size_class = gc_obj_class(nbytes, type);
+    vm->bytes_allocated += gc_cell_size(size_class);
+    gc_maybe_collect(vm);
+
+    Obj_t* obj = NULL;
+    GCPage_t* page = vm->heap.classes[size_class].alloc;
+    while (NULL != page)
+    {
+        gc_page_ensure_swept(vm, page);
+        obj = gc_page_alloc(page);
+        if (NULL != obj)
+            break;
+        page = page->next;
+        vm->heap.classes[size_class].alloc = page;
+    }
+
+    if (NULL == obj)
+    {
+        page = gc_page_create(vm, size_class);
+        vm->heap.classes[size_class].alloc = page;
+        obj = gc_page_alloc(page);
+    }
+    obj->is_large = false;
+    return obj;
+}
+
+
+bool GC_IsMarked(const Obj_t* obj)
+{
+    uint64_t mask;
+    const uint64_t* word = gc_mark_word(obj, &mask);
+    return 0 != (*word & mask);
+}
+
+
+void GC_InitHeap(GCHeap_t* heap)
+{
+    for (int i = 0; i < GC_CLASS_COUNT; i++)
+    {
+        heap->classes[i].pages = NULL;
+        heap->classes[i].tail = NULL;
+        heap->classes[i].alloc = NULL;
+    }
+    heap->large = NULL;
+    heap->page_count = 0;
+    heap->freed_bufs = 0;
+    heap->unswept = false;
+    heap->bytes_at_gc = 0;
+    heap->dead_at_gc = 0;
+    heap->swept_bytes = 0;
+    heap->owned_ratio = 0;
+}
+
+
+void GC_FreeHeap(VM_t* vm)
+{
+    GC_FinishSweep(vm);
+
+    for (int i = 0; i < GC_CLASS_COUNT; i++)
+    {
+        GCPage_t* page = vm->heap.classes[i].pages;
+        while (NULL != page)
+        {
+            /* every allocated cell, swept or not */
+            for (int w = 0; w < GC_PAGE_BITMAP_WORDS; w++)
+            {
+                for (uint64_t bits = page->alloc_bits[w]; 0 != bits; bits &= bits - 1)
+                {
+                    size_t granule = w * 64 + __builtin_ctzll(bits);
+                    Obj_Free(vm, (Obj_t*)((uint8_t*)page + granule * GC_GRANULE));
+                }
+            }
+
+            GCPage_t* next = page->next;
+            Allocator_FreeAligned(vm->alloc, page);
+            page = next;
+        }
+    }
+
+    GCLargeObj_t* large = vm->heap.large;
+    while (NULL != large)
+    {
+        GCLargeObj_t* next = large->next;
+        Obj_Free(vm, (Obj_t*)(large + 1));
+        Allocator_Free(vm->alloc, large);
+        large = next;
+    }
+
+    GC_InitHeap(&vm->heap);
+}
+
+
 
 
 void GC_MarkVal(VM_t* vm, Value_t val)
@@ -347,7 +816,29 @@ void GC_MarkVal(VM_t* vm, Value_t val)
 
 void GC_MarkObj(VM_t* vm, Obj_t* obj)
 {
-    if (NULL == obj || obj->is_marked)
+    if (NULL == obj)
+        return;
+
+    uint64_t mask;
+    uint64_t* word = gc_mark_word(obj, &mask);
+#ifdef GC_THREADS
+    if (NULL != s_worker)
+    {
+        /* another worker may have reached the same object, only the one that flips the bit keeps it */
+        if ((__atomic_load_n(word, __ATOMIC_RELAXED) & mask)
+        || (__atomic_fetch_or(word, mask, __ATOMIC_RELAXED) & mask))
+            return;
+
+        /* nothing to blacken */
+        if (OBJ_STRING == obj->type || OBJ_NATIVE == obj->type)
+            return;
+        if (!worker_push(s_worker, obj))
+            worker_overflow(s_worker, obj);
+        return;
+    }
+#endif /* GC_THREADS */
+
+    if (*word & mask)
         return;
 
 #ifdef DEBUG_LOG_GC
@@ -356,8 +847,13 @@ void GC_MarkObj(VM_t* vm, Obj_t* obj)
     fputc('\n', GC_LOG_FILE);
 #endif /* DEBUG_LOG_GC */
 
-    obj->is_marked = true;
+    *word |= mask;
+    gc_gray_push(vm, obj);
+}
+
 
+static void gc_gray_push(VM_t* vm, Obj_t* obj)
+{
     if (vm->gray_count + 1 > vm->gray_capacity)
     {
         vm->gray_capacity = GROW_CAPACITY(vm->gray_capacity);
@@ -369,44 +865,351 @@ void GC_MarkObj(VM_t* vm, Obj_t* obj)
 }
 
 
+void GC_FinishSweep(VM_t* vm)
+{
+#ifdef GC_THREADS
+    GCSweeper_t* sweeper = vm->gc_sweeper;
+    if (NULL == sweeper || !sweeper->running)
+        return;
 
+    pthread_join(sweeper->thread, NULL);
+    sweeper->running = false;
 
+    vm->bytes_allocated -= sweeper->freed_bytes;
+    vm->heap.swept_bytes += sweeper->freed_bytes;
+    vm->heap.freed_bufs += sweeper->freed_bufs;
 
+    DEBUG_GC_PRINT("-- background sweep end\n");
+    DEBUG_GC_PRINT("   swept %zu objects owning %zu bytes\n",
+        sweeper->freed_count, sweeper->freed_bytes
+    );
+#else
+    (void)vm;
+#endif /* GC_THREADS */
+}
 
 
+bool GC_Compact(VM_t* vm)
+{
+#ifdef ALLOCATOR_DEFAULT
+    (void)vm;
+    return false;
+#else
+    /* the compiler keeps its objects in C variables, and an arena never reuses its memory */
+    if (NULL != vm->compiler || NULL != vm->alloc->top)
+        return false;
 
+    DEBUG_GC_PRINT("-- compaction begin\n");
+    GC_CollectGarbage(vm);
+    /* from here on, every allocated cell is alive and the dead objects' buffers are freed */
+    GC_FinishSweep(vm);
+    gc_sweep_all_pages(vm);
+#  ifdef GC_THREADS
+    take_pending_nodes(vm->alloc);
+#  endif /* GC_THREADS */
 
+    gc_evacuate_pages(vm);
+    gc_slide(vm);
 
+    DEBUG_GC_PRINT("-- compaction end, fragmentation %g\n", Allocator_Fragmentation(vm->alloc));
+    return true;
+#endif /* ALLOCATOR_DEFAULT */
+}
 
 
+bool GC_MaybeCompact(VM_t* vm)
+{
+    if (!vm->gc_compact 
+    || Allocator_Fragmentation(vm->alloc) < GC_COMPACT_FRAGMENTATION)
+    {
+        return false;
+    }
+    return GC_Compact(vm);
+}
 
 
+void GC_FreeThreads(VM_t* vm)
+{
+#ifdef GC_THREADS
+    GC_FinishSweep(vm);
+    if (vm->alloc->sweeper == vm->gc_sweeper)
+        vm->alloc->sweeper = NULL;
+    free(vm->gc_sweeper);
 
+    for (int i = 0; i < vm->gc_worker_count; i++)
+    {
+        free(vm->gc_workers[i].buf);
+    }
+    free(vm->gc_workers);
+#endif /* GC_THREADS */
+    vm->gc_sweeper = NULL;
+    vm->gc_workers = NULL;
+    vm->gc_worker_count = 0;
+}
 
 
 
 
 
-static bool extend_capacity(Allocator_t* allocator, FreeHeader_t* node, NodeType_t type, bufsize_t newcap)
-{
-    if (NULL == allocator->free_head)
-    {
-        return false;
-    }
 
-    const uint8_t* node_edge = ((uint8_t*)node) + node->capacity + sizeof(FreeHeader_t);
-    FreeHeader_t* prev = NULL;
-    FreeHeader_t* curr = allocator->free_head;
-    /* stop search if we found 2 consecutive nodes */
-    while (NULL != curr && node_edge != (const uint8_t*)curr)
-    {
-        prev = curr;
-        curr = curr->next;
-    }
 
 
-    if (NULL == curr)
-        return false;
+
+
+
+
+
+
+
+
+
+
+
+
+#ifndef ALLOCATOR_DEFAULT
+
+/* the buffers keep their header so that they can be resized, \returns NULL if out of memory */
+static void* arena_alloc(Allocator_t* allocator, bufsize_t nbytes, bufsize_t alignment)
+{
+    nbytes = nbytes < MIN_SIZE ? MIN_SIZE : (nbytes + MIN_SIZE - 1) & ~(bufsize_t)(MIN_SIZE - 1);
+    uint8_t* ptr = (uint8_t*)(
+        ((uintptr_t)allocator->top + sizeof(FreeHeader_t) + alignment - 1) & ~(uintptr_t)(alignment - 1)
+    );
+    if (ptr + nbytes > allocator->head + allocator->capacity)
+        return NULL;
+
+    set_header(GET_HEADER(ptr), nbytes, NULL, NODE_ALIVE);
+    allocator->top = ptr + nbytes;
+    return ptr;
+}
+
+
+/* only the last buffer can be given back */
+static void arena_free(Allocator_t* allocator, void* ptr)
+{
+    FreeHeader_t* header = GET_HEADER(ptr);
+    if ((uint8_t*)ptr + header->capacity == allocator->top)
+        allocator->top = (uint8_t*)header;
+}
+
+
+static void* arena_realloc(Allocator_t* allocator, void* ptr, bufsize_t newsize)
+{
+    FreeHeader_t* header = GET_HEADER(ptr);
+    if (header->capacity >= newsize)
+        return ptr;
+
+    /* the last buffer grows in place */
+    newsize = (newsize + MIN_SIZE - 1) & ~(bufsize_t)(MIN_SIZE - 1);
+    if ((uint8_t*)ptr + header->capacity == allocator->top
+    && (uint8_t*)ptr + newsize <= allocator->head + allocator->capacity)
+    {
+        header->capacity = newsize;
+        allocator->top = (uint8_t*)ptr + newsize;
+        return ptr;
+    }
+
+    void* newbuf = arena_alloc(allocator, newsize, MIN_SIZE);
+    if (NULL == newbuf)
+    {
+        fprintf(stderr, "Realloc: Out of memory trying to allocate %zu bytes\n", (size_t)newsize);
+        exit(EXIT_FAILURE);
+    }
+    memcpy(newbuf, ptr, header->capacity);
+    return newbuf;
+}
+
+
+/* 
+ * merges the free nodes that are next to each other, 
+ * the nodes tile the region so it is walked in address order
+ */
+static void merge_free_nodes(Allocator_t* allocator)
+{
+#ifdef GC_THREADS
+    take_pending_nodes(allocator);
+#endif /* GC_THREADS */
+    for (FreeHeader_t* node = allocator->free_head; NULL != node; node = node->next)
+    {
+        node->capacity |= COMPACT_FREE;
+    }
+    allocator->free_head = NULL;
+
+
+    FreeHeader_t* run = NULL;
+    uint8_t* end = allocator->head + allocator->capacity;
+    for (uint8_t* ptr = allocator->head; ptr < end; )
+    {
+        FreeHeader_t* node = (FreeHeader_t*)ptr;
+        bool is_free = node->capacity & COMPACT_FREE;
+        bufsize_t capacity = node->capacity & ~(bufsize_t)COMPACT_FREE;
+        ptr += sizeof(FreeHeader_t) + capacity;
+
+        if (!is_free)
+        {
+            insert_free_node(allocator, run);
+            run = NULL;
+        }
+        else if (NULL == run)
+        {
+            run = node;
+            set_header(run, capacity, NULL, NODE_FREED);
+        }
+        else
+        {
+            run->capacity += sizeof(FreeHeader_t) + capacity;
+        }
+    }
+    insert_free_node(allocator, run);
+}
+
+#endif /* ALLOCATOR_DEFAULT */
+
+
+
+/* \returns NULL if out of memory */
+static void* try_alloc(Allocator_t* allocator, bufsize_t nbytes)
+{
+#ifdef ALLOCATOR_DEFAULT
+    (void)allocator;
+    return malloc(nbytes);
+#else
+    if (NULL != allocator->top)
+        return arena_alloc(allocator, nbytes, MIN_SIZE);
+#  ifdef GC_THREADS
+    take_pending_nodes(allocator);
+#  endif /* GC_THREADS */
+	FreeHeader_t* node = get_free_node(allocator, nbytes);
+#  ifdef GC_THREADS
+    /* what the background sweeper has yet to free might be enough */
+    if (NULL == node && finish_pending(allocator))
+        node = get_free_node(allocator, nbytes);
+#  endif /* GC_THREADS */
+	if (NULL == node)
+        return NULL;
+    DEBUG_ALLOC_PRINT("\nAllocated pointer: %p, size: %u\n", GET_PTR(node), (unsigned)node->capacity);
+    dbg_print_nodes(*allocator, "Allocating");
+
+
+	return GET_PTR(node);
+#endif /* ALLOCATOR_DEFAULT */
+}
+
+
+/* \returns NULL if out of memory */
+static void* try_alloc_aligned(Allocator_t* allocator, bufsize_t nbytes, bufsize_t alignment)
+{
+#ifdef ALLOCATOR_DEFAULT
+    (void)allocator;
+    /* the pointer malloc returned is kept right before the aligned buffer */
+    uint8_t* raw = malloc(nbytes + alignment + sizeof(void*));
+    if (NULL == raw)
+        return NULL;
+
+    uintptr_t aligned = ((uintptr_t)raw + sizeof(void*) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    ((void**)aligned)[-1] = raw;
+    return (void*)aligned;
+#else
+    if (NULL != allocator->top)
+        return arena_alloc(allocator, nbytes, alignment);
+#  ifdef GC_THREADS
+    take_pending_nodes(allocator);
+#  endif /* GC_THREADS */
+    uint8_t* aligned = NULL;
+	FreeHeader_t* node = get_aligned_node(allocator, nbytes, alignment, &aligned);
+#  ifdef GC_THREADS
+    if (NULL == node && finish_pending(allocator))
+        node = get_aligned_node(allocator, nbytes, alignment, &aligned);
+#  endif /* GC_THREADS */
+	if (NULL == node)
+        return NULL;
+
+    FreeHeader_t* header = node;
+    if (GET_PTR(node) != aligned)
+    {
+        /* the part in front of the aligned buffer goes back to the free list */
+        uint8_t* end = GET_PTR(node) + node->capacity;
+        header = GET_HEADER(aligned);
+        set_header(header, end - aligned, NULL, NODE_ALIVE);
+        set_header(node, (uint8_t*)header - GET_PTR(node), NULL, NODE_FREED);
+        insert_free_node(allocator, node);
+    }
+
+    Split_t split = split_node(header, NODE_ALIVE, nbytes);
+    insert_free_node(allocator, split.new_free_node);
+    DEBUG_ALLOC_PRINT("\nAllocated aligned pointer: %p, size: %u\n", aligned, (unsigned)header->capacity);
+    return aligned;
+#endif /* ALLOCATOR_DEFAULT */
+}
+
+
+/* \returns NULL if out of memory, the buffer given is left as it was then */
+static void* try_realloc(Allocator_t* allocator, void* ptr, bufsize_t newsize)
+{
+    if (NULL == ptr)
+    {
+        return try_alloc(allocator, newsize);
+    }
+    if (0 == newsize)
+    {
+        Allocator_Free(allocator, ptr);
+        return NULL;
+    }
+#ifdef ALLOCATOR_DEFAULT
+    return realloc(ptr, newsize);
+#else
+    if (NULL != allocator->top)
+        return arena_realloc(allocator, ptr, newsize);
+
+    FreeHeader_t* header = GET_HEADER(ptr);
+    if (header->capacity < newsize)
+    {
+        DEBUG_ALLOC_PRINT("Resizing pointer %p from %zu to %zu\n", 
+            ptr, header->capacity, newsize
+        );
+        if (!extend_capacity(allocator, header, NODE_ALIVE, newsize))
+        {
+            void* newbuf = try_alloc(allocator, newsize);
+            if (NULL == newbuf)
+                return NULL;
+            memcpy(newbuf, ptr, header->capacity);
+            Allocator_Free(allocator, ptr);
+            return newbuf;
+        }
+    }
+    else
+    {
+        /* the tail goes back to the free list, unless it is too small to be a node */
+        Split_t split = split_node(header, NODE_ALIVE, newsize);
+        insert_free_node(allocator, split.new_free_node);
+    }
+    return ptr;
+#endif /* ALLOCATOR_DEFAULT */
+}
+
+
+
+
+static bool extend_capacity(Allocator_t* allocator, FreeHeader_t* node, NodeType_t type, bufsize_t newcap)
+{
+    if (NULL == allocator->free_head)
+    {
+        return false;
+    }
+
+    const uint8_t* node_edge = ((uint8_t*)node) + node->capacity + sizeof(FreeHeader_t);
+    FreeHeader_t* prev = NULL;
+    FreeHeader_t* curr = allocator->free_head;
+    /* stop search if we found 2 consecutive nodes */
+    while (NULL != curr && node_edge != (const uint8_t*)curr)
+    {
+        prev = curr;
+        curr = curr->next;
+    }
+
+
+    if (NULL == curr)
+        return false;
 
     const size_t new_node_capacity = 
         node->capacity + curr->capacity + sizeof(FreeHeader_t);
@@ -486,6 +1289,49 @@ static FreeHeader_t* get_free_node(Allocator_t* allocator, bufsize_t nbytes)
 }
 
 
+/* 
+ * the first node of the free list whose buffer has an aligned address with nbytes after it, 
+ * that address is set in aligned_out,
+ * unless it is the node's own buffer, a free node fits in front of it so that the nodes tile the region
+ */
+static FreeHeader_t* get_aligned_node(Allocator_t* allocator, bufsize_t nbytes, bufsize_t alignment, uint8_t** aligned_out)
+{
+    for (int tries = 0; tries < 2; tries++)
+    {
+        FreeHeader_t* prev = NULL;
+        for (FreeHeader_t* curr = allocator->free_head; NULL != curr; prev = curr, curr = curr->next)
+        {
+            if (curr->capacity < nbytes)
+                continue;
+
+            uint8_t* ptr = GET_PTR(curr);
+            uint8_t* aligned = ptr;
+            if (0 != (uintptr_t)ptr % alignment)
+            {
+                aligned = (uint8_t*)(
+                    ((uintptr_t)ptr + MIN_CAPACITY + alignment - 1) & ~(uintptr_t)(alignment - 1)
+                );
+            }
+            if (aligned + nbytes > ptr + curr->capacity)
+                continue;
+
+            if (NULL == prev)
+                allocator->free_head = curr->next;
+            else
+                prev->next = curr->next;
+            curr->next = NULL;
+            *aligned_out = aligned;
+            return curr;
+        }
+
+        if (!allocator->auto_defrag)
+            break;
+        Allocator_Defrag(allocator, ALLOCATOR_DEFRAG_DEFAULT);
+    }
+    return NULL;
+}
+
+
 
 static void insert_free_node(Allocator_t* allocator, FreeHeader_t* node)
 {
@@ -550,7 +1396,11 @@ static Split_t split_node(FreeHeader_t* node, NodeType_t type, bufsize_t new_siz
 
     set_header(split.new_node, new_size, NULL, type);
     if (total_capacity < taken + MIN_CAPACITY)
+    {
+        /* too small to be a node on its own, the leftover stays with the node so that the nodes tile the region */
+        split.new_node->capacity = total_capacity - sizeof(FreeHeader_t);
         return split;
+    }
 
 
     split.new_free_node = (FreeHeader_t*)((uint8_t*)node + taken);
@@ -626,19 +1476,20 @@ static void gc_mark_root(VM_t* vm)
 
     for (ObjUpval_t* upval = vm->open_upvals; 
         NULL != upval; 
-        upval = upval->next)
+        upval = DEREF_NULLABLE(ObjUpval_t, upval->next))
     {
         GC_MarkObj(vm, (Obj_t*)upval);
     }
 
     Table_Mark(&vm->globals);
+    for (int i = 0; i < OBJ_TYPE_COUNT; i++)
+    {
+        Table_Mark(&vm->methods[i]);
+    }
     Compiler_MarkObj(vm->compiler);
 
 
     GC_MarkObj(vm, (Obj_t*)vm->init_str);
-    GC_MarkObj(vm, (Obj_t*)vm->native.array.push);
-    GC_MarkObj(vm, (Obj_t*)vm->native.array.pop);
-    GC_MarkObj(vm, (Obj_t*)vm->native.array.size);
     GC_MarkObj(vm, (Obj_t*)vm->native.array.open_bracket);
     GC_MarkObj(vm, (Obj_t*)vm->native.array.comma);
     GC_MarkObj(vm, (Obj_t*)vm->native.array.close_bracket);
@@ -657,6 +1508,15 @@ static void gc_mark_root(VM_t* vm)
 
 static void gc_trace_references(VM_t* vm)
 {
+#ifdef GC_THREADS
+    if (vm->gc_mark_threads > 1 
+    && vm->bytes_allocated >= GC_PARALLEL_MARK_MIN_HEAP)
+    {
+        gc_trace_parallel(vm);
+        return;
+    }
+#endif /* GC_THREADS */
+
     while (vm->gray_count > 0)
     {
         Obj_t* obj = vm->gray_stack[--vm->gray_count];
@@ -677,19 +1537,75 @@ static void gc_blacken_obj(VM_t* vm, Obj_t* obj)
     {
     case OBJ_NATIVE:
     case OBJ_STRING:
+    case OBJ_TYPED_ARRAY:
         break;
 
     case OBJ_ARRAY:
     {
+        /* packed numbers have nothing to mark, shared elements are marked with the frozen array */
         ObjArray_t* arr = (ObjArray_t*)obj;
-        gc_mark_valarr(vm, &arr->array);
+        if (ObjArr_IsShared(arr))
+            GC_MarkObj(vm, (Obj_t*)DEREF(ObjArray_t, arr->shared));
+        else if (ELEMS_VALUES == arr->kind)
+            gc_mark_vals(vm, arr->as.vals, arr->size);
+    }
+    break;
+
+    case OBJ_MAP:
+        Map_Mark(&((ObjMap_t*)obj)->map);
+        break;
+
+    case OBJ_DEQUE:
+    {
+        /* the elements wrap around the end of the ring buffer */
+        ObjDeque_t* deque = (ObjDeque_t*)obj;
+        size_t first = deque->capacity - deque->head;
+        if (first > deque->count)
+            first = deque->count;
+        gc_mark_vals(vm, deque->vals + deque->head, first);
+        gc_mark_vals(vm, deque->vals, deque->count - first);
+    }
+    break;
+
+    case OBJ_PQUEUE:
+    {
+        ObjPQueue_t* pq = (ObjPQueue_t*)obj;
+        GC_MarkVal(vm, pq->cmp);
+        for (size_t i = 0; i < pq->count; i++)
+        {
+            GC_MarkVal(vm, pq->entries[i].val);
+        }
+    }
+    break;
+
+    case OBJ_SET:
+        Map_Mark(&((ObjSet_t*)obj)->map);
+        break;
+
+    case OBJ_PNODE:
+    {
+        /* a node shared by many versions is marked once, like any other object */
+        ObjPNode_t* node = (ObjPNode_t*)obj;
+        gc_mark_vals(vm, node->slots, node->len);
     }
     break;
 
+    case OBJ_PVEC:
+    {
+        ObjPVec_t* vec = (ObjPVec_t*)obj;
+        GC_MarkObj(vm, (Obj_t*)DEREF_NULLABLE(ObjPNode_t, vec->root));
+        GC_MarkObj(vm, (Obj_t*)DEREF_NULLABLE(ObjPNode_t, vec->tail));
+    }
+    break;
+
+    case OBJ_PMAP:
+        GC_MarkObj(vm, (Obj_t*)DEREF_NULLABLE(ObjPNode_t, ((ObjPMap_t*)obj)->root));
+        break;
+
     case OBJ_BOUND_METHOD:
     {
         ObjBoundMethod_t* bmd = (ObjBoundMethod_t*)obj;
-        GC_MarkObj(vm, (Obj_t*)bmd->method);
+        GC_MarkObj(vm, (Obj_t*)DEREF(ObjClosure_t, bmd->method));
         GC_MarkVal(vm, bmd->receiver);
     }
     break;
@@ -718,63 +1634,1387 @@ static void gc_blacken_obj(VM_t* vm, Obj_t* obj)
     {
         ObjFunction_t* fun = (ObjFunction_t*)obj;
         GC_MarkObj(vm, (Obj_t*)fun->name);
-        gc_mark_valarr(vm, &fun->chunk.consts);
+        gc_mark_vals(vm, fun->chunk.consts.vals, fun->chunk.consts.size);
     }
     break;
 
     case OBJ_CLOSURE:
     {
         ObjClosure_t* closure = (ObjClosure_t*)obj;
-        GC_MarkObj(vm, (Obj_t*)closure->fun);
+        GC_MarkObj(vm, (Obj_t*)DEREF(ObjFunction_t, closure->fun));
         for (int i = 0; i < closure->upval_count; i++)
         {
-            GC_MarkObj(vm, (Obj_t*)closure->upvals[i]);
+            GC_MarkObj(vm, (Obj_t*)DEREF_NULLABLE(ObjUpval_t, closure->upvals[i]));
         }
     }
     break;
+
+    case OBJ_ROPE:
+    {
+        ObjRope_t* rope = (ObjRope_t*)obj;
+        GC_MarkObj(vm, DEREF(Obj_t, rope->left));
+        GC_MarkObj(vm, DEREF_NULLABLE(Obj_t, rope->right));
+    }
+    break;
+
+    case OBJ_SLICE:
+        GC_MarkObj(vm, (Obj_t*)DEREF(ObjString_t, ((ObjSlice_t*)obj)->parent));
+        break;
     }
 }
 
 
-static void gc_mark_valarr(VM_t* vm, ValueArr_t* va)
+static void gc_mark_vals(VM_t* vm, const Value_t* vals, size_t count)
 {
-    for (size_t i = 0; i < va->size; i++)
+    for (size_t i = 0; i < count; i++)
+    {
+        GC_MarkVal(vm, vals[i]);
+    }
+}
+
+
+
+static size_t gc_next_threshold(size_t live_bytes)
+{
+    size_t next = live_bytes * GC_HEAP_GROW_FACTOR;
+    return next < GC_MIN_NEXT_GC ? GC_MIN_NEXT_GC : next;
+}
+
+
+static void gc_maybe_collect(VM_t* vm)
+{
+#ifdef DEBUG_STRESS_GC
+    GC_CollectGarbage(vm);
+#endif /* DEBUG_STRESS_GC */
+    if (vm->bytes_allocated > vm->next_gc)
+    {
+        /* what the last collection's dead objects still own might be enough */
+        GC_FinishSweep(vm);
+        gc_sweep_all_pages(vm);
+        if (vm->bytes_allocated > vm->next_gc)
+            GC_CollectGarbage(vm);
+    }
+}
+
+
+/* 
+ * called when the allocator has no block big enough for what the heap needs, until it returns false:
+ *  the 1st attempt collects and sweeps everything, the 2nd merges the free blocks left next to each other,
+ *  the objects are not moved since the callers may hold on to them in C variables
+ */
+static bool gc_reclaim(VM_t* vm, int attempt)
+{
+    switch (attempt)
     {
-        GC_MarkVal(vm, va->vals[i]);
+    case 0:
+        DEBUG_GC_PRINT("-- out of memory, collecting everything\n");
+        GC_CollectGarbage(vm);
+        GC_FinishSweep(vm);
+        gc_sweep_all_pages(vm);
+        return true;
+#ifndef ALLOCATOR_DEFAULT
+    case 1:
+        if (NULL != vm->alloc->top)
+            return false;
+        DEBUG_GC_PRINT("-- out of memory, merging the free blocks\n");
+        merge_free_nodes(vm->alloc);
+        return true;
+#endif /* ALLOCATOR_DEFAULT */
+    default:
+        return false;
     }
 }
 
 
+/* \returns the word holding the object's mark bit, and the bit through mask */
+static uint64_t* gc_mark_word(const Obj_t* obj, uint64_t* mask)
+{
+    if (obj->is_large)
+    {
+        *mask = 1;
+        return &GC_LARGE_HEADER(obj)->mark;
+    }
+
+    GCPage_t* page = GC_PAGE_OF(obj);
+    size_t granule = ((uintptr_t)obj - (uintptr_t)page) / GC_GRANULE;
+    *mask = (uint64_t)1 << (granule % 64);
+    return &page->mark_bits[granule / 64];
+}
+
 
-static void gc_sweep(VM_t* vm)
+static void gc_sweep_large(VM_t* vm)
 {
-    Obj_t* prev = NULL;
-    Obj_t* curr = vm->head;
-    size_t freed_count = 0;
+    GCLargeObj_t* prev = NULL;
+    GCLargeObj_t* curr = vm->heap.large;
     while (NULL != curr)
     {
-        if (curr->is_marked) /* then advance */
+        if (curr->mark) /* then advance */
         {
-            curr->is_marked = false; /* for next sweep cycle */
+            curr->mark = 0; /* for next sweep cycle */
             prev = curr;
             curr = curr->next;
         }
         else 
         {
-            Obj_t* the_sinful = curr;
+            GCLargeObj_t* the_sinful = curr;
 
             curr = curr->next;
             if (NULL == prev)
-                vm->head = curr;
+                vm->heap.large = curr;
             else
                 prev->next = curr;
 
-            Obj_Free(vm, the_sinful);
-            freed_count += 1;
+            Obj_Free(vm, (Obj_t*)(the_sinful + 1));
+            vm->bytes_allocated -= the_sinful->size;
+            Allocator_Free(vm->alloc, the_sinful);
+            vm->heap.freed_bufs += 1;
+        }
+    }
+}
+
+
+/* 
+ * sweeps whatever lazy sweeping has not gotten to yet, 
+ * and gives the pages that ended up empty back to the allocator
+ */
+static void gc_sweep_all_pages(VM_t* vm)
+{
+    for (int i = 0; i < GC_CLASS_COUNT; i++)
+    {
+        GCPage_t* prev = NULL;
+        GCPage_t* page = vm->heap.classes[i].pages;
+        while (NULL != page)
+        {
+            GCPage_t* next = page->next;
+            gc_page_ensure_swept(vm, page);
+
+            /* the first page of a size is kept, it would just be allocated again */
+            if (0 == page->live_count && NULL != prev)
+            {
+                prev->next = next;
+                Allocator_FreeAligned(vm->alloc, page);
+                vm->heap.page_count -= 1;
+            }
+            else
+            {
+                prev = page;
+            }
+            page = next;
         }
+
+        vm->heap.classes[i].tail = prev;
+        vm->heap.classes[i].alloc = vm->heap.classes[i].pages;
+    }
+
+    Allocator_Defrag(vm->alloc, vm->heap.freed_bufs);
+    vm->heap.freed_bufs = 0;
+
+    if (vm->heap.unswept)
+    {
+        vm->heap.unswept = false;
+        vm->next_gc = gc_next_threshold(vm->heap.bytes_at_gc - vm->heap.swept_bytes);
+        if (0 != vm->heap.dead_at_gc)
+            vm->heap.owned_ratio = (double)vm->heap.swept_bytes / vm->heap.dead_at_gc;
     }
+}
 
 
-    Allocator_Defrag(vm->alloc, freed_count);
+/* 
+ * counts the marked cells of every page, the pages now need a sweep before they can be allocated from
+ * \returns the size of the dead cells
+ */
+static size_t gc_count_dead(VM_t* vm)
+{
+    size_t dead = 0;
+    for (int i = 0; i < GC_CLASS_COUNT; i++)
+    {
+        for (GCPage_t* page = vm->heap.classes[i].pages; 
+            NULL != page; 
+            page = page->next)
+        {
+            uint32_t marked = 0;
+            for (int w = 0; w < GC_PAGE_BITMAP_WORDS; w++)
+            {
+                marked += __builtin_popcountll(page->mark_bits[w]);
+            }
+
+            dead += (size_t)(page->live_count - marked) * page->cell_size;
+            page->state = GC_PAGE_UNSWEPT;
+        }
+        vm->heap.classes[i].alloc = vm->heap.classes[i].pages;
+    }
+    return dead;
 }
 
+
+
+
+
+
+static int gc_obj_class(bufsize_t nbytes, int type)
+{
+    for (int i = 0; i < GC_POOL_COUNT; i++)
+    {
+        if (type == s_pools[i].type && nbytes <= s_pools[i].cell_size)
+            return GC_SIZE_CLASS_COUNT + i;
+    }
+    return gc_size_class(nbytes);
+}
+
+
+static uint32_t gc_cell_size(int size_class)
+{
+    if (size_class < GC_SIZE_CLASS_COUNT)
+        return s_size_classes[size_class];
+    return s_pools[size_class - GC_SIZE_CLASS_COUNT].cell_size;
+}
+
+
+static int gc_size_class(bufsize_t nbytes)
+{
+    if (nbytes <= 128)
+        return 0 == nbytes ? 0 : (nbytes - 1) / 16;
+    if (nbytes <= 256)
+        return 8 + (nbytes - 129) / 32;
+    return 12 + (nbytes - 257) / 64;
+}
+
+
+static GCPage_t* gc_page_create(VM_t* vm, int size_class)
+{
+    GCPage_t* page;
+    for (int attempt = 0; NULL == (page = try_alloc_aligned(vm->alloc, GC_PAGE_SIZE, GC_PAGE_SIZE)); attempt++)
+    {
+        if (!gc_reclaim(vm, attempt))
+            page = Allocator_AllocAligned(vm->alloc, GC_PAGE_SIZE, GC_PAGE_SIZE);
+    }
+    page->next = NULL;
+    page->cell_size = gc_cell_size(size_class);
+    page->cell_count = (GC_PAGE_SIZE - GC_PAGE_FIRST_CELL) / page->cell_size;
+    page->live_count = 0;
+    page->cursor = 0;
+    page->free_cell = 0;
+    page->state = GC_PAGE_SWEPT;
+    memset(page->alloc_bits, 0, sizeof(page->alloc_bits));
+    memset(page->mark_bits, 0, sizeof(page->mark_bits));
+
+    /* the background sweeper may be walking the list, the page is only published once it's ready */
+    GCPage_t* tail = vm->heap.classes[size_class].tail;
+    if (NULL == tail)
+        __atomic_store_n(&vm->heap.classes[size_class].pages, page, __ATOMIC_RELEASE);
+    else
+        __atomic_store_n(&tail->next, page, __ATOMIC_RELEASE);
+    vm->heap.classes[size_class].tail = page;
+    vm->heap.page_count += 1;
+    return page;
+}
+
+
+static Obj_t* gc_page_alloc(GCPage_t* page)
+{
+    size_t offset = page->free_cell;
+    if (0 != offset)
+    {
+        page->free_cell = *(uint32_t*)((uint8_t*)page + offset);
+    }
+    else if (page->cursor < page->cell_count)
+    {
+        offset = GC_PAGE_FIRST_CELL + (size_t)page->cursor * page->cell_size;
+        page->cursor += 1;
+    }
+    else
+    {
+        return NULL;
+    }
+
+    size_t granule = offset / GC_GRANULE;
+    page->alloc_bits[granule / 64] |= (uint64_t)1 << (granule % 64);
+    page->live_count += 1;
+    return (Obj_t*)((uint8_t*)page + offset);
+}
+
+
+static void gc_page_ensure_swept(VM_t* vm, GCPage_t* page)
+{
+    int state = __atomic_load_n(&page->state, __ATOMIC_ACQUIRE);
+    if (GC_PAGE_SWEPT == state)
+        return;
+
+    int unswept = GC_PAGE_UNSWEPT;
+    if (__atomic_compare_exchange_n(&page->state, &unswept, GC_PAGE_SWEEPING, 
+        false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+    {
+        size_t before = vm->bytes_allocated;
+        gc_sweep_page(vm, page);
+        vm->heap.swept_bytes += before - vm->bytes_allocated;
+        __atomic_store_n(&page->state, GC_PAGE_SWEPT, __ATOMIC_RELEASE);
+        return;
+    }
+
+#ifdef GC_THREADS
+    /* the sweeper got to it first, a page does not take long */
+    while (GC_PAGE_SWEPT != __atomic_load_n(&page->state, __ATOMIC_ACQUIRE))
+        sched_yield();
+#endif /* GC_THREADS */
+}
+
+
+/* 
+ * frees what the page's dead objects own and clears its mark bits, 
+ * only the dead objects are touched, the survivors are found through the bitmaps 
+ * \returns the number of dead objects
+ */
+static size_t gc_sweep_page(VM_t* vm, GCPage_t* page)
+{
+    size_t freed = 0;
+    uint32_t live = 0;
+    /* the dead cells are linked in address order in front of the free list */
+    uint32_t* link = &page->free_cell;
+    uint32_t rest = page->free_cell;
+    for (int w = 0; w < GC_PAGE_BITMAP_WORDS; w++)
+    {
+        uint64_t marked = page->mark_bits[w];
+        for (uint64_t dead = page->alloc_bits[w] & ~marked; 0 != dead; dead &= dead - 1)
+        {
+            size_t granule = w * 64 + __builtin_ctzll(dead);
+            Obj_t* the_sinful = (Obj_t*)((uint8_t*)page + granule * GC_GRANULE);
+            Obj_Free(vm, the_sinful);
+#ifdef DEBUG_ALLOCATION_CHK
+            memset(the_sinful, 0, page->cell_size);
+#endif /* DEBUG_ALLOCATION_CHK */
+            *link = granule * GC_GRANULE;
+            link = (uint32_t*)the_sinful;
+            freed += 1;
+        }
+
+        page->alloc_bits[w] = marked;
+        page->mark_bits[w] = 0; /* for next sweep cycle */
+        live += __builtin_popcountll(marked);
+    }
+
+    *link = rest;
+    page->live_count = live;
+    return freed;
+}
+
+
+
+
+
+
+
+
+#ifndef ALLOCATOR_DEFAULT
+
+/* 
+ * empties the sparsest pages of every size into the other pages of that size 
+ * and updates the references to the moved objects
+ */
+static void gc_evacuate_pages(VM_t* vm)
+{
+    bool evacuated = false;
+    for (int i = 0; i < GC_CLASS_COUNT; i++)
+    {
+        evacuated |= gc_evacuate_class(vm, i);
+    }
+    if (!evacuated)
+        return;
+
+    compact_visit_all(vm, COMPACT_EVACUATE);
+    for (int i = 0; i < GC_CLASS_COUNT; i++)
+    {
+        gc_free_evacuated(vm, i);
+    }
+}
+
+
+/* \returns true if a page was evacuated */
+static bool gc_evacuate_class(VM_t* vm, int size_class)
+{
+    GCPage_t* pages = vm->heap.classes[size_class].pages;
+    size_t page_count = 0;
+    size_t live = 0;
+    for (GCPage_t* page = pages; NULL != page; page = page->next)
+    {
+        page_count += 1;
+        live += page->live_count;
+    }
+    if (NULL == pages)
+        return false;
+
+    size_t needed = (live + pages->cell_count - 1) / pages->cell_count;
+    if (0 == needed)
+        needed = 1;
+    if (needed >= page_count)
+        return false;
+
+
+    /* the densest pages have room for everything in the others */
+    for (size_t i = needed; i < page_count; i++)
+    {
+        GCPage_t* sparsest = NULL;
+        for (GCPage_t* page = pages; NULL != page; page = page->next)
+        {
+            if (GC_PAGE_EVACUATED != page->state
+            && (NULL == sparsest || page->live_count < sparsest->live_count))
+            {
+                sparsest = page;
+            }
+        }
+        sparsest->state = GC_PAGE_EVACUATED;
+    }
+
+
+    GCPage_t* to = pages;
+    for (GCPage_t* page = pages; NULL != page; page = page->next)
+    {
+        if (GC_PAGE_EVACUATED != page->state)
+            continue;
+
+        for (int w = 0; w < GC_PAGE_BITMAP_WORDS; w++)
+        {
+            for (uint64_t bits = page->alloc_bits[w]; 0 != bits; bits &= bits - 1)
+            {
+                size_t granule = w * 64 + __builtin_ctzll(bits);
+                Obj_t* obj = (Obj_t*)((uint8_t*)page + granule * GC_GRANULE);
+
+                Obj_t* moved = NULL;
+                while (NULL == moved)
+                {
+                    if (GC_PAGE_EVACUATED != to->state)
+                        moved = gc_page_alloc(to);
+                    if (NULL == moved)
+                        to = to->next;
+                }
+                memcpy(moved, obj, page->cell_size);
+
+                /* a closed upvalue points to itself */
+                if (OBJ_UPVAL == obj->type 
+                && ((ObjUpval_t*)obj)->location == &((ObjUpval_t*)obj)->closed)
+                {
+                    ((ObjUpval_t*)moved)->location = &((ObjUpval_t*)moved)->closed;
+                }
+                ((GCForward_t*)obj)->to = moved;
+            }
+        }
+    }
+    return true;
+}
+
+
+static void gc_free_evacuated(VM_t* vm, int size_class)
+{
+    GCPage_t* prev = NULL;
+    GCPage_t* page = vm->heap.classes[size_class].pages;
+    while (NULL != page)
+    {
+        GCPage_t* next = page->next;
+        if (GC_PAGE_EVACUATED == page->state)
+        {
+            if (NULL == prev)
+                vm->heap.classes[size_class].pages = next;
+            else
+                prev->next = next;
+
+            Allocator_FreeAligned(vm->alloc, page);
+            vm->heap.page_count -= 1;
+        }
+        else
+        {
+            prev = page;
+        }
+        page = next;
+    }
+
+    vm->heap.classes[size_class].tail = prev;
+    vm->heap.classes[size_class].alloc = vm->heap.classes[size_class].pages;
+}
+
+
+/* 
+ * Lisp-2 style sliding compaction of the allocator's region:
+ *  the blocks the vm owns are given the lowest address they can slide to, in address order,
+ *  the references to them are updated, then they are moved and the gaps left become the new free list
+ *  the pages only slide by multiples of their alignment, the blocks the vm does not know about stay where they are 
+ */
+static void gc_slide(VM_t* vm)
+{
+    Allocator_t* alloc = vm->alloc;
+    uint8_t* begin = alloc->head;
+    uint8_t* end = alloc->head + alloc->capacity;
+
+    for (FreeHeader_t* node = alloc->free_head; NULL != node; node = node->next)
+    {
+        node->capacity |= COMPACT_FREE;
+    }
+    compact_visit_all(vm, COMPACT_FLAG);
+
+
+    /* the forwarding address of a block is kept in its header's next */
+    uint8_t* cursor = begin;
+    for (uint8_t* ptr = begin; ptr < end; )
+    {
+        FreeHeader_t* node = (FreeHeader_t*)ptr;
+        bufsize_t flags = node->capacity & COMPACT_FLAGS;
+        ptr += sizeof(FreeHeader_t) + (node->capacity & ~(bufsize_t)COMPACT_FLAGS);
+
+        if (flags & COMPACT_FREE)
+            continue;
+
+        uint8_t* to = (flags & COMPACT_MOVABLE) ? cursor : (uint8_t*)node;
+        if (flags & COMPACT_PAGE)
+        {
+            /* the gap in front of a page must be able to hold a free node */
+            uint8_t* page = cursor;
+            do {
+                page = (uint8_t*)(
+                    ((uintptr_t)page + sizeof(FreeHeader_t) + GC_PAGE_SIZE - 1) & ~(uintptr_t)(GC_PAGE_SIZE - 1)
+                );
+                to = page - sizeof(FreeHeader_t);
+            } while (to != cursor && to < cursor + MIN_CAPACITY);
+
+            if (to > (uint8_t*)node)
+                to = (uint8_t*)node;
+        }
+        node->next = (FreeHeader_t*)to;
+        cursor = to + (ptr - (uint8_t*)node);
+    }
+
+    compact_visit_all(vm, COMPACT_UPDATE);
+
+
+    /* every move is to a lower address than the blocks still to be moved */
+    FreeHeader_t* last = NULL;
+    alloc->free_head = NULL;
+    cursor = begin;
+    for (uint8_t* ptr = begin; ptr < end; )
+    {
+        FreeHeader_t* node = (FreeHeader_t*)ptr;
+        bufsize_t flags = node->capacity & COMPACT_FLAGS;
+        bufsize_t capacity = node->capacity & ~(bufsize_t)COMPACT_FLAGS;
+        ptr += sizeof(FreeHeader_t) + capacity;
+
+        if (flags & COMPACT_FREE)
+            continue;
+
+        FreeHeader_t* to = node->next;
+        gc_release_gap(alloc, cursor, (uint8_t*)to, last);
+        if (to != node)
+            memmove(to, node, sizeof(FreeHeader_t) + capacity);
+        set_header(to, capacity, NULL, NODE_ALIVE);
+        last = to;
+        cursor = GET_PTR(last) + capacity;
+    }
+    gc_release_gap(alloc, cursor, end, last);
+}
+
+
+/* the gap becomes a free node, or part of the block before it if it is too small */
+static void gc_release_gap(Allocator_t* allocator, uint8_t* from, uint8_t* to, FreeHeader_t* last)
+{
+    if (from == to)
+        return;
+
+    if ((size_t)(to - from) < MIN_CAPACITY)
+    {
+        CLOX_ASSERT(NULL != last && "a small gap always follows a block that moved");
+        last->capacity += to - from;
+        return;
+    }
+
+    FreeHeader_t* node = (FreeHeader_t*)from;
+    set_header(node, to - from - sizeof(FreeHeader_t), NULL, NODE_FREED);
+    insert_free_node(allocator, node);
+}
+
+
+
+static void compact_visit_all(VM_t* vm, CompactPhase_t phase)
+{
+    /* the frames come first, their ip is found through their chunk before anything is updated */
+    for (int i = 0; i < vm->frame_count; i++)
+    {
+        CallFrame_t* frame = &vm->frames[i];
+        uint8_t* code = DEREF(ObjFunction_t, frame->closure->fun)->chunk.code;
+        frame->ip = (uint8_t*)compact_buf(code, phase) + (frame->ip - code);
+        frame->closure = (ObjClosure_t*)compact_obj((Obj_t*)frame->closure, phase);
+    }
+    for (Value_t* val = vm->stack; val < vm->sp; val++)
+    {
+        *val = compact_val(*val, phase);
+    }
+    vm->open_upvals = (ObjUpval_t*)compact_obj((Obj_t*)vm->open_upvals, phase);
+
+    compact_table(&vm->strings, phase);
+    compact_table(&vm->globals, phase);
+    for (int i = 0; i < OBJ_TYPE_COUNT; i++)
+    {
+        compact_table(&vm->methods[i], phase);
+    }
+    vm->gray_stack = compact_buf(vm->gray_stack, phase);
+
+
+    ObjString_t** strs[] = {
+        &vm->init_str,
+        &vm->native.array.open_bracket, &vm->native.array.comma, &vm->native.array.close_bracket,
+        &vm->native.str.nativefn, &vm->native.str.script, &vm->native.str.array, &vm->native.str.table,
+        &vm->native.str.true_, &vm->native.str.false_, &vm->native.str.nil, &vm->native.str.empty,
+    };
+    for (size_t i = 0; i < STATIC_ARRSZ(strs); i++)
+    {
+        *strs[i] = (ObjString_t*)compact_obj((Obj_t*)*strs[i], phase);
+    }
+
+
+    /* the pages and large objects are moved along with the buffers, their lists are updated through the links */
+    for (int i = 0; i < GC_CLASS_COUNT; i++)
+    {
+        GCPage_t** link = &vm->heap.classes[i].pages;
+        while (NULL != *link)
+        {
+            GCPage_t* page = *link;
+            if (GC_PAGE_EVACUATED != page->state)
+            {
+                for (int w = 0; w < GC_PAGE_BITMAP_WORDS; w++)
+                {
+                    for (uint64_t bits = page->alloc_bits[w]; 0 != bits; bits &= bits - 1)
+                    {
+                        size_t granule = w * 64 + __builtin_ctzll(bits);
+                        compact_visit_obj((Obj_t*)((uint8_t*)page + granule * GC_GRANULE), phase);
+                    }
+                }
+                if (COMPACT_FLAG == phase)
+                    GET_HEADER(page)->capacity |= COMPACT_PAGE;
+            }
+            *link = compact_buf(page, phase);
+            link = &page->next;
+        }
+        vm->heap.classes[i].tail = compact_buf(vm->heap.classes[i].tail, phase);
+        vm->heap.classes[i].alloc = compact_buf(vm->heap.classes[i].alloc, phase);
+    }
+
+    GCLargeObj_t** link = &vm->heap.large;
+    while (NULL != *link)
+    {
+        GCLargeObj_t* large = *link;
+        compact_visit_obj((Obj_t*)(large + 1), phase);
+        *link = compact_buf(large, phase);
+        link = &large->next;
+    }
+}
+
+
+/* updates the references of an object, the buffers it owns are updated after their contents */
+static void compact_visit_obj(Obj_t* obj, CompactPhase_t phase)
+{
+    switch (obj->type)
+    {
+    case OBJ_NATIVE:
+    case OBJ_TYPED_ARRAY:
+        break;
+
+    case OBJ_STRING:
+    {
+#ifndef OBJSTR_FLEXIBLE_ARR
+        ObjString_t* str = (ObjString_t*)obj;
+        str->cstr = compact_buf(str->cstr, phase);
+#endif /* OBJSTR_FLEXIBLE_ARR */
+    }
+    break;
+
+    case OBJ_ARRAY:
+        compact_array((ObjArray_t*)obj, phase);
+        break;
+
+    case OBJ_MAP:
+        compact_map(&((ObjMap_t*)obj)->map, phase);
+        break;
+
+    case OBJ_DEQUE:
+        compact_deque((ObjDeque_t*)obj, phase);
+        break;
+
+    case OBJ_PQUEUE:
+        compact_pqueue((ObjPQueue_t*)obj, phase);
+        break;
+
+    case OBJ_SET:
+        compact_map(&((ObjSet_t*)obj)->map, phase);
+        break;
+
+    case OBJ_PNODE:
+    {
+        ObjPNode_t* node = (ObjPNode_t*)obj;
+        for (uint32_t i = 0; i < node->len; i++)
+        {
+            node->slots[i] = compact_val(node->slots[i], phase);
+        }
+    }
+    break;
+
+    case OBJ_PVEC:
+    {
+        ObjPVec_t* vec = (ObjPVec_t*)obj;
+        vec->root = REF((ObjPNode_t*)compact_obj((Obj_t*)DEREF_NULLABLE(ObjPNode_t, vec->root), phase));
+        vec->tail = REF((ObjPNode_t*)compact_obj((Obj_t*)DEREF_NULLABLE(ObjPNode_t, vec->tail), phase));
+    }
+    break;
+
+    case OBJ_PMAP:
+    {
+        ObjPMap_t* map = (ObjPMap_t*)obj;
+        map->root = REF((ObjPNode_t*)compact_obj((Obj_t*)DEREF_NULLABLE(ObjPNode_t, map->root), phase));
+    }
+    break;
+
+    case OBJ_BOUND_METHOD:
+    {
+        ObjBoundMethod_t* bmd = (ObjBoundMethod_t*)obj;
+        bmd->receiver = compact_val(bmd->receiver, phase);
+        bmd->method = REF((ObjClosure_t*)compact_obj((Obj_t*)DEREF(ObjClosure_t, bmd->method), phase));
+    }
+    break;
+
+    case OBJ_INSTANCE:
+    {
+        ObjInstance_t* inst = (ObjInstance_t*)obj;
+        inst->klass = (ObjClass_t*)compact_obj((Obj_t*)inst->klass, phase);
+        compact_table(&inst->fields, phase);
+    }
+    break;
+
+    case OBJ_CLASS:
+    {
+        ObjClass_t* klass = (ObjClass_t*)obj;
+        klass->name = (ObjString_t*)compact_obj((Obj_t*)klass->name, phase);
+        compact_table(&klass->methods, phase);
+    }
+    break;
+
+    case OBJ_UPVAL:
+    {
+        /* its location is either on the vm's stack or its own closed, which is moved along with it */
+        ObjUpval_t* upval = (ObjUpval_t*)obj;
+        if (upval->location == &upval->closed)
+            upval->location = &((ObjUpval_t*)compact_obj(obj, phase))->closed;
+        upval->closed = compact_val(upval->closed, phase);
+        upval->next = REF((ObjUpval_t*)compact_obj((Obj_t*)DEREF_NULLABLE(ObjUpval_t, upval->next), phase));
+    }
+    break;
+
+    case OBJ_FUNCTION:
+    {
+        ObjFunction_t* fun = (ObjFunction_t*)obj;
+        fun->name = (ObjString_t*)compact_obj((Obj_t*)fun->name, phase);
+        fun->chunk.code = compact_buf(fun->chunk.code, phase);
+        fun->chunk.line_info.at = compact_buf(fun->chunk.line_info.at, phase);
+        compact_valarr(&fun->chunk.consts, phase);
+    }
+    break;
+
+    case OBJ_CLOSURE:
+    {
+        ObjClosure_t* closure = (ObjClosure_t*)obj;
+        closure->fun = REF((ObjFunction_t*)compact_obj((Obj_t*)DEREF(ObjFunction_t, closure->fun), phase));
+        for (int i = 0; i < closure->upval_count; i++)
+        {
+            closure->upvals[i] = REF((ObjUpval_t*)compact_obj((Obj_t*)DEREF_NULLABLE(ObjUpval_t, closure->upvals[i]), phase));
+        }
+    }
+    break;
+
+    case OBJ_ROPE:
+    {
+        ObjRope_t* rope = (ObjRope_t*)obj;
+        rope->left = REF(compact_obj(DEREF(Obj_t, rope->left), phase));
+        rope->right = REF(compact_obj(DEREF_NULLABLE(Obj_t, rope->right), phase));
+    }
+    break;
+
+    case OBJ_SLICE:
+    {
+        ObjSlice_t* slice = (ObjSlice_t*)obj;
+        slice->parent = REF((ObjString_t*)compact_obj((Obj_t*)DEREF(ObjString_t, slice->parent), phase));
+    }
+    break;
+    }
+}
+
+
+static void compact_table(Table_t* table, CompactPhase_t phase)
+{
+    for (size_t i = 0; i < table->capacity; i++)
+    {
+        if (NULL == table->keys[i])
+            continue;
+        table->keys[i] = (ObjString_t*)compact_obj((Obj_t*)table->keys[i], phase);
+        table->vals[i] = compact_val(table->vals[i], phase);
+    }
+
+    /* the vals and ctrl arrays are in the same buffer as the keys */
+    table->keys = compact_buf(table->keys, phase);
+    if (NULL != table->keys)
+    {
+        table->vals = (Value_t*)(table->keys + table->capacity);
+        table->ctrl = (uint8_t*)(table->vals + table->capacity);
+    }
+}
+
+
+/* the objects other than strings are hashed by their address, the map is rehashed once any key moved */
+static void compact_map(Map_t* map, CompactPhase_t phase)
+{
+    for (size_t i = 0; i < map->capacity; i++)
+    {
+        if (!Map_IsFull(map, i))
+            continue;
+
+        Value_t key = compact_val(map->keys[i], phase);
+        if (IS_OBJ(key) && AS_OBJ(key) != AS_OBJ(map->keys[i]))
+            map->moved = true;
+        map->keys[i] = key;
+        map->vals[i] = compact_val(map->vals[i], phase);
+    }
+
+    /* the vals and ctrl arrays are in the same buffer as the keys */
+    map->keys = compact_buf(map->keys, phase);
+    if (NULL != map->keys)
+    {
+        map->vals = map->keys + map->capacity;
+        map->ctrl = (uint8_t*)(map->vals + map->capacity);
+    }
+}
+
+
+static void compact_deque(ObjDeque_t* deque, CompactPhase_t phase)
+{
+    for (size_t i = 0; i < deque->count; i++)
+    {
+        size_t index = (deque->head + i) & (deque->capacity - 1);
+        deque->vals[index] = compact_val(deque->vals[index], phase);
+    }
+    deque->vals = compact_buf(deque->vals, phase);
+}
+
+
+static void compact_pqueue(ObjPQueue_t* pq, CompactPhase_t phase)
+{
+    pq->cmp = compact_val(pq->cmp, phase);
+    for (size_t i = 0; i < pq->count; i++)
+    {
+        pq->entries[i].val = compact_val(pq->entries[i].val, phase);
+    }
+    pq->entries = compact_buf(pq->entries, phase);
+}
+
+
+static void compact_valarr(ValueArr_t* va, CompactPhase_t phase)
+{
+    for (size_t i = 0; i < va->size; i++)
+    {
+        va->vals[i] = compact_val(va->vals[i], phase);
+    }
+    va->vals = compact_buf(va->vals, phase);
+}
+
+
+static void compact_array(ObjArray_t* arr, CompactPhase_t phase)
+{
+    if (ObjArr_IsShared(arr))
+    {
+        /* the frozen array updates the elements, and the buffer the same way whichever of them is first */
+        ObjArray_t* frozen = DEREF(ObjArray_t, arr->shared);
+        arr->shared = REF((ObjArray_t*)compact_obj((Obj_t*)frozen, phase));
+
+        const size_t offset = arr->start * (ELEMS_NUMBERS == arr->kind ? sizeof(double) : sizeof(Value_t));
+        uint8_t* buf = (uint8_t*)arr->as.vals - offset;
+        arr->as.vals = (Value_t*)((uint8_t*)compact_buf(buf, phase) + offset);
+        return;
+    }
+
+    if (ELEMS_VALUES == arr->kind)
+    {
+        for (size_t i = 0; i < arr->size; i++)
+        {
+            arr->as.vals[i] = compact_val(arr->as.vals[i], phase);
+        }
+    }
+    arr->as.vals = compact_buf(arr->as.vals, phase);
+}
+
+
+/* buf is the start of one of the allocator's blocks */
+static void* compact_buf(void* buf, CompactPhase_t phase)
+{
+    if (NULL == buf)
+        return NULL;
+
+    FreeHeader_t* header = GET_HEADER(buf);
+    switch (phase)
+    {
+    case COMPACT_EVACUATE:
+        break;
+
+    case COMPACT_FLAG:
+        header->capacity |= COMPACT_MOVABLE;
+        break;
+
+    case COMPACT_UPDATE:
+        if (header->capacity & COMPACT_MOVABLE)
+            return GET_PTR(header->next);
+        break;
+    }
+    return buf;
+}
+
+
+static Obj_t* compact_obj(Obj_t* obj, CompactPhase_t phase)
+{
+    if (NULL == obj)
+        return NULL;
+
+    switch (phase)
+    {
+    case COMPACT_EVACUATE:
+        if (!obj->is_large && GC_PAGE_EVACUATED == GC_PAGE_OF(obj)->state)
+            return ((GCForward_t*)obj)->to;
+        break;
+
+    case COMPACT_FLAG: /* the large objects are flagged through the heap's list */
+        break;
+
+    case COMPACT_UPDATE:
+        if (obj->is_large)
+            return (Obj_t*)((GCLargeObj_t*)compact_buf(GC_LARGE_HEADER(obj), phase) + 1);
+        else
+        {
+            GCPage_t* page = GC_PAGE_OF(obj);
+            return (Obj_t*)((uint8_t*)compact_buf(page, phase) + ((uint8_t*)obj - (uint8_t*)page));
+        }
+    }
+    return obj;
+}
+
+
+static Value_t compact_val(Value_t val, CompactPhase_t phase)
+{
+    if (IS_OBJ(val))
+        return OBJ_VAL(compact_obj(AS_OBJ(val), phase));
+    return val;
+}
+
+#endif /* ALLOCATOR_DEFAULT */
+
+
+
+
+
+
+
+
+#ifdef GC_THREADS
+
+static void gc_trace_parallel(VM_t* vm)
+{
+    int count = vm->gc_mark_threads;
+    if (count > GC_MARK_THREADS_MAX)
+        count = GC_MARK_THREADS_MAX;
+    if (!gc_workers_reserve(vm, count))
+    {
+        /* not enough memory for the deques, the gray stack still works */
+        while (vm->gray_count > 0)
+            gc_blacken_obj(vm, vm->gray_stack[--vm->gray_count]);
+        return;
+    }
+
+
+    int idle = 0;
+    GCWorker_t* workers = vm->gc_workers;
+    for (int i = 0; i < count; i++)
+    {
+        workers[i].vm = vm;
+        workers[i].top = 0;
+        workers[i].bottom = 0;
+        workers[i].all = workers;
+        workers[i].count = count;
+        workers[i].idle = &idle;
+        workers[i].seed = 2654435761u * (i + 1);
+        workers[i].started = false;
+    }
+
+    /* 
+     * deal the roots out, no worker is running yet so any thread can push,
+     * the ones that do not fit stay on the gray stack 
+     */
+    int left = 0;
+    for (int i = 0; i < vm->gray_count; i++)
+    {
+        if (!worker_push(&workers[i % count], vm->gray_stack[i]))
+            vm->gray_stack[left++] = vm->gray_stack[i];
+    }
+    vm->gray_count = left;
+
+
+    for (int i = 1; i < count; i++)
+    {
+        GCWorker_t* worker = &workers[i];
+        worker->started = 0 == pthread_create(&worker->thread, NULL, gc_worker_run, worker);
+        if (!worker->started)
+        {
+            /* 
+             * nobody will ever take from its bottom, 
+             * so its roots are moved to the collecting thread 
+             * and the worker is counted as idle for good 
+             */
+            Obj_t* obj;
+            while (NULL != (obj = worker_take(worker)))
+            {
+                if (!worker_push(&workers[0], obj))
+                    worker_overflow(&workers[0], obj);
+            }
+            __atomic_fetch_add(&idle, 1, __ATOMIC_SEQ_CST);
+        }
+    }
+    gc_worker_run(&workers[0]);
+
+
+    for (int i = 0; i < count; i++)
+    {
+        if (workers[i].started)
+            pthread_join(workers[i].thread, NULL);
+
+        GCDequeBuf_t* retired = workers[i].buf->retired;
+        workers[i].buf->retired = NULL;
+        while (NULL != retired)
+        {
+            GCDequeBuf_t* next = retired->retired;
+            free(retired);
+            retired = next;
+        }
+    }
+
+    /* the workers are done, what their deques could not take is marked by this thread */
+    while (vm->gray_count > 0)
+        gc_blacken_obj(vm, vm->gray_stack[--vm->gray_count]);
+}
+
+
+static void* gc_worker_run(void* arg)
+{
+    GCWorker_t* self = arg;
+    s_worker = self;
+
+    while (true)
+    {
+        Obj_t* obj = worker_take(self);
+        if (NULL == obj)
+            obj = worker_steal_any(self);
+        if (NULL != obj)
+        {
+            gc_blacken_obj(self->vm, obj);
+            continue;
+        }
+
+
+        /* 
+         * a worker only goes idle with an empty deque and never pushes while idle,
+         * so once every worker is idle there is nothing left to mark
+         */
+        __atomic_fetch_add(self->idle, 1, __ATOMIC_SEQ_CST);
+        while (true)
+        {
+            if (worker_can_steal(self))
+            {
+                __atomic_fetch_sub(self->idle, 1, __ATOMIC_SEQ_CST);
+                break;
+            }
+            if (__atomic_load_n(self->idle, __ATOMIC_SEQ_CST) == self->count)
+                goto done;
+            sched_yield();
+        }
+    }
+
+done:
+    s_worker = NULL;
+    return NULL;
+}
+
+
+static bool gc_workers_reserve(VM_t* vm, int count)
+{
+    if (vm->gc_worker_count >= count)
+        return true;
+
+    /* 
+     * the workers' deques live outside of the vm's allocator, 
+     * it is not thread safe and the workers grow their deques concurrently 
+     */
+    GCWorker_t* workers = realloc(vm->gc_workers, sizeof(*workers) * count);
+    if (NULL == workers)
+        return false;
+
+    vm->gc_workers = workers;
+    for (int i = vm->gc_worker_count; i < count; i++)
+    {
+        workers[i].buf = deque_buf_create(GC_DEQUE_INITIAL_CAPACITY);
+        if (NULL == workers[i].buf)
+        {
+            /* the vm keeps the workers it had and nothing of the new ones */
+            while (i-- > vm->gc_worker_count)
+            {
+                free(workers[i].buf);
+                workers[i].buf = NULL;
+            }
+            return false;
+        }
+    }
+    vm->gc_worker_count = count;
+    return true;
+}
+
+
+
+
+
+
+
+static bool worker_push(GCWorker_t* worker, Obj_t* obj)
+{
+    int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE);
+    GCDequeBuf_t* buf = __atomic_load_n(&worker->buf, __ATOMIC_RELAXED);
+
+    if (bottom - top > buf->capacity - 1)
+    {
+        GCDequeBuf_t* bigger = deque_buf_create(buf->capacity * 2);
+        if (NULL == bigger)
+            return false;
+        for (int64_t i = top; i < bottom; i++)
+        {
+            bigger->objs[i & (bigger->capacity - 1)] = buf->objs[i & (buf->capacity - 1)];
+        }
+        bigger->retired = buf;
+        __atomic_store_n(&worker->buf, bigger, __ATOMIC_RELEASE);
+        buf = bigger;
+    }
+
+    __atomic_store_n(&buf->objs[bottom & (buf->capacity - 1)], obj, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+
+/* 
+ * obj goes on the vm's gray stack, which the collecting thread drains once the workers are done,
+ * obj is already marked so no worker pushes it again 
+ */
+static void worker_overflow(GCWorker_t* worker, Obj_t* obj)
+{
+    pthread_mutex_lock(&s_overflow_lock);
+    gc_gray_push(worker->vm, obj);
+    pthread_mutex_unlock(&s_overflow_lock);
+}
+
+
+static Obj_t* worker_take(GCWorker_t* worker)
+{
+    int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED) - 1;
+    GCDequeBuf_t* buf = __atomic_load_n(&worker->buf, __ATOMIC_RELAXED);
+    __atomic_store_n(&worker->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&worker->top, __ATOMIC_RELAXED);
+
+    if (top > bottom) /* empty */
+    {
+        __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    Obj_t* obj = __atomic_load_n(&buf->objs[bottom & (buf->capacity - 1)], __ATOMIC_RELAXED);
+    if (top == bottom) /* last one, race the thieves for it */
+    {
+        if (!__atomic_compare_exchange_n(&worker->top, &top, top + 1, 
+            false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        {
+            obj = NULL;
+        }
+        __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+    return obj;
+}
+
+
+static Obj_t* worker_steal(GCWorker_t* victim)
+{
+    int64_t top = __atomic_load_n(&victim->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&victim->bottom, __ATOMIC_ACQUIRE);
+    if (top >= bottom)
+        return NULL;
+
+    GCDequeBuf_t* buf = __atomic_load_n(&victim->buf, __ATOMIC_ACQUIRE);
+    Obj_t* obj = __atomic_load_n(&buf->objs[top & (buf->capacity - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&victim->top, &top, top + 1, 
+        false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+    {
+        return NULL;
+    }
+    return obj;
+}
+
+
+static Obj_t* worker_steal_any(GCWorker_t* thief)
+{
+    /* xorshift, so that the thieves don't all line up behind the same victim */
+    thief->seed ^= thief->seed << 13;
+    thief->seed ^= thief->seed >> 17;
+    thief->seed ^= thief->seed << 5;
+
+    int start = thief->seed % thief->count;
+    for (int i = 0; i < thief->count; i++)
+    {
+        GCWorker_t* victim = &thief->all[(start + i) % thief->count];
+        if (victim == thief)
+            continue;
+
+        Obj_t* obj = worker_steal(victim);
+        if (NULL != obj)
+            return obj;
+    }
+    return NULL;
+}
+
+
+static bool worker_can_steal(const GCWorker_t* thief)
+{
+    for (int i = 0; i < thief->count; i++)
+    {
+        const GCWorker_t* victim = &thief->all[i];
+        if (victim != thief
+        && __atomic_load_n(&victim->top, __ATOMIC_ACQUIRE) 
+            < __atomic_load_n(&victim->bottom, __ATOMIC_ACQUIRE))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static GCDequeBuf_t* deque_buf_create(int64_t capacity)
+{
+    GCDequeBuf_t* buf = malloc(sizeof(*buf) + sizeof(buf->objs[0]) * capacity);
+    if (NULL == buf)
+        return NULL;
+
+    buf->capacity = capacity;
+    buf->retired = NULL;
+    return buf;
+}
+
+
+
+
+
+
+
+/* 
+ *  starts a thread sweeping the pages that the vm has not needed yet,
+ *  the vm and the sweeper claim a page before sweeping it, so each page is swept only once 
+ *  if the thread could not be started, lazy sweeping does all the work
+ */
+static void gc_sweep_background(VM_t* vm)
+{
+    if (NULL == vm->gc_sweeper)
+    {
+        vm->gc_sweeper = malloc(sizeof(*vm->gc_sweeper));
+        if (NULL == vm->gc_sweeper)
+            return;
+        vm->gc_sweeper->running = false;
+    }
+
+    GCSweeper_t* sweeper = vm->gc_sweeper;
+    sweeper->vm = vm;
+    vm->alloc->sweeper = sweeper;
+    sweeper->freed_count = 0;
+    sweeper->freed_bufs = 0;
+    sweeper->freed_bytes = 0;
+    sweeper->running = 0 == pthread_create(&sweeper->thread, NULL, gc_sweeper_run, sweeper);
+}
+
+
+static void* gc_sweeper_run(void* arg)
+{
+    GCSweeper_t* sweeper = arg;
+    GCHeap_t* heap = &sweeper->vm->heap;
+    s_sweeper = sweeper;
+
+    for (int i = 0; i < GC_CLASS_COUNT; i++)
+    {
+        /* the vm might be adding pages to the list, those never need a sweep */
+        for (GCPage_t* page = __atomic_load_n(&heap->classes[i].pages, __ATOMIC_ACQUIRE);
+            NULL != page;
+            page = __atomic_load_n(&page->next, __ATOMIC_ACQUIRE))
+        {
+            int unswept = GC_PAGE_UNSWEPT;
+            if (__atomic_compare_exchange_n(&page->state, &unswept, GC_PAGE_SWEEPING, 
+                false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            {
+                sweeper->freed_count += gc_sweep_page(sweeper->vm, page);
+                __atomic_store_n(&page->state, GC_PAGE_SWEPT, __ATOMIC_RELEASE);
+            }
+        }
+    }
+
+    s_sweeper = NULL;
+    return NULL;
+}
+
+
+/* lock free push, the sweeper's side of the handoff */
+static void hand_off_free_node(Allocator_t* allocator, FreeHeader_t* node)
+{
+    FreeHeader_t* head = __atomic_load_n(&allocator->pending, __ATOMIC_RELAXED);
+    do {
+        node->next = head;
+    } while (!__atomic_compare_exchange_n(&allocator->pending, &head, node, 
+        true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+
+/* the owner's side of the handoff */
+static void take_pending_nodes(Allocator_t* allocator)
+{
+    if (NULL == __atomic_load_n(&allocator->pending, __ATOMIC_RELAXED))
+        return;
+
+    FreeHeader_t* node = __atomic_exchange_n(&allocator->pending, NULL, __ATOMIC_ACQUIRE);
+    while (NULL != node)
+    {
+        FreeHeader_t* next = node->next;
+        node->next = NULL;
+        insert_free_node(allocator, node);
+        node = next;
+    }
+}
+
+
+/* 
+ * waits for the background sweeper and takes what it freed, 
+ * \returns false if it was not running, pending was already taken then
+ */
+static bool finish_pending(Allocator_t* allocator)
+{
+    GCSweeper_t* sweeper = allocator->sweeper;
+    if (NULL == sweeper || !sweeper->running)
+        return false;
+
+    GC_FinishSweep(sweeper->vm);
+    take_pending_nodes(allocator);
+    return true;
+}
+
+#endif /* GC_THREADS */
+
+
@@ -2,22 +2,48 @@
 
 #include <time.h>
 #include <math.h>
+#include <string.h>
+#include <limits.h>
 
 #include "include/common.h"
 #include "include/object.h"
 #include "include/value.h"
 #include "include/object.h"
 #include "include/vm.h"
+#include "include/typedarr.h"
+#include "include/persistent.h"
 
 
 
 
-static ObjString_t* str_from_array(VM_t* vm, const ValueArr_t* arr, bool recurse);
-static ObjString_t* str_from_val(VM_t* vm, Value_t val, bool recurse);
-static ObjString_t* str_from_number(VM_t* vm, double number);
-static ObjString_t* str_from_obj(VM_t* vm, Value_t val, bool recurse);
-static ObjString_t* str_from_fun(VM_t* vm, const ObjFunction_t* fun);
-static ObjString_t* str_from_table(VM_t* vm, const Table_t table, bool recurse);
+/* what write_pmap passes to write_pair */
+typedef struct PairWriter_t
+{
+    StrBuilder_t* builder;
+    size_t written;
+    size_t count;
+} PairWriter_t;
+
+static void write_val(StrBuilder_t* builder, Value_t val, bool recurse);
+static void write_number(StrBuilder_t* builder, double number);
+static void write_obj(StrBuilder_t* builder, Value_t val, bool recurse);
+static void write_array(StrBuilder_t* builder, const ObjArray_t* array, bool recurse);
+static void write_map(StrBuilder_t* builder, const Map_t* map, bool recurse);
+static void write_typed(StrBuilder_t* builder, const ObjTypedArr_t* arr, bool recurse);
+static void write_deque(StrBuilder_t* builder, const ObjDeque_t* deque, bool recurse);
+static void write_set(StrBuilder_t* builder, const Map_t* set, bool recurse);
+static void write_pvec(StrBuilder_t* builder, const ObjPVec_t* vec, bool recurse);
+static void write_pmap(StrBuilder_t* builder, const ObjPMap_t* map, bool recurse);
+static void write_pair(void* ctx, Value_t key, Value_t val);
+static void write_fun(StrBuilder_t* builder, const ObjFunction_t* fun);
+static void write_table(StrBuilder_t* builder, const Table_t table, bool recurse);
+static void write_str(StrBuilder_t* builder, const ObjString_t* str);
+
+static Obj_t* str_arg(VM_t* vm, Value_t* arg);
+static bool int_arg(VM_t* vm, Value_t arg, int* out);
+static bool same_typed(Value_t a, Value_t b);
+static Value_t typed_result(const ObjTypedArr_t* arr, double result);
+static int find_chars(StrView_t str, StrView_t substr, int from);
 
 
 
@@ -32,191 +58,682 @@ Value_t Native_Clock(VM_t* vm, int argc, Value_t* argv)
 Value_t Native_ToStr(VM_t* vm, int argc, Value_t* argv)
 {
     (void)argc;
-    return OBJ_VAL(str_from_val(vm, argv[0], true));
+    if (IS_STRING(argv[0]) || IS_SLICE(argv[0]))
+        return argv[0];
+    if (IS_ROPE(argv[0]))
+        return OBJ_VAL(ObjRope_Flatten(vm, AS_ROPE(argv[0])));
+
+    /* the pieces are copied into one buffer, only the result becomes a string */
+    StrBuilder_t builder;
+    StrBld_Init(&builder, vm);
+    write_val(&builder, argv[0], true);
+    return OBJ_VAL(StrBld_Finish(&builder));
 }
 
 
 Value_t Native_Array(VM_t* vm, int argc, Value_t* argv)
 {
-    (void)argc, (void)argv;
-    return OBJ_VAL(ObjArr_Create(vm));
+    int len = 0;
+    if (argc > 2 || (argc > 0 && (!int_arg(vm, argv[0], &len) || len < 0)))
+        return NIL_VAL();
+
+    ObjArray_t* arr = ObjArr_Create(vm);
+    if (0 == argc)
+        return OBJ_VAL(arr);
+
+    VM_Push(vm, OBJ_VAL(arr));
+    if (2 == argc && !IS_NUMBER(argv[1]))
+        arr->kind = ELEMS_VALUES;
+    ObjArr_Reserve(vm, arr, len);
+    if (2 == argc)
+    {
+        arr->size = len;
+        ObjArr_Fill(vm, arr, argv[1]);
+    }
+    VM_Pop(vm);
+    return OBJ_VAL(arr);
 }
 
 
 Value_t Native_ArrayCpy(VM_t* vm, int argc, Value_t* argv)
 {
+    (void)argc;
     if (!IS_ARRAY(argv[0]))
-        return Native_Array(vm, argc, argv);
+        return Native_Array(vm, 0, argv);
 
-    const ObjArray_t* old = (ObjArray_t*)AS_OBJ(argv[0]);
-    ObjArray_t* cpy = ObjArr_Create(vm);
-    ValArr_Reserve(&cpy->array, old->array.size);
-    memcpy(cpy->array.vals, old->array.vals, 
-        old->array.size * sizeof old->array.vals[0]
-    );
-    cpy->array.size = old->array.size;
-    return OBJ_VAL(cpy);
+    return OBJ_VAL(ObjArr_Copy(vm, AS_ARRAY(argv[0])));
 }
 
 
+Value_t Native_Map(VM_t* vm, int argc, Value_t* argv)
+{
+    (void)argc, (void)argv;
+    return OBJ_VAL(ObjMap_Create(vm));
+}
 
 
+Value_t Native_Deque(VM_t* vm, int argc, Value_t* argv)
+{
+    (void)argc, (void)argv;
+    return OBJ_VAL(ObjDeque_Create(vm));
+}
 
 
+Value_t Native_PriorityQueue(VM_t* vm, int argc, Value_t* argv)
+{
+    if (argc > 1)
+        return NIL_VAL();
+    return OBJ_VAL(ObjPQueue_Create(vm, 0 == argc ? NIL_VAL() : argv[0]));
+}
 
 
-static ObjString_t* str_from_val(VM_t* vm, Value_t val, bool recurse)
+Value_t Native_Set(VM_t* vm, int argc, Value_t* argv)
 {
-    ObjString_t* str = NULL;
+    (void)argc, (void)argv;
+    return OBJ_VAL(ObjSet_Create(vm));
+}
+
+
+Value_t Native_PVector(VM_t* vm, int argc, Value_t* argv)
+{
+    if (0 == argc)
+        return OBJ_VAL(ObjPVec_Create(vm, 0, PNODE_BITS, NULL, NULL));
+    if (argc > 1 || !IS_ARRAY(argv[0]))
+        return NIL_VAL();
+    return OBJ_VAL(PVec_FromArray(vm, AS_ARRAY(argv[0])));
+}
+
+
+Value_t Native_PMap(VM_t* vm, int argc, Value_t* argv)
+{
+    if (0 == argc)
+        return OBJ_VAL(ObjPMap_Create(vm, 0, NULL));
+    if (argc > 1 || !IS_MAP(argv[0]))
+        return NIL_VAL();
+
+    ObjPMap_t* map = PMap_FromMap(vm, &AS_MAP(argv[0])->map);
+    return NULL == map ? NIL_VAL() : OBJ_VAL(map);
+}
+
+
+Value_t Native_Float64Array(VM_t* vm, int argc, Value_t* argv)
+{
+    (void)argc;
+    int len;
+    if (!int_arg(vm, argv[0], &len) || len < 0)
+        return NIL_VAL();
+    return OBJ_VAL(ObjTyped_Create(vm, TYPED_F64, len));
+}
+
+
+Value_t Native_Int32Array(VM_t* vm, int argc, Value_t* argv)
+{
+    (void)argc;
+    int len;
+    if (!int_arg(vm, argv[0], &len) || len < 0)
+        return NIL_VAL();
+    return OBJ_VAL(ObjTyped_Create(vm, TYPED_I32, len));
+}
+
+
+Value_t Native_Sum(VM_t* vm, int argc, Value_t* argv)
+{
+    (void)argc, (void)vm;
+    if (!IS_TYPED_ARRAY(argv[0]))
+        return NIL_VAL();
+
+    const ObjTypedArr_t* arr = AS_TYPED_ARRAY(argv[0]);
+    return typed_result(arr, TypedArr_Sum(arr));
+}
+
+
+Value_t Native_Dot(VM_t* vm, int argc, Value_t* argv)
+{
+    (void)argc, (void)vm;
+    if (!same_typed(argv[0], argv[1]))
+        return NIL_VAL();
+
+    const ObjTypedArr_t* a = AS_TYPED_ARRAY(argv[0]);
+    return typed_result(a, TypedArr_Dot(a, AS_TYPED_ARRAY(argv[1])));
+}
+
+
+Value_t Native_Min(VM_t* vm, int argc, Value_t* argv)
+{
+    (void)argc, (void)vm;
+    if (!IS_TYPED_ARRAY(argv[0]) || 0 == AS_TYPED_ARRAY(argv[0])->len)
+        return NIL_VAL();
+
+    const ObjTypedArr_t* arr = AS_TYPED_ARRAY(argv[0]);
+    return typed_result(arr, TypedArr_Min(arr));
+}
+
+
+Value_t Native_Max(VM_t* vm, int argc, Value_t* argv)
+{
+    (void)argc, (void)vm;
+    if (!IS_TYPED_ARRAY(argv[0]) || 0 == AS_TYPED_ARRAY(argv[0])->len)
+        return NIL_VAL();
+
+    const ObjTypedArr_t* arr = AS_TYPED_ARRAY(argv[0]);
+    return typed_result(arr, TypedArr_Max(arr));
+}
+
+
+Value_t Native_Scale(VM_t* vm, int argc, Value_t* argv)
+{
+    (void)argc, (void)vm;
+    if (!IS_TYPED_ARRAY(argv[0]) || !IS_NUMBER(argv[1]))
+        return NIL_VAL();
+
+    TypedArr_Scale(AS_TYPED_ARRAY(argv[0]), AS_NUMBER(argv[1]));
+    return argv[0];
+}
+
+
+Value_t Native_Add(VM_t* vm, int argc, Value_t* argv)
+{
+    (void)argc, (void)vm;
+    if (!same_typed(argv[0], argv[1]))
+        return NIL_VAL();
+
+    TypedArr_Add(AS_TYPED_ARRAY(argv[0]), AS_TYPED_ARRAY(argv[1]));
+    return argv[0];
+}
+
+
+Value_t Native_Substr(VM_t* vm, int argc, Value_t* argv)
+{
+    (void)argc;
+    Obj_t* str = str_arg(vm, &argv[0]);
+    int start, len;
+    if (NULL == str || !int_arg(vm, argv[1], &start) || !int_arg(vm, argv[2], &len))
+        return NIL_VAL();
+
+    int str_len = ObjStr_View(str).len;
+    if (start < 0) start = 0;
+    if (start > str_len) start = str_len;
+    if (len < 0) len = 0;
+    if (len > str_len - start) len = str_len - start;
+    return OBJ_VAL(ObjSlice_Create(vm, str, start, len));
+}
+
+
+Value_t Native_CharAt(VM_t* vm, int argc, Value_t* argv)
+{
+    (void)argc;
+    Obj_t* str = str_arg(vm, &argv[0]);
+    int index;
+    if (NULL == str || !int_arg(vm, argv[1], &index)
+    || index < 0 || index >= ObjStr_View(str).len)
+        return NIL_VAL();
+
+    return OBJ_VAL(ObjSlice_Create(vm, str, index, 1));
+}
+
+
+Value_t Native_IndexOf(VM_t* vm, int argc, Value_t* argv)
+{
+    (void)argc;
+    Obj_t* str = str_arg(vm, &argv[0]);
+    Obj_t* substr = str_arg(vm, &argv[1]);
+    if (NULL == str || NULL == substr)
+        return NIL_VAL();
+
+    return Value_FromInt(find_chars(ObjStr_View(str), ObjStr_View(substr), 0));
+}
+
+
+Value_t Native_Split(VM_t* vm, int argc, Value_t* argv)
+{
+    (void)argc;
+    Obj_t* str = str_arg(vm, &argv[0]);
+    Obj_t* separator = str_arg(vm, &argv[1]);
+    if (NULL == str || NULL == separator)
+        return NIL_VAL();
+
+    ObjArray_t* pieces = ObjArr_Create(vm);
+    if (!VM_Push(vm, OBJ_VAL(pieces)))
+        return NIL_VAL();
+
+    /* collections do not move objects, the views stay valid while str and separator are on the stack */
+    StrView_t view = ObjStr_View(str);
+    StrView_t sep = ObjStr_View(separator);
+    if (0 == sep.len) /* every character on its own */
+    {
+        for (int i = 0; i < view.len; i++)
+            ObjArr_Push(vm, pieces, OBJ_VAL(ObjSlice_Create(vm, str, i, 1)));
+    }
+    else 
+    {
+        int start = 0;
+        while (true)
+        {
+            int end = find_chars(view, sep, start);
+            if (-1 == end)
+                end = view.len;
+
+            ObjArr_Push(vm, pieces, OBJ_VAL(ObjSlice_Create(vm, str, start, end - start)));
+            if (end == view.len)
+                break;
+            start = end + sep.len;
+        }
+    }
+
+    VM_Pop(vm);
+    return OBJ_VAL(pieces);
+}
+
+
+
+
+
+
+
+
+static void write_val(StrBuilder_t* builder, Value_t val, bool recurse)
+{
+    VM_t* vm = builder->vm;
     switch (VALTYPE(val))
     {
     case VAL_NUMBER:
-        str = str_from_number(vm, AS_NUMBER(val));
+    case VAL_INT:
+        write_number(builder, AS_NUMBER(val));
         break;
 
     case VAL_NIL:
-        str = vm->native.str.nil;
+        write_str(builder, vm->native.str.nil);
         break;
 
     case VAL_BOOL:
         if (AS_BOOL(val))
-            str = vm->native.str.true_;
+            write_str(builder, vm->native.str.true_);
         else 
-            str = vm->native.str.false_;
+            write_str(builder, vm->native.str.false_);
         break;
 
     case VAL_OBJ:
-        str = str_from_obj(vm, val, recurse);
+        write_obj(builder, val, recurse);
         break;
     }
-    return str;
 }
 
 
-static ObjString_t* str_from_array(VM_t* vm, const ValueArr_t* array, bool recurse)
+static void write_array(StrBuilder_t* builder, const ObjArray_t* array, bool recurse)
 {
+    VM_t* vm = builder->vm;
     if (!recurse)
-        return vm->native.str.array;
+    {
+        write_str(builder, vm->native.str.array);
+        return;
+    }
 
-    ObjString_t* str = vm->native.array.open_bracket;
+    write_str(builder, vm->native.array.open_bracket);
     for (size_t i = 0; i < array->size; i++)
     {
-        str = VM_StrConcat(vm, str, str_from_val(vm, array->vals[i], false));
+        write_val(builder, ObjArr_Get(array, i), false);
         if (i != array->size - 1)
-            str = VM_StrConcat(vm, str, vm->native.array.comma);
+            write_str(builder, vm->native.array.comma);
+    }
+    write_str(builder, vm->native.array.close_bracket);
+}
+
+
+static void write_map(StrBuilder_t* builder, const Map_t* map, bool recurse)
+{
+    if (!recurse)
+    {
+        StrBld_Append(builder, "<map>", 5);
+        return;
+    }
+
+    StrBld_Append(builder, "{ ", 2);
+    size_t written = 0;
+    for (size_t i = 0; i < map->capacity; i++)
+    {
+        if (!Map_IsFull(map, i))
+            continue;
+
+        write_val(builder, map->keys[i], false);
+        StrBld_Append(builder, ": ", 2);
+        write_val(builder, map->vals[i], false);
+        if (++written != map->count)
+            StrBld_Append(builder, ", ", 2);
     }
-    return VM_StrConcat(vm, str, vm->native.array.close_bracket);
+    StrBld_Append(builder, " }", 2);
 }
 
 
-static ObjString_t* str_from_number(VM_t* vm, double number)
+static void write_typed(StrBuilder_t* builder, const ObjTypedArr_t* arr, bool recurse)
+{
+    VM_t* vm = builder->vm;
+    if (!recurse)
+    {
+        if (TYPED_I32 == arr->kind)
+            StrBld_Append(builder, "<Int32Array>", 12);
+        else
+            StrBld_Append(builder, "<Float64Array>", 14);
+        return;
+    }
+
+    write_str(builder, vm->native.array.open_bracket);
+    for (int i = 0; i < arr->len; i++)
+    {
+        write_val(builder, TypedArr_Get(arr, i), false);
+        if (i != arr->len - 1)
+            write_str(builder, vm->native.array.comma);
+    }
+    write_str(builder, vm->native.array.close_bracket);
+}
+
+
+static void write_deque(StrBuilder_t* builder, const ObjDeque_t* deque, bool recurse)
+{
+    VM_t* vm = builder->vm;
+    if (!recurse)
+    {
+        StrBld_Append(builder, "<deque>", 7);
+        return;
+    }
+
+    write_str(builder, vm->native.array.open_bracket);
+    for (size_t i = 0; i < deque->count; i++)
+    {
+        write_val(builder, ObjDeque_Get(deque, i), false);
+        if (i != deque->count - 1)
+            write_str(builder, vm->native.array.comma);
+    }
+    write_str(builder, vm->native.array.close_bracket);
+}
+
+
+static void write_set(StrBuilder_t* builder, const Map_t* set, bool recurse)
+{
+    if (!recurse)
+    {
+        StrBld_Append(builder, "<set>", 5);
+        return;
+    }
+
+    StrBld_Append(builder, "{ ", 2);
+    size_t written = 0;
+    for (size_t i = 0; i < set->capacity; i++)
+    {
+        if (!Map_IsFull(set, i))
+            continue;
+
+        write_val(builder, set->keys[i], false);
+        if (++written != set->count)
+            StrBld_Append(builder, ", ", 2);
+    }
+    StrBld_Append(builder, " }", 2);
+}
+
+
+static void write_pvec(StrBuilder_t* builder, const ObjPVec_t* vec, bool recurse)
+{
+    VM_t* vm = builder->vm;
+    if (!recurse)
+    {
+        StrBld_Append(builder, "<pvector>", 9);
+        return;
+    }
+
+    write_str(builder, vm->native.array.open_bracket);
+    for (size_t i = 0; i < vec->count; i++)
+    {
+        write_val(builder, PVec_Get(vec, i), false);
+        if (i != vec->count - 1)
+            write_str(builder, vm->native.array.comma);
+    }
+    write_str(builder, vm->native.array.close_bracket);
+}
+
+
+static void write_pmap(StrBuilder_t* builder, const ObjPMap_t* map, bool recurse)
+{
+    if (!recurse)
+    {
+        StrBld_Append(builder, "<pmap>", 6);
+        return;
+    }
+
+    PairWriter_t writer = { .builder = builder, .written = 0, .count = map->count };
+    StrBld_Append(builder, "{ ", 2);
+    PMap_Each(map, write_pair, &writer);
+    StrBld_Append(builder, " }", 2);
+}
+
+
+static void write_pair(void* ctx, Value_t key, Value_t val)
+{
+    PairWriter_t* writer = ctx;
+    write_val(writer->builder, key, false);
+    StrBld_Append(writer->builder, ": ", 2);
+    write_val(writer->builder, val, false);
+    if (++writer->written != writer->count)
+        StrBld_Append(writer->builder, ", ", 2);
+}
+
+
+static void write_number(StrBuilder_t* builder, double number)
 {
     char tmp[64];
     int len = snprintf(tmp, sizeof tmp, "%g", number);
-    return ObjStr_Copy(vm, tmp, len);
+    StrBld_Append(builder, tmp, len);
 }
 
 
-static ObjString_t* str_from_obj(VM_t* vm, Value_t val, bool recurse)
+static void write_obj(StrBuilder_t* builder, Value_t val, bool recurse)
 {
+    VM_t* vm = builder->vm;
     switch (OBJ_TYPE(val))
     {
     case OBJ_STRING:
-        return AS_STR(val);
+        write_str(builder, AS_STR(val));
+        break;
 
-    case OBJ_UPVAL:
-        return ObjStr_Copy(vm, "upvalue", 7);
+    case OBJ_ROPE:
+        write_str(builder, ObjRope_Flatten(vm, AS_ROPE(val)));
+        break;
 
-    case OBJ_CLASS:
+    case OBJ_SLICE:
     {
-        const ObjClass_t* klass = AS_CLASS(val);
-        return VM_StrConcat(vm, 
-            klass->name, 
-            ObjStr_Copy(vm, " class", 6)
-        );
+        StrView_t view = ObjStr_View(AS_OBJ(val));
+        StrBld_Append(builder, view.chars, view.len);
     }
     break;
 
+    case OBJ_UPVAL:
+        StrBld_Append(builder, "upvalue", 7);
+        break;
+
+    case OBJ_CLASS:
+        write_str(builder, AS_CLASS(val)->name);
+        StrBld_Append(builder, " class", 6);
+        break;
 
     case OBJ_INSTANCE:
     {
         const ObjInstance_t* instance = AS_INSTANCE(val);
-        ObjString_t* str = ObjStr_Copy(vm, 
-            instance->klass->name->cstr, 
-            instance->klass->name->len
-        );
-        VM_Push(vm, OBJ_VAL(str));
-        {
-            ObjString_t* tmp = ObjStr_Copy(vm, " instance:\n  ", 13);
-            str = VM_StrConcat(vm, str, tmp);
-            str = VM_StrConcat(vm, 
-                str, 
-                str_from_table(vm, instance->fields, recurse)
-            );
-        }
-        VM_Pop(vm);
-        return str;
+        write_str(builder, instance->klass->name);
+        StrBld_Append(builder, " instance:\n  ", 13);
+        write_table(builder, instance->fields, recurse);
     }
     break;
 
     case OBJ_BOUND_METHOD:
-        return str_from_fun(vm, AS_BOUND_METHOD(val)->method->fun);
+        write_fun(builder, DEREF(ObjFunction_t, DEREF(ObjClosure_t, AS_BOUND_METHOD(val)->method)->fun));
+        break;
     case OBJ_CLOSURE:
-        return str_from_fun(vm, AS_CLOSURE(val)->fun);
+        write_fun(builder, DEREF(ObjFunction_t, AS_CLOSURE(val)->fun));
+        break;
     case OBJ_FUNCTION:
     {
         const ObjFunction_t* fun = AS_FUNCTION(val);
         if (NULL == fun)
-            return vm->native.str.script;
+            write_str(builder, vm->native.str.script);
         else
-            return str_from_fun(vm, fun);
+            write_fun(builder, fun);
     }
     break;
 
     case OBJ_NATIVE:
-        return vm->native.str.nativefn;
+        write_str(builder, vm->native.str.nativefn);
+        break;
 
     case OBJ_ARRAY:
-        return str_from_array(vm, &AS_ARRAY(val)->array, recurse);
-    }
+        write_array(builder, AS_ARRAY(val), recurse);
+        break;
+
+    case OBJ_MAP:
+        write_map(builder, &AS_MAP(val)->map, recurse);
+        break;
+
+    case OBJ_TYPED_ARRAY:
+        write_typed(builder, AS_TYPED_ARRAY(val), recurse);
+        break;
+
+    case OBJ_DEQUE:
+        write_deque(builder, AS_DEQUE(val), recurse);
+        break;
+
+    case OBJ_PQUEUE:
+        if (recurse)
+        {
+            char tmp[64];
+            int len = snprintf(tmp, sizeof tmp, "<priority queue of %zu>", AS_PQUEUE(val)->count);
+            StrBld_Append(builder, tmp, len);
+        }
+        else 
+        {
+            StrBld_Append(builder, "<priority queue>", 16);
+        }
+        break;
+
+    case OBJ_SET:
+        write_set(builder, &AS_SET(val)->map, recurse);
+        break;
+
+    case OBJ_PVEC:
+        write_pvec(builder, AS_PVEC(val), recurse);
+        break;
+
+    case OBJ_PMAP:
+        write_pmap(builder, AS_PMAP(val), recurse);
+        break;
 
-    return vm->native.str.empty;
+    case OBJ_PNODE:
+        StrBld_Append(builder, "<node>", 6);
+        break;
+    }
 }
 
 
 
 
-static ObjString_t* str_from_fun(VM_t* vm, const ObjFunction_t* fun)
+static void write_fun(StrBuilder_t* builder, const ObjFunction_t* fun)
 {
-    ObjString_t* str = ObjStr_Copy(vm, "<fn ", 4);
-    str = VM_StrConcat(vm, str, fun->name);
-    str = VM_StrConcat(vm, str, ObjStr_Copy(vm, ">", 1));
-    return str;
+    StrBld_Append(builder, "<fn ", 4);
+    write_str(builder, fun->name);
+    StrBld_Append(builder, ">", 1);
 }
 
 
 
-static ObjString_t* str_from_table(VM_t* vm, const Table_t table, bool recurse)
+static void write_table(StrBuilder_t* builder, const Table_t table, bool recurse)
 {
     if (!recurse)
-        return vm->native.str.table;
+    {
+        write_str(builder, builder->vm->native.str.table);
+        return;
+    }
 
-    ObjString_t* str = NULL;
     for (size_t i = 0; i < table.capacity; i++)
     {
-        const Entry_t* entry = &table.entries[i];
-        if (entry->key == NULL) continue;
+        if (table.keys[i] == NULL) continue;
 
-        if (NULL == str)
-            str = ObjStr_Copy(vm, entry->key->cstr, entry->key->len);
-        else 
-            str = VM_StrConcat(vm, str, entry->key);
-        str = VM_StrConcat(vm, str, ObjStr_Copy(vm, ": ", 2));
-        str = VM_StrConcat(vm, str, str_from_val(vm, entry->val, false));
-        str = VM_StrConcat(vm, str, ObjStr_Copy(vm, ",\n  ", 4));
+        write_str(builder, table.keys[i]);
+        StrBld_Append(builder, ": ", 2);
+        write_val(builder, table.vals[i], false);
+        StrBld_Append(builder, ",\n  ", 4);
+    }
+}
+
+
+static void write_str(StrBuilder_t* builder, const ObjString_t* str)
+{
+    StrBld_Append(builder, str->cstr, str->len);
+}
+
+
+
+
+/* \returns the string or slice in arg, a rope is flattened in place, NULL for anything else */
+static Obj_t* str_arg(VM_t* vm, Value_t* arg)
+{
+    if (IS_ROPE(*arg))
+        *arg = OBJ_VAL(ObjRope_Flatten(vm, AS_ROPE(*arg)));
+    if (IS_STRING(*arg) || IS_SLICE(*arg))
+        return AS_OBJ(*arg);
+    return NULL;
+}
+
+
+/* false if arg is not a number, or with a runtime error if it is NaN or does not fit in an int */
+static bool int_arg(VM_t* vm, Value_t arg, int* out)
+{
+    if (!IS_NUMBER(arg))
+        return false;
+
+    double number = AS_NUMBER(arg);
+    if (number != number)
+    {
+        VM_NativeError(vm, "Expected an integer, got NaN instead.");
+        return false;
+    }
+    if (number < INT_MIN || number > INT_MAX)
+    {
+        VM_NativeError(vm, "Expected an integer between %d and %d, got %g instead.", INT_MIN, INT_MAX, number);
+        return false;
     }
-    if (NULL == str)
-        return vm->native.str.empty;
-    return str;
+    *out = (int)number;
+    return true;
+}
+
+
+/* both are typed arrays of the same kind and size */
+static bool same_typed(Value_t a, Value_t b)
+{
+    return IS_TYPED_ARRAY(a) && IS_TYPED_ARRAY(b)
+        && AS_TYPED_ARRAY(a)->kind == AS_TYPED_ARRAY(b)->kind
+        && AS_TYPED_ARRAY(a)->len == AS_TYPED_ARRAY(b)->len;
 }
 
+
+/* the results over an Int32Array are ints, unless they do not fit in one */
+static Value_t typed_result(const ObjTypedArr_t* arr, double result)
+{
+    if (TYPED_I32 == arr->kind && INT32_MIN <= result && result <= INT32_MAX)
+        return INT_VAL((int32_t)result);
+    return NUMBER_VAL(result);
+}
+
+
+/* \returns the index of the first substr in str from the index from on, -1 if there is none */
+static int find_chars(StrView_t str, StrView_t substr, int from)
+{
+    if (0 == substr.len)
+        return from <= str.len ? from : -1;
+
+    const char* end = str.chars + str.len - substr.len + 1;
+    for (const char* at = str.chars + from; at < end; at++)
+    {
+        at = memchr(at, substr.chars[0], end - at);
+        if (NULL == at)
+            return -1;
+        if (0 == memcmp(at, substr.chars, substr.len))
+            return (int)(at - str.chars);
+    }
+    return -1;
+}
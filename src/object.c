@@ -2,11 +2,14 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <float.h>
 
 #include "include/memory.h"
 #include "include/object.h"
 #include "include/value.h"
 #include "include/vm.h"
+#include "include/typedarr.h"
+#include "include/persistent.h"
 #include "include/memory.h"
 
 
@@ -15,17 +18,47 @@
 #define ALLOCATE_OBJ(p_vm, type, objType)\
     (type *)allocate_obj(p_vm, sizeof(type), objType)
 
-#define HASH_BYTE(prev_hash, ch) (((prev_hash) ^ (uint8_t)(ch)) * 16777619)
+#define HASH_MUL 0x9E3779B97F4A7C15ull
+
+
+/* what print_pmap passes to print_pair */
+typedef struct PairPrinter_t
+{
+    FILE* fout;
+    size_t printed;
+    size_t count;
+} PairPrinter_t;
 
 
 static void print_obj(FILE* fout, const Value_t val, bool recurse);
-static void print_array(FILE* fout, const ValueArr_t* array, bool recurse);
+static void print_array(FILE* fout, const ObjArray_t* array, bool recurse);
+static void print_map(FILE* fout, const Map_t* map, bool recurse);
+static void print_typed(FILE* fout, const ObjTypedArr_t* arr, bool recurse);
+static void print_deque(FILE* fout, const ObjDeque_t* deque, bool recurse);
+static void print_set(FILE* fout, const Map_t* set, bool recurse);
+static void print_pvec(FILE* fout, const ObjPVec_t* vec, bool recurse);
+static void print_pmap(FILE* fout, const ObjPMap_t* map, bool recurse);
+static void print_pair(void* ctx, Value_t key, Value_t val);
+static void print_elem(FILE* fout, const Value_t val);
 static void print_function(FILE* fout, const ObjFunction_t* fun);
 
 static ObjString_t* allocate_string(VM_t* vm, char* cstr, int len, uint32_t hash);
+static void set_interned(VM_t* vm, ObjString_t* string, uint32_t hash);
 
 static Obj_t* allocate_obj(VM_t* vm, size_t nbytes, ObjType_t type);
-static uint32_t hash_str(const char* str, int len);
+static size_t array_bytes(ElemKind_t kind, size_t count);
+static void* array_at(const ObjArray_t* arr, size_t i);
+static void set_capacity(VM_t* vm, ObjArray_t* arr, size_t capacity);
+static void share_elems(VM_t* vm, ObjArray_t* arr);
+static void deque_grow(VM_t* vm, ObjDeque_t* deque);
+static inline bool pq_less(const PQEntry_t* a, const PQEntry_t* b, SortLess_t less, void* ctx);
+static void pq_sift_up(ObjPQueue_t* pq, size_t i, SortLess_t less, void* ctx);
+static void pq_sift_down(ObjPQueue_t* pq, size_t i, SortLess_t less, void* ctx);
+static uint32_t hash_str(uint64_t seed, const char* str, int len);
+static uint64_t hash_finish(uint64_t hash);
+
+static const ObjString_t* rope_leaf(const Obj_t* obj);
+static void rope_write(const ObjRope_t* rope, char* dst, const Obj_t** stack);
 
 
 
@@ -42,15 +75,38 @@ void Obj_Free(VM_t* vm, Obj_t* obj)
     {
     case OBJ_ARRAY:
     {
+        /* shared elements belong to the frozen array */
         ObjArray_t* arr = (ObjArray_t*)obj;
-        ValArr_Free(&arr->array);
-        FREE(vm, ObjArray_t, arr);
+        if (!ObjArr_IsShared(arr))
+            GC_Reallocate(vm, arr->as.vals, array_bytes(arr->kind, arr->capacity), 0);
     }
     break;
 
-    case OBJ_BOUND_METHOD:
+    case OBJ_MAP:
+    {
+        ObjMap_t* map = (ObjMap_t*)obj;
+        Map_Free(&map->map);
+    }
+    break;
+
+    case OBJ_DEQUE:
+    {
+        ObjDeque_t* deque = (ObjDeque_t*)obj;
+        FREE_ARRAY(vm, Value_t, deque->vals, deque->capacity);
+    }
+    break;
+
+    case OBJ_PQUEUE:
     {
-        FREE(vm, ObjBoundMethod_t, obj);
+        ObjPQueue_t* pq = (ObjPQueue_t*)obj;
+        FREE_ARRAY(vm, PQEntry_t, pq->entries, pq->capacity);
+    }
+    break;
+
+    case OBJ_SET:
+    {
+        ObjSet_t* set = (ObjSet_t*)obj;
+        Map_Free(&set->map);
     }
     break;
 
@@ -58,7 +114,6 @@ void Obj_Free(VM_t* vm, Obj_t* obj)
     {
         ObjInstance_t* inst = (ObjInstance_t*)obj;
         Table_Free(&inst->fields);
-        FREE(vm, ObjInstance_t, inst);
     }
     break;
 
@@ -66,46 +121,35 @@ void Obj_Free(VM_t* vm, Obj_t* obj)
     {
         ObjClass_t* klass = (ObjClass_t*)obj;
         Table_Free(&klass->methods);
-        FREE(vm, ObjClass_t, klass);
     }
     break;
 
-    case OBJ_NATIVE:
-        FREE(vm, ObjNativeFn_t, obj);
-        break;
-
     case OBJ_FUNCTION:
     {
         ObjFunction_t* fun = (ObjFunction_t*)obj;
         Chunk_Free(&fun->chunk);
-        FREE(vm, ObjFunction_t, fun);
-    }
-    break;
-
-    case OBJ_CLOSURE:
-    {
-        ObjClosure_t* closure = (ObjClosure_t*)obj;
-        FREE_ARRAY(vm, ObjUpval_t*, 
-            closure->upvals, closure->upval_count
-        );
-        FREE(vm, ObjClosure_t, closure);
     }
     break;
 
     case OBJ_STRING:
     {
+#ifndef OBJSTR_FLEXIBLE_ARR
         ObjString_t* str = (ObjString_t*)obj;
-#ifdef OBJSTR_FLEXIBLE_ARR
-        FREE_ARRAY(vm, char, str, sizeof(ObjString_t) + str->len + 1);
-#else
         FREE_ARRAY(vm, char, str->cstr, str->len + 1);
-        FREE(vm, *str, str);
 #endif 
     }
     break;
 
+    case OBJ_BOUND_METHOD:
+    case OBJ_CLOSURE:
+    case OBJ_NATIVE:
     case OBJ_UPVAL:
-        FREE(vm, ObjUpval_t, obj);
+    case OBJ_ROPE:
+    case OBJ_SLICE:
+    case OBJ_TYPED_ARRAY:
+    case OBJ_PNODE:
+    case OBJ_PVEC:
+    case OBJ_PMAP:
         break;
     }
 }
@@ -121,11 +165,595 @@ ObjArray_t* ObjArr_Create(VM_t* vm)
 {
     ObjArray_t* arr = ALLOCATE_OBJ(vm, ObjArray_t, OBJ_ARRAY);
 
-    ValArr_Init(&arr->array, vm);
+    arr->kind = ELEMS_NUMBERS;
+    arr->shared = REF((ObjArray_t*)NULL);
+    arr->size = 0;
+    arr->capacity = 0;
+    arr->start = 0;
+    arr->as.vals = NULL;
     return arr;
 }
 
 
+ObjArray_t* ObjArr_Copy(VM_t* vm, ObjArray_t* arr)
+{
+    return ObjArr_Slice(vm, arr, 0, arr->size);
+}
+
+
+ObjArray_t* ObjArr_Slice(VM_t* vm, ObjArray_t* arr, size_t start, size_t end)
+{
+    const size_t len = end - start;
+    ObjArray_t* slice = ObjArr_Create(vm);
+    VM_Push(vm, OBJ_VAL(slice));
+    slice->kind = arr->kind;
+
+    if (len < ARRAY_SHARE_MIN_LEN)
+    {
+        ObjArr_Reserve(vm, slice, len);
+        if (0 != len) /* an empty array has no buffer to copy into */
+            memcpy(slice->as.vals, array_at(arr, start), array_bytes(arr->kind, len));
+        slice->size = len;
+    }
+    else
+    {
+        if (!ObjArr_IsShared(arr))
+            share_elems(vm, arr);
+
+        slice->shared = arr->shared;
+        slice->start = arr->start + start;
+        slice->as.vals = array_at(arr, start);
+        slice->size = len;
+        slice->capacity = len;
+    }
+
+    VM_Pop(vm);
+    return slice;
+}
+
+
+void ObjArr_Own(VM_t* vm, ObjArray_t* arr)
+{
+    void* elems = NULL;
+    if (0 != arr->size)
+    {
+        elems = GC_Reallocate(vm, NULL, 0, array_bytes(arr->kind, arr->size));
+        memcpy(elems, arr->as.vals, array_bytes(arr->kind, arr->size));
+    }
+
+    arr->shared = REF((ObjArray_t*)NULL);
+    arr->start = 0;
+    arr->capacity = arr->size;
+    arr->as.vals = elems;
+}
+
+
+void ObjArr_Reserve(VM_t* vm, ObjArray_t* arr, size_t extra)
+{
+    if (ObjArr_IsShared(arr))
+        ObjArr_Own(vm, arr);
+    if (arr->size + extra <= arr->capacity)
+        return;
+
+    size_t capacity = GROW_CAPACITY(arr->capacity);
+    if (capacity < arr->size + extra)
+        capacity = arr->size + extra;
+    set_capacity(vm, arr, capacity);
+}
+
+
+void ObjArr_ShrinkToFit(VM_t* vm, ObjArray_t* arr)
+{
+    /* a shared array has no room of its own */
+    if (!ObjArr_IsShared(arr) && arr->size < arr->capacity)
+        set_capacity(vm, arr, arr->size);
+}
+
+
+void ObjArr_Push(VM_t* vm, ObjArray_t* arr, Value_t val)
+{
+    const bool to_values = ELEMS_NUMBERS == arr->kind && !IS_NUMBER(val);
+    if (to_values || ObjArr_IsShared(arr) || arr->size + 1 > arr->capacity)
+    {
+        /* these allocate */
+        VM_Push(vm, val);
+
+        if (ObjArr_IsShared(arr))
+            ObjArr_Own(vm, arr);
+        if (to_values)
+            ObjArr_ToValues(vm, arr);
+        if (arr->size + 1 > arr->capacity)
+            set_capacity(vm, arr, GROW_CAPACITY(arr->capacity));
+
+        VM_Pop(vm);
+    }
+
+    ObjArr_Set(vm, arr, arr->size, val);
+    arr->size++;
+}
+
+
+Value_t ObjArr_Pop(VM_t* vm, ObjArray_t* arr)
+{
+    arr->size--;
+    Value_t last = ObjArr_Get(arr, arr->size);
+
+    /* 
+     *  halving at a quarter leaves room for as many pushes as it took pops to get there, 
+     *  shrinking does not collect so last needs no rooting
+     */
+    if (!ObjArr_IsShared(arr) && arr->capacity / 2 >= ARRAY_MIN_SHRINK && arr->size < arr->capacity / 4)
+        set_capacity(vm, arr, arr->capacity / 2);
+    return last;
+}
+
+
+void ObjArr_Append(VM_t* vm, ObjArray_t* arr, const Value_t* vals, size_t count)
+{
+    if (ELEMS_NUMBERS == arr->kind)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!IS_NUMBER(vals[i]))
+            {
+                ObjArr_ToValues(vm, arr);
+                break;
+            }
+        }
+    }
+
+    ObjArr_Reserve(vm, arr, count);
+    for (size_t i = 0; i < count; i++)
+        ObjArr_Set(vm, arr, arr->size + i, vals[i]);
+    arr->size += count;
+}
+
+
+void ObjArr_ToValues(VM_t* vm, ObjArray_t* arr)
+{
+    if (ObjArr_IsShared(arr))
+        ObjArr_Own(vm, arr);
+#ifndef NAN_BOXING
+    if (0 != arr->capacity)
+    {
+        Value_t* vals = ALLOCATE(vm, Value_t, arr->capacity);
+        for (size_t i = 0; i < arr->size; i++)
+            vals[i] = NUMBER_VAL(arr->as.nums[i]);
+        FREE_ARRAY(vm, double, arr->as.nums, arr->capacity);
+        arr->as.vals = vals;
+    }
+#endif /* NAN_BOXING */
+    arr->kind = ELEMS_VALUES;
+}
+
+
+ObjArray_t* ObjArr_Concat(VM_t* vm, ObjArray_t* a, ObjArray_t* b)
+{
+    ObjArray_t* cat = ObjArr_Create(vm);
+    VM_Push(vm, OBJ_VAL(cat));
+
+    if (ELEMS_VALUES == a->kind || ELEMS_VALUES == b->kind)
+        cat->kind = ELEMS_VALUES;
+    ObjArr_Reserve(vm, cat, a->size + b->size);
+
+    const ObjArray_t* srcs[] = { a, b };
+    for (size_t i = 0; i < STATIC_ARRSZ(srcs); i++)
+    {
+        const ObjArray_t* src = srcs[i];
+        if (0 == src->size)
+            continue;
+
+        if (src->kind == cat->kind)
+            memcpy(array_at(cat, cat->size), src->as.vals, array_bytes(src->kind, src->size));
+        else for (size_t k = 0; k < src->size; k++)
+            cat->as.vals[cat->size + k] = NUMBER_VAL(src->as.nums[k]);
+        cat->size += src->size;
+    }
+
+    VM_Pop(vm);
+    return cat;
+}
+
+
+void ObjArr_Insert(VM_t* vm, ObjArray_t* arr, size_t i, Value_t val)
+{
+    /* grows the array the way pushing does, then moves the elements from i on over the new one */
+    ObjArr_Push(vm, arr, val);
+    memmove(array_at(arr, i + 1), array_at(arr, i), array_bytes(arr->kind, arr->size - 1 - i));
+    ObjArr_Set(vm, arr, i, val);
+}
+
+
+void ObjArr_Fill(VM_t* vm, ObjArray_t* arr, Value_t val)
+{
+    if (0 == arr->size)
+        return;
+
+    if (ELEMS_NUMBERS == arr->kind && !IS_NUMBER(val))
+        ObjArr_ToValues(vm, arr);
+    else if (ObjArr_IsShared(arr))
+        ObjArr_Own(vm, arr);
+
+    if (ELEMS_NUMBERS == arr->kind)
+    {
+        const double number = AS_NUMBER(val);
+        for (size_t i = 0; i < arr->size; i++)
+            arr->as.nums[i] = number;
+    }
+    else for (size_t i = 0; i < arr->size; i++)
+    {
+        arr->as.vals[i] = val;
+    }
+}
+
+
+void ObjArr_Reverse(VM_t* vm, ObjArray_t* arr)
+{
+    if (arr->size < 2)
+        return;
+    if (ObjArr_IsShared(arr))
+        ObjArr_Own(vm, arr);
+
+    for (size_t i = 0, j = arr->size - 1; i < j; i++, j--)
+    {
+        if (ELEMS_NUMBERS == arr->kind)
+        {
+            double tmp = arr->as.nums[i];
+            arr->as.nums[i] = arr->as.nums[j];
+            arr->as.nums[j] = tmp;
+        }
+        else
+        {
+            Value_t tmp = arr->as.vals[i];
+            arr->as.vals[i] = arr->as.vals[j];
+            arr->as.vals[j] = tmp;
+        }
+    }
+}
+
+
+int64_t ObjArr_IndexOf(const ObjArray_t* arr, Value_t val)
+{
+    if (ELEMS_NUMBERS == arr->kind)
+    {
+        if (!IS_NUMBER(val))
+            return -1;
+
+        /* the same range as == for numbers, NaN is within none */
+        const double number = AS_NUMBER(val);
+        const double lo = number - FLT_EPSILON, hi = number + FLT_EPSILON;
+        for (size_t i = 0; i < arr->size; i++)
+        {
+            if (lo <= arr->as.nums[i] && arr->as.nums[i] <= hi)
+                return (int64_t)i;
+        }
+        return -1;
+    }
+
+#ifdef NAN_BOXING
+    /* anything but a number or a string is only equal to the same bits */
+    if (!IS_NUMBER(val) && !(IS_OBJ(val) && (IS_STRING(val) || IS_SLICE(val))))
+    {
+        for (size_t i = 0; i < arr->size; i++)
+        {
+            if (arr->as.vals[i] == val)
+                return (int64_t)i;
+        }
+        return -1;
+    }
+#endif /* NAN_BOXING */
+
+    for (size_t i = 0; i < arr->size; i++)
+    {
+        if (Value_Equal(arr->as.vals[i], val))
+            return (int64_t)i;
+    }
+    return -1;
+}
+
+
+void ObjArr_SwapElems(ObjArray_t* a, ObjArray_t* b)
+{
+    ObjArray_t tmp = *a;
+
+    a->kind = b->kind;
+    a->shared = b->shared;
+    a->size = b->size;
+    a->capacity = b->capacity;
+    a->start = b->start;
+    a->as = b->as;
+
+    b->kind = tmp.kind;
+    b->shared = tmp.shared;
+    b->size = tmp.size;
+    b->capacity = tmp.capacity;
+    b->start = tmp.start;
+    b->as = tmp.as;
+}
+
+
+bool ObjArr_SameElems(const ObjArray_t* a, const ObjArray_t* b)
+{
+    if (a->kind != b->kind || a->size != b->size)
+        return false;
+    return a->as.vals == b->as.vals || 0 == a->size 
+        || 0 == memcmp(a->as.vals, b->as.vals, array_bytes(a->kind, a->size));
+}
+
+
+ObjMap_t* ObjMap_Create(VM_t* vm)
+{
+    ObjMap_t* map = ALLOCATE_OBJ(vm, ObjMap_t, OBJ_MAP);
+
+    Map_Init(&map->map, vm);
+    return map;
+}
+
+
+ObjDeque_t* ObjDeque_Create(VM_t* vm)
+{
+    ObjDeque_t* deque = ALLOCATE_OBJ(vm, ObjDeque_t, OBJ_DEQUE);
+
+    deque->head = 0;
+    deque->count = 0;
+    deque->capacity = 0;
+    deque->vals = NULL;
+    return deque;
+}
+
+
+void ObjDeque_PushFront(VM_t* vm, ObjDeque_t* deque, Value_t val)
+{
+    if (deque->count == deque->capacity)
+        deque_grow(vm, deque);
+
+    deque->head = (deque->head - 1) & (deque->capacity - 1);
+    deque->vals[deque->head] = val;
+    deque->count++;
+}
+
+
+void ObjDeque_PushBack(VM_t* vm, ObjDeque_t* deque, Value_t val)
+{
+    if (deque->count == deque->capacity)
+        deque_grow(vm, deque);
+
+    deque->vals[(deque->head + deque->count) & (deque->capacity - 1)] = val;
+    deque->count++;
+}
+
+
+Value_t ObjDeque_PopFront(ObjDeque_t* deque)
+{
+    if (0 == deque->count)
+        return NIL_VAL();
+
+    Value_t val = deque->vals[deque->head];
+    deque->head = (deque->head + 1) & (deque->capacity - 1);
+    deque->count--;
+    return val;
+}
+
+
+Value_t ObjDeque_PopBack(ObjDeque_t* deque)
+{
+    if (0 == deque->count)
+        return NIL_VAL();
+
+    deque->count--;
+    return ObjDeque_Get(deque, deque->count);
+}
+
+
+ObjPQueue_t* ObjPQueue_Create(VM_t* vm, Value_t cmp)
+{
+    ObjPQueue_t* pq = ALLOCATE_OBJ(vm, ObjPQueue_t, OBJ_PQUEUE);
+
+    pq->busy = false;
+    pq->count = 0;
+    pq->capacity = 0;
+    pq->cmp = cmp;
+    pq->entries = NULL;
+    return pq;
+}
+
+
+void ObjPQueue_Push(VM_t* vm, ObjPQueue_t* pq, Value_t val, double key, SortLess_t less, void* ctx)
+{
+    if (pq->count == pq->capacity)
+    {
+        size_t capacity = GROW_CAPACITY(pq->capacity);
+        pq->entries = GROW_ARRAY(vm, PQEntry_t, pq->entries, pq->capacity, capacity);
+        pq->capacity = capacity;
+    }
+
+    pq->entries[pq->count] = (PQEntry_t){ .key = key, .val = val };
+    pq->count++;
+    pq_sift_up(pq, pq->count - 1, less, ctx);
+}
+
+
+void ObjPQueue_Pop(ObjPQueue_t* pq, SortLess_t less, void* ctx)
+{
+    pq->count--;
+    if (0 != pq->count)
+    {
+        pq->entries[0] = pq->entries[pq->count];
+        pq_sift_down(pq, 0, less, ctx);
+    }
+}
+
+
+ObjSet_t* ObjSet_Create(VM_t* vm)
+{
+    ObjSet_t* set = ALLOCATE_OBJ(vm, ObjSet_t, OBJ_SET);
+
+    Map_Init(&set->map, vm);
+    return set;
+}
+
+
+ObjPNode_t* ObjPNode_Create(VM_t* vm, const ObjPNode_t* node, uint32_t len)
+{
+    ObjPNode_t* copy = (ObjPNode_t*)allocate_obj(
+        vm, sizeof(*copy) + len * sizeof(Value_t), OBJ_PNODE
+    );
+
+    copy->collision = false;
+    copy->len = len;
+    copy->datamap = 0;
+    copy->nodemap = 0;
+    uint32_t copied = 0;
+    if (NULL != node)
+    {
+        copy->collision = node->collision;
+        copy->datamap = node->datamap;
+        copy->nodemap = node->nodemap;
+        copied = node->len < len ? node->len : len;
+        memcpy(copy->slots, node->slots, copied * sizeof(Value_t));
+    }
+    for (uint32_t i = copied; i < len; i++)
+    {
+        copy->slots[i] = NIL_VAL();
+    }
+    return copy;
+}
+
+
+ObjPVec_t* ObjPVec_Create(VM_t* vm, size_t count, uint32_t shift, ObjPNode_t* root, ObjPNode_t* tail)
+{
+    ObjPVec_t* vec = ALLOCATE_OBJ(vm, ObjPVec_t, OBJ_PVEC);
+
+    vec->count = count;
+    vec->shift = shift;
+    vec->root = REF(root);
+    vec->tail = REF(tail);
+    return vec;
+}
+
+
+ObjPMap_t* ObjPMap_Create(VM_t* vm, size_t count, ObjPNode_t* root)
+{
+    ObjPMap_t* map = ALLOCATE_OBJ(vm, ObjPMap_t, OBJ_PMAP);
+
+    map->count = count;
+    map->root = REF(root);
+    return map;
+}
+
+
+ObjTypedArr_t* ObjTyped_Create(VM_t* vm, TypedKind_t kind, int len)
+{
+    size_t nbytes = (size_t)len * (TYPED_I32 == kind ? sizeof(int32_t) : sizeof(double));
+    ObjTypedArr_t* arr = (ObjTypedArr_t*)allocate_obj(
+        vm, sizeof(*arr) + nbytes, OBJ_TYPED_ARRAY
+    );
+
+    arr->kind = kind;
+    arr->len = len;
+    memset(arr->f64, 0, nbytes);
+    return arr;
+}
+
+
+
+ObjRope_t* ObjRope_Create(VM_t* vm, Obj_t* a, Obj_t* b)
+{
+    ObjRope_t* rope = ALLOCATE_OBJ(vm, ObjRope_t, OBJ_ROPE);
+
+    /* a flattened rope is replaced by its string */
+    const ObjString_t* str_a = rope_leaf(a);
+    const ObjString_t* str_b = rope_leaf(b);
+    if (NULL != str_a) a = (Obj_t*)str_a;
+    if (NULL != str_b) b = (Obj_t*)str_b;
+
+    int depth_a = NULL == str_a ? ((ObjRope_t*)a)->depth : 0;
+    int depth_b = NULL == str_b ? ((ObjRope_t*)b)->depth : 0;
+    rope->len = (NULL == str_a ? ((ObjRope_t*)a)->len : str_a->len)
+        + (NULL == str_b ? ((ObjRope_t*)b)->len : str_b->len);
+    rope->depth = 1 + (depth_a > depth_b ? depth_a : depth_b);
+    rope->left = REF(a);
+    rope->right = REF(b);
+    return rope;
+}
+
+
+ObjString_t* ObjRope_Flatten(VM_t* vm, ObjRope_t* rope)
+{
+    const ObjString_t* leaf = rope_leaf((Obj_t*)rope);
+    if (NULL != leaf)
+        return (ObjString_t*)leaf;
+
+    const Obj_t** stack = ALLOCATE(vm, const Obj_t*, rope->depth);
+    ObjString_t* string = ObjStr_Reserve(vm, rope->len);
+    rope_write(rope, string->cstr, stack);
+    string->cstr[rope->len] = '\0';
+    FREE_ARRAY(vm, const Obj_t*, stack, rope->depth);
+
+    rope->left = REF((Obj_t*)string);
+    rope->right = REF((Obj_t*)NULL);
+    return string;
+}
+
+
+Obj_t* ObjSlice_Create(VM_t* vm, Obj_t* str, int start, int len)
+{
+    CLOX_ASSERT(0 <= start && start + len <= ObjStr_View(str).len);
+    if (0 == len)
+        return (Obj_t*)vm->native.str.empty;
+    if (len < SLICE_MIN_LEN)
+    {
+        ObjString_t* string = ObjStr_Reserve(vm, len);
+        StrView_t view = ObjStr_View(str);
+        memcpy(string->cstr, view.chars + start, len);
+        string->cstr[len] = '\0';
+        return (Obj_t*)string;
+    }
+
+    ObjString_t* parent = (ObjString_t*)str;
+    if (OBJ_SLICE == str->type)
+    {
+        const ObjSlice_t* outer = (const ObjSlice_t*)str;
+        parent = DEREF(ObjString_t, outer->parent);
+        start += outer->start;
+    }
+
+    ObjSlice_t* slice = ALLOCATE_OBJ(vm, ObjSlice_t, OBJ_SLICE);
+    slice->len = len;
+    slice->start = start;
+    slice->parent = REF(parent);
+    return (Obj_t*)slice;
+}
+
+
+ObjString_t* ObjSlice_Flatten(VM_t* vm, const ObjSlice_t* slice)
+{
+    ObjString_t* string = ObjStr_Reserve(vm, slice->len);
+    memcpy(string->cstr, DEREF(ObjString_t, slice->parent)->cstr + slice->start, slice->len);
+    string->cstr[slice->len] = '\0';
+    return string;
+}
+
+
+StrView_t ObjStr_View(const Obj_t* obj)
+{
+    StrView_t view;
+    if (OBJ_SLICE == obj->type)
+    {
+        const ObjSlice_t* slice = (const ObjSlice_t*)obj;
+        view.chars = DEREF(ObjString_t, slice->parent)->cstr + slice->start;
+        view.len = slice->len;
+    }
+    else 
+    {
+        CLOX_ASSERT(OBJ_STRING == obj->type);
+        view.chars = ((const ObjString_t*)obj)->cstr;
+        view.len = ((const ObjString_t*)obj)->len;
+    }
+    return view;
+}
+
+
 
 ObjNativeFn_t* ObjNFn_Create(VM_t* vm, NativeFn_t fn, uint8_t arity)
 {
@@ -145,7 +773,7 @@ ObjUpval_t* ObjUpv_Create(VM_t* vm, Value_t* value)
 
     upval->closed = NIL_VAL();
     upval->location = value;
-    upval->next = NULL;
+    upval->next = REF(NULL);
     return upval;
 }
 
@@ -166,19 +794,18 @@ ObjFunction_t* ObjFun_Create(VM_t* vm)
 
 ObjClosure_t* ObjClo_Create(VM_t* vm, ObjFunction_t* fun)
 {
-    ObjUpval_t** upvals = ALLOCATE(vm, ObjUpval_t*, fun->upval_count);
-    VM_Push(vm, OBJ_VAL(upvals));
-    for (int i = 0; i < fun->upval_count; i++)
-    {
-        upvals[i] = NULL; // again fuck the gc
-    }
-
-    ObjClosure_t* closure = ALLOCATE_OBJ(vm, ObjClosure_t, OBJ_CLOSURE);
+    VM_Push(vm, OBJ_VAL(fun));
+    ObjClosure_t* closure = (ObjClosure_t*)allocate_obj(vm, 
+        sizeof(ObjClosure_t) + sizeof(OBJREF(ObjUpval_t)) * fun->upval_count, OBJ_CLOSURE
+    );
     VM_Pop(vm);
 
-    closure->upvals = upvals;
     closure->upval_count = fun->upval_count;
-    closure->fun = fun;
+    closure->fun = REF(fun);
+    for (int i = 0; i < fun->upval_count; i++)
+    {
+        closure->upvals[i] = REF(NULL); // again fuck the gc
+    }
     return closure;
 }
 
@@ -208,7 +835,7 @@ ObjBoundMethod_t* ObjBmd_Create(VM_t* vm, Value_t receiver, ObjClosure_t* closur
     ObjBoundMethod_t* bmd = ALLOCATE_OBJ(vm, ObjBoundMethod_t, OBJ_BOUND_METHOD);
 
     bmd->receiver = receiver;
-    bmd->method = closure;
+    bmd->method = REF(closure);
     return bmd;
 }
 
@@ -221,7 +848,7 @@ ObjBoundMethod_t* ObjBmd_Create(VM_t* vm, Value_t receiver, ObjClosure_t* closur
 
 ObjString_t* ObjStr_Copy(VM_t* vm, const char* cstr, int len)
 {
-    uint32_t hash = hash_str(cstr, len);
+    uint32_t hash = hash_str(vm->hash_seed, cstr, len);
     ObjString_t* string = Table_FindStr(&vm->strings, cstr, len, hash);
     if (NULL != string)
     {
@@ -237,7 +864,7 @@ ObjString_t* ObjStr_Copy(VM_t* vm, const char* cstr, int len)
     memcpy(buf, cstr, len);
     buf[len] = '\0';
   
-    ObjStr_Intern(vm, string);
+    set_interned(vm, string, hash);
 #else
     buf = ALLOCATE(vm, char, len + 1);
     string = allocate_string(vm, buf, len, hash);
@@ -250,17 +877,28 @@ ObjString_t* ObjStr_Copy(VM_t* vm, const char* cstr, int len)
 }
 
 
-uint32_t ObjStr_HashStrs(int count, const ObjString_t* strings[])
+bool ObjStr_Equal(const ObjString_t* a, const ObjString_t* b)
+{
+    if (a == b)
+        return true;
+    if (a->is_interned && b->is_interned)
+        return false;
+    return a->len == b->len && 0 == memcmp(a->cstr, b->cstr, a->len);
+}
+
+
+uint32_t ObjStr_Hash(VM_t* vm, Obj_t* str)
 {
-    uint32_t hash = 2166136261u;
-    for (int i = 0; i < count; i++)
+    if (OBJ_STRING == str->type)
     {
-        for (int j = 0; j < strings[i]->len; j++)
-        {
-            hash = HASH_BYTE(hash, strings[i]->cstr[j]);
-        }
+        ObjString_t* string = (ObjString_t*)str;
+        if (0 == string->hash)
+            string->hash = hash_str(vm->hash_seed, string->cstr, string->len);
+        return string->hash;
     }
-    return hash;
+
+    StrView_t view = ObjStr_View(str);
+    return hash_str(vm->hash_seed, view.chars, view.len);
 }
 
 
@@ -280,26 +918,37 @@ ObjString_t* ObjStr_Reserve(VM_t* vm, int len)
         vm, sizeof(*string) + len + 1, OBJ_STRING
     );
 #else
+    /* the buffer first, the string would not be reachable while it is allocated */
+    char* cstr = ALLOCATE(vm, char, len + 1);
     string = ALLOCATE_OBJ(vm, ObjString_t, OBJ_STRING);
-    string->cstr = ALLOCATE(vm, char, len + 1);
+    string->cstr = cstr;
 #endif /* OBJSTR_FLEXIBLE_ARR */
 
+    string->is_interned = false;
     string->len = len;
+    string->hash = 0;
     return string;
 }
 
-bool ObjStr_Intern(VM_t* vm, ObjString_t* string)
+ObjString_t* ObjStr_Intern(VM_t* vm, ObjString_t* string)
 {
-    string->hash = hash_str(string->cstr, string->len);
-    bool already_there = Table_Set(&vm->strings, string, NIL_VAL());
-    return already_there;
+    if (string->is_interned)
+        return string;
+
+    uint32_t hash = hash_str(vm->hash_seed, string->cstr, string->len);
+    ObjString_t* interned = Table_FindStr(&vm->strings, string->cstr, string->len, hash);
+    if (NULL != interned)
+        return interned;
+
+    set_interned(vm, string, hash);
+    return string;
 }
 
 
 
 ObjString_t* ObjStr_Steal(VM_t* vm, char* heapstr, int len)
 {
-    uint32_t hash = hash_str(heapstr, len);
+    uint32_t hash = hash_str(vm->hash_seed, heapstr, len);
     ObjString_t* interned = Table_FindStr(&vm->strings, heapstr, len, hash);
     if (NULL != interned)
     {
@@ -307,8 +956,49 @@ ObjString_t* ObjStr_Steal(VM_t* vm, char* heapstr, int len)
         return interned;
     }
 
-    ObjString_t* string = allocate_string(vm, heapstr, len, hash);
-    Table_Set(&vm->strings, string, NIL_VAL());
+    return allocate_string(vm, heapstr, len, hash);
+}
+
+
+
+
+
+void StrBld_Init(StrBuilder_t* builder, VM_t* vm)
+{
+    builder->vm = vm;
+    builder->buf = NULL;
+    builder->len = 0;
+    builder->capacity = 0;
+}
+
+
+void StrBld_Append(StrBuilder_t* builder, const char* cstr, int len)
+{
+    if (builder->len + len > builder->capacity)
+    {
+        int old_capacity = builder->capacity;
+        int capacity = GROW_CAPACITY(old_capacity);
+        while (capacity < builder->len + len)
+            capacity *= 2;
+
+        builder->buf = GROW_ARRAY(builder->vm, char, builder->buf, old_capacity, capacity);
+        builder->capacity = capacity;
+    }
+    memcpy(builder->buf + builder->len, cstr, len);
+    builder->len += len;
+}
+
+
+ObjString_t* StrBld_Finish(StrBuilder_t* builder)
+{
+    if (0 == builder->len)
+        return builder->vm->native.str.empty;
+
+    ObjString_t* string = ObjStr_Reserve(builder->vm, builder->len);
+    memcpy(string->cstr, builder->buf, builder->len);
+    string->cstr[builder->len] = '\0';
+    FREE_ARRAY(builder->vm, char, builder->buf, builder->capacity);
+    StrBld_Init(builder, builder->vm);
     return string;
 }
 
@@ -329,11 +1019,46 @@ static void print_obj(FILE* fout, const Value_t val, bool recurse)
     switch (OBJ_TYPE(val))
     {
     case OBJ_ARRAY:
-        print_array(fout, &AS_ARRAY(val)->array, recurse);
+        print_array(fout, AS_ARRAY(val), recurse);
+        break;
+
+    case OBJ_MAP:
+        print_map(fout, &AS_MAP(val)->map, recurse);
+        break;
+
+    case OBJ_TYPED_ARRAY:
+        print_typed(fout, AS_TYPED_ARRAY(val), recurse);
+        break;
+
+    case OBJ_DEQUE:
+        print_deque(fout, AS_DEQUE(val), recurse);
+        break;
+
+    case OBJ_PQUEUE:
+        if (recurse)
+            fprintf(fout, "<priority queue of %zu>", AS_PQUEUE(val)->count);
+        else
+            fprintf(fout, "<priority queue>");
+        break;
+
+    case OBJ_SET:
+        print_set(fout, &AS_SET(val)->map, recurse);
+        break;
+
+    case OBJ_PVEC:
+        print_pvec(fout, AS_PVEC(val), recurse);
+        break;
+
+    case OBJ_PMAP:
+        print_pmap(fout, AS_PMAP(val), recurse);
+        break;
+
+    case OBJ_PNODE:
+        fprintf(fout, "<node>");
         break;
 
     case OBJ_BOUND_METHOD:
-        print_function(fout, AS_BOUND_METHOD(val)->method->fun);
+        print_function(fout, DEREF(ObjFunction_t, DEREF(ObjClosure_t, AS_BOUND_METHOD(val)->method)->fun));
         break;
         
     case OBJ_INSTANCE:
@@ -353,13 +1078,42 @@ static void print_obj(FILE* fout, const Value_t val, bool recurse)
         break;
     
     case OBJ_CLOSURE:
-        print_function(fout, AS_CLOSURE(val)->fun);
+        print_function(fout, DEREF(ObjFunction_t, AS_CLOSURE(val)->fun));
         break;
 
     case OBJ_STRING:
         fprintf(fout, "%s", AS_CSTR(val));
         break;
 
+    case OBJ_ROPE:
+    {
+        /* printing does not need the vm, so the rope is written to a buffer of its own */
+        const ObjRope_t* rope = AS_ROPE(val);
+        const ObjString_t* leaf = rope_leaf((Obj_t*)rope);
+        if (NULL != leaf)
+        {
+            fprintf(fout, "%s", leaf->cstr);
+            break;
+        }
+        char* buf = malloc(rope->len);
+        const Obj_t** stack = malloc(rope->depth * sizeof *stack);
+        if (NULL != buf && NULL != stack)
+        {
+            rope_write(rope, buf, stack);
+            fwrite(buf, 1, rope->len, fout);
+        }
+        free(stack);
+        free(buf);
+    }
+    break;
+
+    case OBJ_SLICE:
+    {
+        StrView_t view = ObjStr_View(AS_OBJ(val));
+        fwrite(view.chars, 1, view.len, fout);
+    }
+    break;
+
     case OBJ_UPVAL:
         fprintf(fout, "upvalue");
         break;
@@ -377,7 +1131,7 @@ static void print_obj(FILE* fout, const Value_t val, bool recurse)
 
 
 
-static void print_array(FILE* fout, const ValueArr_t* array, bool recurse)
+static void print_array(FILE* fout, const ObjArray_t* array, bool recurse)
 {
     if (!recurse)
     {
@@ -388,10 +1142,7 @@ static void print_array(FILE* fout, const ValueArr_t* array, bool recurse)
     fprintf(fout, "[ ");
     for (size_t i = 0; i < array->size; i++)
     {
-        if (VAL_OBJ != VALTYPE(array->vals[i]))
-            Value_Print(fout, array->vals[i]);
-        else
-            print_obj(fout, array->vals[i], false);
+        print_elem(fout, ObjArr_Get(array, i));
 
         if (i != array->size - 1)
             fprintf(fout, ", ");
@@ -400,6 +1151,153 @@ static void print_array(FILE* fout, const ValueArr_t* array, bool recurse)
 }
 
 
+static void print_map(FILE* fout, const Map_t* map, bool recurse)
+{
+    if (!recurse)
+    {
+        fprintf(fout, "<map>");
+        return;
+    }
+
+    fprintf(fout, "{ ");
+    size_t printed = 0;
+    for (size_t i = 0; i < map->capacity; i++)
+    {
+        if (!Map_IsFull(map, i))
+            continue;
+
+        print_elem(fout, map->keys[i]);
+        fprintf(fout, ": ");
+        print_elem(fout, map->vals[i]);
+
+        if (++printed != map->count)
+            fprintf(fout, ", ");
+    }
+    fprintf(fout, " }");
+}
+
+
+static void print_typed(FILE* fout, const ObjTypedArr_t* arr, bool recurse)
+{
+    if (!recurse)
+    {
+        fprintf(fout, TYPED_I32 == arr->kind ? "<Int32Array>" : "<Float64Array>");
+        return;
+    }
+
+    fprintf(fout, "[ ");
+    for (int i = 0; i < arr->len; i++)
+    {
+        Value_Print(fout, TypedArr_Get(arr, i));
+
+        if (i != arr->len - 1)
+            fprintf(fout, ", ");
+    }
+    fprintf(fout, " ]");
+}
+
+
+static void print_deque(FILE* fout, const ObjDeque_t* deque, bool recurse)
+{
+    if (!recurse)
+    {
+        fprintf(fout, "<deque>");
+        return;
+    }
+
+    fprintf(fout, "[ ");
+    for (size_t i = 0; i < deque->count; i++)
+    {
+        print_elem(fout, ObjDeque_Get(deque, i));
+
+        if (i != deque->count - 1)
+            fprintf(fout, ", ");
+    }
+    fprintf(fout, " ]");
+}
+
+
+static void print_set(FILE* fout, const Map_t* set, bool recurse)
+{
+    if (!recurse)
+    {
+        fprintf(fout, "<set>");
+        return;
+    }
+
+    fprintf(fout, "{ ");
+    size_t printed = 0;
+    for (size_t i = 0; i < set->capacity; i++)
+    {
+        if (!Map_IsFull(set, i))
+            continue;
+
+        print_elem(fout, set->keys[i]);
+
+        if (++printed != set->count)
+            fprintf(fout, ", ");
+    }
+    fprintf(fout, " }");
+}
+
+
+static void print_pvec(FILE* fout, const ObjPVec_t* vec, bool recurse)
+{
+    if (!recurse)
+    {
+        fprintf(fout, "<pvector>");
+        return;
+    }
+
+    fprintf(fout, "[ ");
+    for (size_t i = 0; i < vec->count; i++)
+    {
+        print_elem(fout, PVec_Get(vec, i));
+
+        if (i != vec->count - 1)
+            fprintf(fout, ", ");
+    }
+    fprintf(fout, " ]");
+}
+
+
+static void print_pmap(FILE* fout, const ObjPMap_t* map, bool recurse)
+{
+    if (!recurse)
+    {
+        fprintf(fout, "<pmap>");
+        return;
+    }
+
+    PairPrinter_t printer = { .fout = fout, .printed = 0, .count = map->count };
+    fprintf(fout, "{ ");
+    PMap_Each(map, print_pair, &printer);
+    fprintf(fout, " }");
+}
+
+
+static void print_pair(void* ctx, Value_t key, Value_t val)
+{
+    PairPrinter_t* printer = ctx;
+    print_elem(printer->fout, key);
+    fprintf(printer->fout, ": ");
+    print_elem(printer->fout, val);
+
+    if (++printer->printed != printer->count)
+        fprintf(printer->fout, ", ");
+}
+
+
+/* the objects in an array or a map are not printed recursively */
+static void print_elem(FILE* fout, const Value_t val)
+{
+    if (VAL_OBJ != VALTYPE(val))
+        Value_Print(fout, val);
+    else
+        print_obj(fout, val, false);
+}
+
+
 static void print_function(FILE* fout, const ObjFunction_t* fun)
 {
     if (fun->name == NULL)
@@ -426,38 +1324,213 @@ static ObjString_t* allocate_string(VM_t* vm, char* cstr, int len, uint32_t hash
 #endif /* OBJSTR_FLEXIBLE_ARR */
 
     string->len = len;
-    string->hash = hash;
+    set_interned(vm, string, hash);
+    return string;
+}
+
 
+static void set_interned(VM_t* vm, ObjString_t* string, uint32_t hash)
+{
+    string->is_interned = true;
+    string->hash = hash;
     Table_Set(&vm->strings, string, NIL_VAL());
-    return string;
 }
 
 
 
 static Obj_t* allocate_obj(VM_t* vm, size_t nbytes, ObjType_t type)
 {
-    Obj_t* obj = ALLOCATE(vm, uint8_t, nbytes);
+    Obj_t* obj = GC_AllocateObj(vm, nbytes, type);
     obj->type = type;
-    obj->is_marked = false;
-
-    obj->next = vm->head;
-    vm->head = obj;
     DEBUG_GC_PRINT("%p allocate %zu for %d\n", (void*)obj, nbytes, type);
     return obj;
 }
 
 
+static size_t array_bytes(ElemKind_t kind, size_t count)
+{
+    return count * (ELEMS_NUMBERS == kind ? sizeof(double) : sizeof(Value_t));
+}
+
+static void* array_at(const ObjArray_t* arr, size_t i)
+{
+    return (uint8_t*)arr->as.vals + array_bytes(arr->kind, i);
+}
+
+/* reallocates the buffer of an array that does not share it, the capacity is at least its size */
+static void set_capacity(VM_t* vm, ObjArray_t* arr, size_t capacity)
+{
+    arr->as.vals = GC_Reallocate(vm, arr->as.vals,
+        array_bytes(arr->kind, arr->capacity), array_bytes(arr->kind, capacity)
+    );
+    arr->capacity = capacity;
+}
+
+
+/* doubles the room of a full deque, its elements start at the front of the new buffer */
+static void deque_grow(VM_t* vm, ObjDeque_t* deque)
+{
+    size_t capacity = GROW_CAPACITY(deque->capacity);
+    Value_t* vals = ALLOCATE(vm, Value_t, capacity);
+    for (size_t i = 0; i < deque->count; i++)
+        vals[i] = ObjDeque_Get(deque, i);
+
+    FREE_ARRAY(vm, Value_t, deque->vals, deque->capacity);
+    deque->head = 0;
+    deque->capacity = capacity;
+    deque->vals = vals;
+}
+
+
+static inline bool pq_less(const PQEntry_t* a, const PQEntry_t* b, SortLess_t less, void* ctx)
+{
+    if (NULL != less)
+        return less(ctx, a->val, b->val);
+    return a->key < b->key;
+}
+
+/* the entries are only ever swapped, so that all of them are in the heap whenever less runs */
+static void pq_sift_up(ObjPQueue_t* pq, size_t i, SortLess_t less, void* ctx)
+{
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
+        if (!pq_less(&pq->entries[i], &pq->entries[parent], less, ctx))
+            return;
+
+        PQEntry_t tmp = pq->entries[i];
+        pq->entries[i] = pq->entries[parent];
+        pq->entries[parent] = tmp;
+        i = parent;
+    }
+}
+
+static void pq_sift_down(ObjPQueue_t* pq, size_t i, SortLess_t less, void* ctx)
+{
+    for (;;)
+    {
+        size_t child = 2*i + 1;
+        if (child >= pq->count)
+            return;
+        if (child + 1 < pq->count && pq_less(&pq->entries[child + 1], &pq->entries[child], less, ctx))
+            child++;
+        if (!pq_less(&pq->entries[child], &pq->entries[i], less, ctx))
+            return;
+
+        PQEntry_t tmp = pq->entries[i];
+        pq->entries[i] = pq->entries[child];
+        pq->entries[child] = tmp;
+        i = child;
+    }
+}
+
+
+/* hands arr's buffer over to a new frozen array which arr then shares it with */
+static void share_elems(VM_t* vm, ObjArray_t* arr)
+{
+    ObjArray_t* frozen = ObjArr_Create(vm);
+    frozen->kind = arr->kind;
+    frozen->size = arr->size;
+    frozen->capacity = arr->capacity;
+    frozen->as = arr->as;
+
+    arr->shared = REF(frozen);
+    arr->start = 0;
+    arr->capacity = arr->size;
+}
+
+
 /* FNV-1a hashing */
-static uint32_t hash_str(const char* str, int len)
+/* 
+ *  8 bytes at a time, the bytes left over are read with the last 8 (overlapping the ones before), 
+ *  strings under 8 bytes are read in 2 overlapping halves, or 3 bytes under 4,
+ *  the length is mixed in first so that these overlaps cannot collide
+ */
+static uint32_t hash_str(uint64_t seed, const char* str, int len)
 {
-    uint32_t hash = 2166136261u;
-    for (int i = 0; i < len; i++)
+    uint64_t hash = seed ^ ((uint64_t)len * HASH_MUL);
+    uint64_t last = 0;
+
+    if (len >= 8)
+    {
+        const char* end = str + len - 8;
+        for (; str < end; str += 8)
+        {
+            uint64_t word;
+            memcpy(&word, str, sizeof(word));
+            hash = (hash ^ word) * HASH_MUL;
+            hash ^= hash >> 29;
+        }
+        memcpy(&last, end, sizeof(last));
+    }
+    else if (len >= 4)
+    {
+        uint32_t lo, hi;
+        memcpy(&lo, str, sizeof(lo));
+        memcpy(&hi, str + len - 4, sizeof(hi));
+        last = (uint64_t)hi << 32 | lo;
+    }
+    else if (len > 0)
     {
-        hash = HASH_BYTE(hash, str[i]);
+        last = (uint64_t)(uint8_t)str[0] << 16 
+            | (uint64_t)(uint8_t)str[len / 2] << 8 
+            | (uint8_t)str[len - 1];
     }
+    return (uint32_t)hash_finish(hash ^ last);
+}
+
+
+/* murmur3's finalizer, every bit of the input reaches the low bits the tables index with */
+static uint64_t hash_finish(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
     return hash;
 }
 
 
 
+/* \returns the string of a string or of a flattened rope, NULL for a rope that is not flattened */
+static const ObjString_t* rope_leaf(const Obj_t* obj)
+{
+    if (OBJ_STRING == obj->type)
+        return (const ObjString_t*)obj;
+
+    const ObjRope_t* rope = (const ObjRope_t*)obj;
+    if (NULL == DEREF_NULLABLE(Obj_t, rope->right))
+        return (const ObjString_t*)DEREF(Obj_t, rope->left);
+    return NULL;
+}
+
 
+/* 
+ * writes the strings of the rope from the last one to the first one, 
+ * the left sides wait on the stack (depth entries at most), 
+ * so the ropes built by appending in a loop only ever need one
+ */
+static void rope_write(const ObjRope_t* rope, char* dst, const Obj_t** stack)
+{
+    int count = 0;
+    int end = rope->len;
+    const Obj_t* node = (const Obj_t*)rope;
+    while (true)
+    {
+        const ObjString_t* leaf = rope_leaf(node);
+        if (NULL == leaf)
+        {
+            const ObjRope_t* inner = (const ObjRope_t*)node;
+            stack[count++] = DEREF(Obj_t, inner->left);
+            node = DEREF(Obj_t, inner->right);
+            continue;
+        }
+
+        end -= leaf->len;
+        memcpy(dst + end, leaf->cstr, leaf->len);
+        if (0 == count)
+            break;
+        node = stack[--count];
+    }
+}
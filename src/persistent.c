@@ -0,0 +1,635 @@
+#include <string.h>
+
+#include "include/common.h"
+#include "include/object.h"
+#include "include/persistent.h"
+#include "include/table.h"
+#include "include/vm.h"
+
+
+
+#define PNODE_MASK (PNODE_WIDTH - 1)
+
+/* the shift past which a map's hash is used up, the keys that are still together there collide */
+#define PMAP_HASH_BITS 32
+
+
+static ObjPVec_t* make_vec(VM_t* vm, size_t count, uint32_t shift, ObjPNode_t* root, ObjPNode_t* tail);
+static size_t tail_offset(const ObjPVec_t* vec);
+static ObjPNode_t* leaf_for(const ObjPVec_t* vec, size_t i);
+static ObjPNode_t* assoc_path(VM_t* vm, const ObjPNode_t* node, uint32_t level, size_t i, Value_t val);
+static ObjPVec_t* push_leaf(VM_t* vm, ObjPVec_t* vec, ObjPNode_t* leaf);
+static ObjPNode_t* push_tail(VM_t* vm, size_t count, uint32_t level, const ObjPNode_t* parent, ObjPNode_t* tail);
+static ObjPNode_t* new_path(VM_t* vm, uint32_t level, ObjPNode_t* node);
+static ObjPNode_t* pop_tail(VM_t* vm, size_t count, uint32_t level, const ObjPNode_t* node);
+
+static ObjPMap_t* make_map(VM_t* vm, size_t count, ObjPNode_t* root);
+static ObjPNode_t* set_node(VM_t* vm, const ObjPNode_t* node, Value_t key, Value_t val, uint32_t hash, uint32_t shift, bool* added);
+static ObjPNode_t* pair_node(VM_t* vm, Value_t k1, Value_t v1, uint32_t h1, Value_t k2, Value_t v2, uint32_t h2, uint32_t shift);
+static ObjPNode_t* delete_node(VM_t* vm, ObjPNode_t* node, Value_t key, uint32_t hash, uint32_t shift);
+static void each_pair(const ObjPNode_t* node, PMapVisit_t visit, void* ctx);
+
+
+
+static inline ObjPNode_t* child_at(const ObjPNode_t* node, uint32_t i)
+{
+    return AS_PNODE(node->slots[i]);
+}
+
+static inline Value_t node_val(ObjPNode_t* node)
+{
+    return NULL == node ? NIL_VAL() : OBJ_VAL(node);
+}
+
+static inline uint32_t bit_of(uint32_t hash, uint32_t shift)
+{
+    return 1u << ((hash >> shift) & PNODE_MASK);
+}
+
+/* where the pair or the child node of the bit is, or would be */
+static inline uint32_t data_index(const ObjPNode_t* node, uint32_t bit)
+{
+    return 2 * __builtin_popcount(node->datamap & (bit - 1));
+}
+
+static inline uint32_t node_index(const ObjPNode_t* node, uint32_t bit)
+{
+    return 2 * __builtin_popcount(node->datamap) + __builtin_popcount(node->nodemap & (bit - 1));
+}
+
+/* a child node that is down to a single pair is replaced by the pair */
+static inline bool is_single(const ObjPNode_t* node)
+{
+    return 0 == node->nodemap && 2 == node->len;
+}
+
+
+
+
+
+
+
+
+Value_t PVec_Get(const ObjPVec_t* vec, size_t i)
+{
+    return leaf_for(vec, i)->slots[i & PNODE_MASK];
+}
+
+
+ObjPVec_t* PVec_Set(VM_t* vm, ObjPVec_t* vec, size_t i, Value_t val)
+{
+    ObjPNode_t* root = DEREF_NULLABLE(ObjPNode_t, vec->root);
+    ObjPNode_t* tail = DEREF(ObjPNode_t, vec->tail);
+    if (i >= tail_offset(vec))
+    {
+        tail = ObjPNode_Create(vm, tail, tail->len);
+        tail->slots[i & PNODE_MASK] = val;
+    }
+    else
+    {
+        root = assoc_path(vm, root, vec->shift, i, val);
+    }
+    return make_vec(vm, vec->count, vec->shift, root, tail);
+}
+
+
+ObjPVec_t* PVec_Push(VM_t* vm, ObjPVec_t* vec, Value_t val)
+{
+    ObjPNode_t* tail = DEREF_NULLABLE(ObjPNode_t, vec->tail);
+    if (vec->count - tail_offset(vec) < PNODE_WIDTH)
+    {
+        tail = ObjPNode_Create(vm, tail, NULL == tail ? 1 : tail->len + 1);
+        tail->slots[tail->len - 1] = val;
+        return make_vec(vm, vec->count + 1, vec->shift, DEREF_NULLABLE(ObjPNode_t, vec->root), tail);
+    }
+
+    ObjPNode_t* leaf = ObjPNode_Create(vm, NULL, 1);
+    leaf->slots[0] = val;
+    return push_leaf(vm, vec, leaf);
+}
+
+
+ObjPVec_t* PVec_Pop(VM_t* vm, ObjPVec_t* vec)
+{
+    if (1 == vec->count)
+        return ObjPVec_Create(vm, 0, PNODE_BITS, NULL, NULL);
+
+    ObjPNode_t* root = DEREF_NULLABLE(ObjPNode_t, vec->root);
+    ObjPNode_t* tail = DEREF(ObjPNode_t, vec->tail);
+    if (tail->len > 1)
+    {
+        tail = ObjPNode_Create(vm, tail, tail->len - 1);
+        return make_vec(vm, vec->count - 1, vec->shift, root, tail);
+    }
+
+    /* the last leaf of the trie becomes the tail, the root goes when it is down to a child */
+    uint32_t shift = vec->shift;
+    tail = leaf_for(vec, vec->count - 2);
+    root = pop_tail(vm, vec->count, shift, root);
+    if (NULL != root && shift > PNODE_BITS && 1 == root->len)
+    {
+        root = child_at(root, 0);
+        shift -= PNODE_BITS;
+    }
+    return make_vec(vm, vec->count - 1, shift, root, tail);
+}
+
+
+ObjPVec_t* PVec_FromArray(VM_t* vm, ObjArray_t* arr)
+{
+    if (0 == arr->size)
+        return ObjPVec_Create(vm, 0, PNODE_BITS, NULL, NULL);
+
+    ObjPVec_t* vec = NULL;
+    VM_Push(vm, NIL_VAL());
+    for (size_t start = 0; start < arr->size; start += PNODE_WIDTH)
+    {
+        size_t len = arr->size - start < PNODE_WIDTH ? arr->size - start : PNODE_WIDTH;
+        ObjPNode_t* leaf = ObjPNode_Create(vm, NULL, (uint32_t)len);
+        for (size_t i = 0; i < len; i++)
+        {
+            leaf->slots[i] = ObjArr_Get(arr, start + i);
+        }
+
+        /* the leaves before the last one are full, so each of them goes in the trie once the next one comes */
+        vec = NULL == vec
+            ? make_vec(vm, len, PNODE_BITS, NULL, leaf)
+            : push_leaf(vm, vec, leaf);
+        vm->sp[-1] = OBJ_VAL(vec);
+    }
+    VM_Pop(vm);
+    return vec;
+}
+
+
+
+
+bool PMap_Get(VM_t* vm, const ObjPMap_t* map, Value_t key, Value_t* val_out)
+{
+    const ObjPNode_t* node = DEREF_NULLABLE(ObjPNode_t, map->root);
+    if (NULL == node)
+        return false;
+
+    const uint32_t hash = Map_HashKey(vm, key);
+    for (uint32_t shift = 0; ; shift += PNODE_BITS)
+    {
+        if (node->collision)
+        {
+            for (uint32_t i = 0; i < node->len; i += 2)
+            {
+                if (Map_KeyEqual(node->slots[i], key))
+                {
+                    *val_out = node->slots[i + 1];
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        const uint32_t bit = bit_of(hash, shift);
+        if (node->datamap & bit)
+        {
+            uint32_t i = data_index(node, bit);
+            if (!Map_KeyEqual(node->slots[i], key))
+                return false;
+            *val_out = node->slots[i + 1];
+            return true;
+        }
+        if (!(node->nodemap & bit))
+            return false;
+        node = child_at(node, node_index(node, bit));
+    }
+}
+
+
+ObjPMap_t* PMap_Set(VM_t* vm, ObjPMap_t* map, Value_t key, Value_t val)
+{
+    const uint32_t hash = Map_HashKey(vm, key);
+    ObjPNode_t* root = DEREF_NULLABLE(ObjPNode_t, map->root);
+    bool added = true;
+    if (NULL == root)
+    {
+        root = ObjPNode_Create(vm, NULL, 2);
+        root->datamap = bit_of(hash, 0);
+        root->slots[0] = key;
+        root->slots[1] = val;
+    }
+    else
+    {
+        added = false;
+        root = set_node(vm, root, key, val, hash, 0, &added);
+    }
+    return make_map(vm, map->count + added, root);
+}
+
+
+ObjPMap_t* PMap_Delete(VM_t* vm, ObjPMap_t* map, Value_t key)
+{
+    ObjPNode_t* root = DEREF_NULLABLE(ObjPNode_t, map->root);
+    if (NULL == root)
+        return map;
+
+    ObjPNode_t* smaller = delete_node(vm, root, key, Map_HashKey(vm, key), 0);
+    if (smaller == root)
+        return map;
+    return make_map(vm, map->count - 1, smaller);
+}
+
+
+ObjPMap_t* PMap_FromMap(VM_t* vm, Map_t* src)
+{
+    for (size_t i = 0; i < src->capacity; i++)
+    {
+        if (Map_IsFull(src, i) && !PMap_IsKey(src->keys[i]))
+            return NULL;
+    }
+
+    ObjPMap_t* map = ObjPMap_Create(vm, 0, NULL);
+    VM_Push(vm, OBJ_VAL(map));
+    for (size_t i = 0; i < src->capacity; i++)
+    {
+        if (!Map_IsFull(src, i))
+            continue;
+        map = PMap_Set(vm, map, src->keys[i], src->vals[i]);
+        vm->sp[-1] = OBJ_VAL(map);
+    }
+    VM_Pop(vm);
+    return map;
+}
+
+
+void PMap_Each(const ObjPMap_t* map, PMapVisit_t visit, void* ctx)
+{
+    const ObjPNode_t* root = DEREF_NULLABLE(ObjPNode_t, map->root);
+    if (NULL != root)
+        each_pair(root, visit, ctx);
+}
+
+
+
+
+
+
+
+
+/* the nodes are kept where the gc sees them while the vector is made */
+static ObjPVec_t* make_vec(VM_t* vm, size_t count, uint32_t shift, ObjPNode_t* root, ObjPNode_t* tail)
+{
+    VM_Push(vm, node_val(root));
+    VM_Push(vm, node_val(tail));
+    ObjPVec_t* vec = ObjPVec_Create(vm, count, shift, root, tail);
+    vm->sp -= 2;
+    return vec;
+}
+
+
+/* the index of the tail's first element */
+static size_t tail_offset(const ObjPVec_t* vec)
+{
+    if (vec->count < PNODE_WIDTH)
+        return 0;
+    return ((vec->count - 1) >> PNODE_BITS) << PNODE_BITS;
+}
+
+
+/* the node that has the element at i */
+static ObjPNode_t* leaf_for(const ObjPVec_t* vec, size_t i)
+{
+    if (i >= tail_offset(vec))
+        return DEREF(ObjPNode_t, vec->tail);
+
+    ObjPNode_t* node = DEREF(ObjPNode_t, vec->root);
+    for (uint32_t level = vec->shift; level > 0; level -= PNODE_BITS)
+    {
+        node = child_at(node, (i >> level) & PNODE_MASK);
+    }
+    return node;
+}
+
+
+/* copies the nodes on the path to the element at i, down to its leaf */
+static ObjPNode_t* assoc_path(VM_t* vm, const ObjPNode_t* node, uint32_t level, size_t i, Value_t val)
+{
+    ObjPNode_t* copy = ObjPNode_Create(vm, node, node->len);
+    if (0 == level)
+    {
+        copy->slots[i & PNODE_MASK] = val;
+        return copy;
+    }
+
+    uint32_t sub = (i >> level) & PNODE_MASK;
+    VM_Push(vm, OBJ_VAL(copy));
+    ObjPNode_t* child = assoc_path(vm, child_at(node, sub), level - PNODE_BITS, i, val);
+    copy->slots[sub] = OBJ_VAL(child);
+    VM_Pop(vm);
+    return copy;
+}
+
+
+/*
+ *  the vector's tail, which is full, goes in the trie and leaf takes its place,
+ *  the trie gets a level deeper once its root is full
+ */
+static ObjPVec_t* push_leaf(VM_t* vm, ObjPVec_t* vec, ObjPNode_t* leaf)
+{
+    VM_Push(vm, OBJ_VAL(leaf));
+
+    ObjPNode_t* tail = DEREF(ObjPNode_t, vec->tail);
+    ObjPNode_t* root = DEREF_NULLABLE(ObjPNode_t, vec->root);
+    uint32_t shift = vec->shift;
+    if (NULL == root)
+    {
+        root = ObjPNode_Create(vm, NULL, 1);
+        root->slots[0] = OBJ_VAL(tail);
+    }
+    else if ((vec->count >> PNODE_BITS) > ((size_t)1 << shift))
+    {
+        ObjPNode_t* path = new_path(vm, shift, tail);
+        VM_Push(vm, OBJ_VAL(path));
+        ObjPNode_t* top = ObjPNode_Create(vm, NULL, 2);
+        VM_Pop(vm);
+        top->slots[0] = OBJ_VAL(root);
+        top->slots[1] = OBJ_VAL(path);
+        root = top;
+        shift += PNODE_BITS;
+    }
+    else
+    {
+        root = push_tail(vm, vec->count, shift, root, tail);
+    }
+
+    ObjPVec_t* pushed = make_vec(vm, vec->count + leaf->len, shift, root, leaf);
+    VM_Pop(vm);
+    return pushed;
+}
+
+
+/* copies the nodes on the path to the tail's place in the trie, which is right after the last leaf */
+static ObjPNode_t* push_tail(VM_t* vm, size_t count, uint32_t level, const ObjPNode_t* parent, ObjPNode_t* tail)
+{
+    uint32_t sub = ((count - 1) >> level) & PNODE_MASK;
+    ObjPNode_t* copy = ObjPNode_Create(vm, parent, sub < parent->len ? parent->len : sub + 1);
+    if (PNODE_BITS == level)
+    {
+        copy->slots[sub] = OBJ_VAL(tail);
+        return copy;
+    }
+
+    VM_Push(vm, OBJ_VAL(copy));
+    ObjPNode_t* child = sub < parent->len
+        ? push_tail(vm, count, level - PNODE_BITS, child_at(parent, sub), tail)
+        : new_path(vm, level - PNODE_BITS, tail);
+    copy->slots[sub] = OBJ_VAL(child);
+    VM_Pop(vm);
+    return copy;
+}
+
+
+/* the nodes of a single child each from level down to node */
+static ObjPNode_t* new_path(VM_t* vm, uint32_t level, ObjPNode_t* node)
+{
+    for (; level > 0; level -= PNODE_BITS)
+    {
+        VM_Push(vm, OBJ_VAL(node));
+        ObjPNode_t* parent = ObjPNode_Create(vm, NULL, 1);
+        VM_Pop(vm);
+        parent->slots[0] = OBJ_VAL(node);
+        node = parent;
+    }
+    return node;
+}
+
+
+/* copies the nodes on the path to the last leaf without it, NULL for a node that is left empty */
+static ObjPNode_t* pop_tail(VM_t* vm, size_t count, uint32_t level, const ObjPNode_t* node)
+{
+    uint32_t sub = ((count - 2) >> level) & PNODE_MASK;
+    if (PNODE_BITS == level)
+        return 0 == sub ? NULL : ObjPNode_Create(vm, node, sub);
+
+    ObjPNode_t* child = pop_tail(vm, count, level - PNODE_BITS, child_at(node, sub));
+    if (NULL == child && 0 == sub)
+        return NULL;
+
+    VM_Push(vm, node_val(child));
+    ObjPNode_t* copy = ObjPNode_Create(vm, node, NULL == child ? sub : node->len);
+    VM_Pop(vm);
+    if (NULL != child)
+        copy->slots[sub] = OBJ_VAL(child);
+    return copy;
+}
+
+
+
+
+/* the root is kept where the gc sees it while the map is made */
+static ObjPMap_t* make_map(VM_t* vm, size_t count, ObjPNode_t* root)
+{
+    VM_Push(vm, node_val(root));
+    ObjPMap_t* map = ObjPMap_Create(vm, count, root);
+    VM_Pop(vm);
+    return map;
+}
+
+
+/* copies the nodes on the path to the key, added is set when the key is new */
+static ObjPNode_t* set_node(VM_t* vm, const ObjPNode_t* node, Value_t key, Value_t val, uint32_t hash, uint32_t shift, bool* added)
+{
+    ObjPNode_t* copy;
+    if (node->collision)
+    {
+        for (uint32_t i = 0; i < node->len; i += 2)
+        {
+            if (Map_KeyEqual(node->slots[i], key))
+            {
+                copy = ObjPNode_Create(vm, node, node->len);
+                copy->slots[i + 1] = val;
+                return copy;
+            }
+        }
+        *added = true;
+        copy = ObjPNode_Create(vm, node, node->len + 2);
+        copy->slots[node->len] = key;
+        copy->slots[node->len + 1] = val;
+        return copy;
+    }
+
+    const uint32_t bit = bit_of(hash, shift);
+    if (node->datamap & bit)
+    {
+        uint32_t i = data_index(node, bit);
+        if (Map_KeyEqual(node->slots[i], key))
+        {
+            copy = ObjPNode_Create(vm, node, node->len);
+            copy->slots[i + 1] = val;
+            return copy;
+        }
+
+        /* the pair already there and the new one go down a level together */
+        *added = true;
+        ObjPNode_t* child = pair_node(vm,
+            node->slots[i], node->slots[i + 1], Map_HashKey(vm, node->slots[i]),
+            key, val, hash, shift + PNODE_BITS
+        );
+        VM_Push(vm, OBJ_VAL(child));
+        copy = ObjPNode_Create(vm, NULL, node->len - 1);
+        VM_Pop(vm);
+        copy->datamap = node->datamap ^ bit;
+        copy->nodemap = node->nodemap | bit;
+
+        /* the pairs before i, the pairs after it and the nodes before the child, the child, the nodes after it */
+        uint32_t at = node_index(copy, bit);
+        memcpy(copy->slots, node->slots, i * sizeof(Value_t));
+        memcpy(copy->slots + i, node->slots + i + 2, (at - i) * sizeof(Value_t));
+        copy->slots[at] = OBJ_VAL(child);
+        memcpy(copy->slots + at + 1, node->slots + at + 2, (node->len - at - 2) * sizeof(Value_t));
+        return copy;
+    }
+
+    if (node->nodemap & bit)
+    {
+        uint32_t i = node_index(node, bit);
+        ObjPNode_t* child = set_node(vm, child_at(node, i), key, val, hash, shift + PNODE_BITS, added);
+        VM_Push(vm, OBJ_VAL(child));
+        copy = ObjPNode_Create(vm, node, node->len);
+        VM_Pop(vm);
+        copy->slots[i] = OBJ_VAL(child);
+        return copy;
+    }
+
+    *added = true;
+    uint32_t i = data_index(node, bit);
+    copy = ObjPNode_Create(vm, NULL, node->len + 2);
+    copy->datamap = node->datamap | bit;
+    copy->nodemap = node->nodemap;
+    memcpy(copy->slots, node->slots, i * sizeof(Value_t));
+    copy->slots[i] = key;
+    copy->slots[i + 1] = val;
+    memcpy(copy->slots + i + 2, node->slots + i, (node->len - i) * sizeof(Value_t));
+    return copy;
+}
+
+
+/* a node of the 2 pairs, as deep as it takes for their hashes to part */
+static ObjPNode_t* pair_node(VM_t* vm, Value_t k1, Value_t v1, uint32_t h1, Value_t k2, Value_t v2, uint32_t h2, uint32_t shift)
+{
+    ObjPNode_t* node;
+    if (shift >= PMAP_HASH_BITS)
+    {
+        node = ObjPNode_Create(vm, NULL, 4);
+        node->collision = true;
+        node->slots[0] = k1;
+        node->slots[1] = v1;
+        node->slots[2] = k2;
+        node->slots[3] = v2;
+        return node;
+    }
+
+    const uint32_t b1 = bit_of(h1, shift);
+    const uint32_t b2 = bit_of(h2, shift);
+    if (b1 == b2)
+    {
+        ObjPNode_t* child = pair_node(vm, k1, v1, h1, k2, v2, h2, shift + PNODE_BITS);
+        VM_Push(vm, OBJ_VAL(child));
+        node = ObjPNode_Create(vm, NULL, 1);
+        VM_Pop(vm);
+        node->nodemap = b1;
+        node->slots[0] = OBJ_VAL(child);
+        return node;
+    }
+
+    node = ObjPNode_Create(vm, NULL, 4);
+    node->datamap = b1 | b2;
+    int first = b1 < b2 ? 0 : 2;
+    node->slots[first] = k1;
+    node->slots[first + 1] = v1;
+    node->slots[2 - first] = k2;
+    node->slots[3 - first] = v2;
+    return node;
+}
+
+
+/*
+ *  copies the nodes on the path to the key without it,
+ *  the node itself if it does not have the key, NULL if it is left empty
+ */
+static ObjPNode_t* delete_node(VM_t* vm, ObjPNode_t* node, Value_t key, uint32_t hash, uint32_t shift)
+{
+    ObjPNode_t* copy;
+    if (node->collision)
+    {
+        for (uint32_t i = 0; i < node->len; i += 2)
+        {
+            if (!Map_KeyEqual(node->slots[i], key))
+                continue;
+            copy = ObjPNode_Create(vm, NULL, node->len - 2);
+            copy->collision = true;
+            memcpy(copy->slots, node->slots, i * sizeof(Value_t));
+            memcpy(copy->slots + i, node->slots + i + 2, (node->len - i - 2) * sizeof(Value_t));
+            return copy;
+        }
+        return node;
+    }
+
+    const uint32_t bit = bit_of(hash, shift);
+    if (node->datamap & bit)
+    {
+        uint32_t i = data_index(node, bit);
+        if (!Map_KeyEqual(node->slots[i], key))
+            return node;
+        if (2 == node->len)
+            return NULL;
+
+        copy = ObjPNode_Create(vm, NULL, node->len - 2);
+        copy->datamap = node->datamap ^ bit;
+        copy->nodemap = node->nodemap;
+        memcpy(copy->slots, node->slots, i * sizeof(Value_t));
+        memcpy(copy->slots + i, node->slots + i + 2, (node->len - i - 2) * sizeof(Value_t));
+        return copy;
+    }
+
+    if (!(node->nodemap & bit))
+        return node;
+
+    uint32_t i = node_index(node, bit);
+    ObjPNode_t* child = child_at(node, i);
+    ObjPNode_t* smaller = delete_node(vm, child, key, hash, shift + PNODE_BITS);
+    if (smaller == child)
+        return node;
+
+    VM_Push(vm, OBJ_VAL(smaller));
+    if (is_single(smaller))
+    {
+        /* the pair goes where the child was, which makes this node a single pair when it had nothing else */
+        copy = ObjPNode_Create(vm, NULL, node->len + 1);
+        copy->datamap = node->datamap | bit;
+        copy->nodemap = node->nodemap ^ bit;
+        uint32_t at = data_index(copy, bit);
+        memcpy(copy->slots, node->slots, at * sizeof(Value_t));
+        copy->slots[at] = smaller->slots[0];
+        copy->slots[at + 1] = smaller->slots[1];
+        memcpy(copy->slots + at + 2, node->slots + at, (i - at) * sizeof(Value_t));
+        memcpy(copy->slots + i + 2, node->slots + i + 1, (node->len - i - 1) * sizeof(Value_t));
+    }
+    else
+    {
+        copy = ObjPNode_Create(vm, node, node->len);
+        copy->slots[i] = OBJ_VAL(smaller);
+    }
+    VM_Pop(vm);
+    return copy;
+}
+
+
+static void each_pair(const ObjPNode_t* node, PMapVisit_t visit, void* ctx)
+{
+    uint32_t pairs_end = node->collision ? node->len : 2 * __builtin_popcount(node->datamap);
+    for (uint32_t i = 0; i < pairs_end; i += 2)
+    {
+        visit(ctx, node->slots[i], node->slots[i + 1]);
+    }
+    for (uint32_t i = pairs_end; i < node->len; i++)
+    {
+        each_pair(child_at(node, i), visit, ctx);
+    }
+}
@@ -0,0 +1,181 @@
+
+#include <string.h>
+
+#include "include/common.h"
+#include "include/object.h"
+#include "include/sort.h"
+
+
+/* runs this short are insertion sorted */
+#define SORT_SHORT_RUN 16
+
+
+
+/*
+ *  the same introsort for the packed numbers and for the values,
+ *  LESS(a, b) is an expression on pointers to 2 elements, and ctx is in scope for it
+ */
+#define DEFINE_INTROSORT(name, T, Ctx_t, LESS)\
+static inline void name##_swap(T* a, T* b)\
+{\
+    T tmp = *a;\
+    *a = *b;\
+    *b = tmp;\
+}\
+\
+static void name##_insertion(T* elems, size_t n, Ctx_t ctx)\
+{\
+    for (size_t i = 1; i < n; i++)\
+    {\
+        for (size_t j = i; j > 0 && LESS(&elems[j], &elems[j - 1]); j--)\
+            name##_swap(&elems[j], &elems[j - 1]);\
+    }\
+}\
+\
+static void name##_sift_down(T* elems, size_t root, size_t n, Ctx_t ctx)\
+{\
+    for (;;)\
+    {\
+        size_t child = 2*root + 1;\
+        if (child >= n)\
+            return;\
+        if (child + 1 < n && LESS(&elems[child], &elems[child + 1]))\
+            child++;\
+        if (!LESS(&elems[root], &elems[child]))\
+            return;\
+        name##_swap(&elems[root], &elems[child]);\
+        root = child;\
+    }\
+}\
+\
+static void name##_heapsort(T* elems, size_t n, Ctx_t ctx)\
+{\
+    for (size_t i = n / 2; i > 0; i--)\
+        name##_sift_down(elems, i - 1, n, ctx);\
+    for (size_t end = n - 1; end > 0; end--)\
+    {\
+        name##_swap(&elems[0], &elems[end]);\
+        name##_sift_down(elems, 0, end, ctx);\
+    }\
+}\
+\
+/* the pivot is moved to elems[0] and stays there until it goes to where it belongs, which is returned */\
+static size_t name##_partition(T* elems, size_t n, Ctx_t ctx)\
+{\
+    size_t mid = n / 2;\
+    if (LESS(&elems[mid], &elems[0]))\
+        name##_swap(&elems[mid], &elems[0]);\
+    if (LESS(&elems[n - 1], &elems[mid]))\
+    {\
+        name##_swap(&elems[n - 1], &elems[mid]);\
+        if (LESS(&elems[mid], &elems[0]))\
+            name##_swap(&elems[mid], &elems[0]);\
+    }\
+    name##_swap(&elems[0], &elems[mid]);\
+\
+    /* both scans stop on elements equal to the pivot, which keeps runs of them balanced */\
+    size_t i = 0, j = n;\
+    for (;;)\
+    {\
+        do i++; while (i < n && LESS(&elems[i], &elems[0]));\
+        do j--; while (j > 0 && LESS(&elems[0], &elems[j]));\
+        if (i >= j)\
+            break;\
+        name##_swap(&elems[i], &elems[j]);\
+    }\
+    name##_swap(&elems[0], &elems[j]);\
+    return j;\
+}\
+\
+static void name##_loop(T* elems, size_t n, int depth, Ctx_t ctx)\
+{\
+    /* recurses into the shorter side, so that the c stack stays within log2(n) */\
+    while (n > SORT_SHORT_RUN)\
+    {\
+        if (0 == depth--)\
+        {\
+            name##_heapsort(elems, n, ctx);\
+            return;\
+        }\
+\
+        size_t pivot = name##_partition(elems, n, ctx);\
+        size_t left = pivot, right = n - pivot - 1;\
+        if (left < right)\
+        {\
+            name##_loop(elems, left, depth, ctx);\
+            elems += pivot + 1;\
+            n = right;\
+        }\
+        else\
+        {\
+            name##_loop(elems + pivot + 1, right, depth, ctx);\
+            n = left;\
+        }\
+    }\
+    name##_insertion(elems, n, ctx);\
+}\
+\
+static void name(T* elems, size_t n, Ctx_t ctx)\
+{\
+    int depth = 0;\
+    for (size_t len = n; len > 1; len >>= 1)\
+        depth += 2;\
+    name##_loop(elems, n, depth, ctx);\
+}
+
+
+#define NUM_LESS(a, b) ((void)ctx, *(a) < *(b))
+#define NUM_LESS_BY(a, b) ctx->less(ctx->data, NUMBER_VAL(*(a)), NUMBER_VAL(*(b)))
+#define VAL_LESS(a, b) ctx->less(ctx->data, *(a), *(b))
+
+typedef struct LessCtx_t
+{
+    SortLess_t less;
+    void* data;
+} LessCtx_t;
+
+DEFINE_INTROSORT(introsort_nums, double, const void*, NUM_LESS)
+DEFINE_INTROSORT(introsort_nums_by, double, const LessCtx_t*, NUM_LESS_BY)
+DEFINE_INTROSORT(introsort_vals, Value_t, const LessCtx_t*, VAL_LESS)
+
+
+
+
+
+
+void Sort_Numbers(double* nums, size_t n)
+{
+    introsort_nums(nums, n, NULL);
+}
+
+
+void Sort_NumbersBy(double* nums, size_t n, SortLess_t less, void* ctx)
+{
+    LessCtx_t less_ctx = { .less = less, .data = ctx };
+    introsort_nums_by(nums, n, &less_ctx);
+}
+
+
+void Sort_Values(Value_t* vals, size_t n, SortLess_t less, void* ctx)
+{
+    LessCtx_t less_ctx = { .less = less, .data = ctx };
+    introsort_vals(vals, n, &less_ctx);
+}
+
+
+bool Sort_NumLess(void* ctx, Value_t a, Value_t b)
+{
+    (void)ctx;
+    return AS_NUMBER(a) < AS_NUMBER(b);
+}
+
+
+bool Sort_StrLess(void* ctx, Value_t a, Value_t b)
+{
+    (void)ctx;
+    StrView_t view_a = ObjStr_View(AS_OBJ(a));
+    StrView_t view_b = ObjStr_View(AS_OBJ(b));
+    int cmp = memcmp(view_a.chars, view_b.chars, view_a.len < view_b.len? view_a.len : view_b.len);
+    return cmp < 0 || (0 == cmp && view_a.len < view_b.len);
+}
+
@@ -10,28 +10,55 @@
 #include "include/memory.h"
 #include "include/vm.h"
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif /* __SSE2__ */
 
-#define TABLE_MAX_LOAD 3/4
+
+#define TABLE_MAX_LOAD 7/8
+/* below this a table is shrunk, so that it's about half full like after it grows */
+#define TABLE_MIN_LOAD 1/8
+
+/* the group is picked by the high bits of the hash, the low 7 bits go in the ctrl byte */
+#define HASH_GROUP(hash) ((hash) >> 7)
+#define HASH_CTRL(hash) ((uint8_t)((hash) & 0x7F))
 
 static void adjust_capacity(Table_t* table, size_t newcap);
-static Entry_t* find_entry(Entry_t* entries, size_t num_entries, const ObjString_t* key);
-static inline bool is_tombstone(const Entry_t* entry);
-static inline bool is_empty(const Entry_t* entry);
+static inline bool find_key(const Table_t* table, const ObjString_t* key, size_t* index_out);
+static bool find_key_probe(const Table_t* table, const ObjString_t* key, size_t group, size_t* index_out);
+static size_t find_free_slot(const uint8_t* ctrl, size_t capacity, uint32_t hash);
+static size_t resized_capacity(size_t count, size_t deleted, size_t capacity);
+static bool clear_slot(uint8_t* ctrl, size_t index);
+static void remove_slot(Table_t* table, size_t index);
+static size_t probe_length(const Table_t* table, size_t index);
+static inline size_t table_bytes(size_t capacity);
+
+static void map_adjust_capacity(Map_t* map, size_t newcap);
+static void map_rehash_in_place(Map_t* map);
+static bool map_find(const Map_t* map, Value_t key, uint32_t hash, size_t* index_out);
+static uint32_t hash_key(VM_t* vm, Value_t key);
+static inline bool key_equal(Value_t a, Value_t b);
+static inline size_t map_bytes(size_t capacity);
+static inline uint32_t group_match(const uint8_t* group, uint8_t ctrl);
+static inline uint32_t group_match_free(const uint8_t* group);
 
 
 
 void Table_Init(Table_t* table, VM_t* vm)
 {
     table->count = 0;
+    table->deleted = 0;
     table->capacity = 0;
-    table->entries = NULL;
+    table->keys = NULL;
+    table->vals = NULL;
+    table->ctrl = NULL;
     table->vm = vm;
 }
 
 
 void Table_Free(Table_t* table)
 {
-    FREE_ARRAY(table->vm, Entry_t, table->entries, table->capacity);
+    FREE_ARRAY(table->vm, char, table->keys, table_bytes(table->capacity));
     Table_Init(table, table->vm);
 }
 
@@ -40,33 +67,27 @@ void Table_Free(Table_t* table)
 
 bool Table_Delete(Table_t* table, const ObjString_t* key)
 {
-    Entry_t* entry = find_entry(table->entries, table->capacity, key);
-    if (NULL == entry->key)
+    size_t index;
+    if (table->count == 0 || !find_key(table, key, &index))
     {
         return false;
     }
 
-    /* mark as tombstone */
-    entry->key = NULL;
-    entry->val = BOOL_VAL(true);
+    remove_slot(table, index);
     return true;
 }
 
 
-bool Table_Get(Table_t* table, const ObjString_t* key, Value_t* val)
+/* every global, field and method lookup goes through it */
+CLOX_ALWAYS_INLINE bool Table_Get(Table_t* table, const ObjString_t* key, Value_t* val)
 {
-    if (table->count == 0) 
-    {
-        return false;
-    }
-
-    Entry_t* entry = find_entry(table->entries, table->capacity, key);
-    if (is_empty(entry) || is_tombstone(entry))
+    size_t index;
+    if (table->count == 0 || !find_key(table, key, &index)) 
     {
         return false;
     }
 
-    *val = entry->val;
+    *val = table->vals[index];
     return true;
 }
 
@@ -74,27 +95,33 @@ bool Table_Get(Table_t* table, const ObjString_t* key, Value_t* val)
 
 bool Table_Set(Table_t* table, ObjString_t* key, Value_t val)
 {
-    if (table->count + 1 > table->capacity * TABLE_MAX_LOAD)
+    size_t index;
+    if (table->count != 0 && find_key(table, key, &index))
     {
-        VM_Push(table->vm, OBJ_VAL(key));
+        table->vals[index] = val;
+        return false;
+    }
 
-        size_t capacity = GROW_CAPACITY(table->capacity);
+    size_t capacity = resized_capacity(table->count, table->deleted, table->capacity);
+    if (0 != capacity)
+    {
+        VM_Push(table->vm, OBJ_VAL(key));
         adjust_capacity(table, capacity);
-
         VM_Pop(table->vm);
     }
 
 
-    Entry_t *entry = find_entry(table->entries, table->capacity, key);
-    bool is_new_key = entry->key == NULL;
-    if (is_new_key && is_empty(entry))
+    index = find_free_slot(table->ctrl, table->capacity, key->hash);
+    if (table->ctrl[index] == TABLE_CTRL_DELETED)
     {
-        table->count++;
+        table->deleted--;
     }
+    table->count++;
 
-    entry->key = key;
-    entry->val = val;
-    return is_new_key;
+    table->ctrl[index] = HASH_CTRL(key->hash);
+    table->keys[index] = key;
+    table->vals[index] = val;
+    return true;
 }
 
 
@@ -103,10 +130,9 @@ void Table_AddAll(const Table_t* src, Table_t* dst)
 {
     for (size_t i = 0; i < src->capacity; i++)
     {
-        const Entry_t* entry = &src->entries[i];
-        if (NULL != entry->key)
+        if (NULL != src->keys[i])
         {
-            Table_Set(dst, entry->key, entry->val);
+            Table_Set(dst, src->keys[i], src->vals[i]);
         }
     }
 }
@@ -120,25 +146,27 @@ ObjString_t* Table_FindStr(Table_t* table, const char* cstr, int len, uint32_t h
         return NULL;
     }
 
-    uint32_t index = hash & (table->capacity - 1);
-    while (true)
+    const size_t group_mask = table->capacity / TABLE_GROUP_WIDTH - 1;
+    size_t group = HASH_GROUP(hash) & group_mask;
+    for (size_t step = 1; ; step++)
     {
-        Entry_t* entry = &table->entries[index];
-        if (entry->key == NULL)
+        const uint8_t* ctrl = &table->ctrl[group * TABLE_GROUP_WIDTH];
+        for (uint32_t match = group_match(ctrl, HASH_CTRL(hash)); match; match &= match - 1)
         {
-            if (IS_NIL(entry->val)) /* stops if encountered an empty slot */
-                return NULL;
+            ObjString_t* key = table->keys[group * TABLE_GROUP_WIDTH + __builtin_ctz(match)];
+            if ((key->len == len)
+                && (key->hash == hash)
+                && (memcmp(key->cstr, cstr, len) == 0))
+            {
+                return key;
+            }
         }
-        else if ((entry->key->len == len)
-                && (entry->key->hash == hash)
-                && (memcmp(entry->key->cstr, cstr, len) == 0))
+
+        if (group_match(ctrl, TABLE_CTRL_EMPTY)) /* stops at the first group with an empty slot */
         {
-            /* key found */
-            return entry->key;
+            return NULL;
         }
-
-        index += 1;
-        index &= table->capacity - 1;
+        group = (group + step) & group_mask;
     }
 }
 
@@ -148,9 +176,11 @@ void Table_Mark(Table_t* table)
 {
     for (size_t i = 0; i < table->capacity; i++)
     {
-        Entry_t* entry = &table->entries[i];
-        GC_MarkObj(table->vm, (Obj_t*)entry->key);
-        GC_MarkVal(table->vm, entry->val);
+        if (NULL != table->keys[i])
+        {
+            GC_MarkObj(table->vm, (Obj_t*)table->keys[i]);
+            GC_MarkVal(table->vm, table->vals[i]);
+        }
     }
 }
 
@@ -158,63 +188,175 @@ void Table_RemoveWhite(Table_t* table)
 {
     for (size_t i = 0; i < table->capacity; i++)
     {
-        Entry_t* entry = &table->entries[i];
-        if (NULL != entry->key && !entry->key->obj.is_marked)
+        if (NULL != table->keys[i] && !GC_IsMarked(&table->keys[i]->obj))
         {
-            Table_Delete(table, entry->key);
+            remove_slot(table, i);
         }
     }
 }
 
 
+TableStats_t Table_Stats(const Table_t* table)
+{
+    TableStats_t stats = {
+        .count = table->count,
+        .deleted = table->deleted,
+        .capacity = table->capacity,
+        .max_probe = 0,
+        .avg_probe = 0,
+    };
+
+    size_t total = 0;
+    for (size_t i = 0; i < table->capacity; i++)
+    {
+        if (NULL == table->keys[i])
+        {
+            continue;
+        }
+
+        size_t len = probe_length(table, i);
+        total += len;
+        if (len > stats.max_probe)
+        {
+            stats.max_probe = len;
+        }
+    }
+
+    if (0 != table->count)
+    {
+        stats.avg_probe = (double)total / table->count;
+    }
+    return stats;
+}
+
+
 
 
 
 
 
-ObjString_t* Table_FindStrs(Table_t* table, 
-        int substr_count, const ObjString_t* substr[], 
-        uint32_t hash, int total_len)
+void Map_Init(Map_t* map, VM_t* vm)
 {
-    if (table->count == 0)
+    map->count = 0;
+    map->deleted = 0;
+    map->capacity = 0;
+    map->keys = NULL;
+    map->vals = NULL;
+    map->ctrl = NULL;
+    map->moved = false;
+    map->vm = vm;
+}
+
+
+void Map_Free(Map_t* map)
+{
+    FREE_ARRAY(map->vm, char, map->keys, map_bytes(map->capacity));
+    Map_Init(map, map->vm);
+}
+
+
+bool Map_Get(Map_t* map, Value_t key, Value_t* val_out)
+{
+    if (map->count == 0)
     {
-        return NULL;
+        return false;
+    }
+    if (map->moved)
+    {
+        map_rehash_in_place(map);
     }
 
-    uint32_t index = hash & (table->capacity - 1);
-    while (true)
+    size_t index;
+    if (!map_find(map, key, hash_key(map->vm, key), &index))
     {
-        Entry_t* entry = &table->entries[index];
-        if (entry->key == NULL)
-        {
-            if (IS_NIL(entry->val)) /* stops if encountered an empty slot */
-                return NULL;
-        }
-        else if (entry->key->len == total_len && entry->key->hash == hash) 
-        {
-            const char* key_substr = entry->key->cstr;
-            for (int i = 0; i < substr_count; i++)
-            {
-                if (memcmp(key_substr, substr[i]->cstr, substr[i]->len) != 0)
-                {   /* substr not equal */
-                    goto find_next;
-                }
-                key_substr += substr[i]->len;
+        return false;
+    }
+    *val_out = map->vals[index];
+    return true;
+}
 
-            }
-            return entry->key;
-        }
-find_next:
 
+bool Map_Set(Map_t* map, Value_t key, Value_t val)
+{
+    if (map->moved)
+    {
+        map_rehash_in_place(map);
+    }
 
-        index += 1;
-        index &= table->capacity - 1;
+    const uint32_t hash = hash_key(map->vm, key);
+    size_t index;
+    if (map->count != 0 && map_find(map, key, hash, &index))
+    {
+        map->vals[index] = val;
+        return false;
     }
 
+    size_t capacity = resized_capacity(map->count, map->deleted, map->capacity);
+    if (0 != capacity)
+    {
+        map_adjust_capacity(map, capacity);
+    }
+
+    index = find_free_slot(map->ctrl, map->capacity, hash);
+    if (map->ctrl[index] == TABLE_CTRL_DELETED)
+    {
+        map->deleted--;
+    }
+    map->count++;
+
+    map->ctrl[index] = HASH_CTRL(hash);
+    map->keys[index] = key;
+    map->vals[index] = val;
+    return true;
 }
 
 
+bool Map_Delete(Map_t* map, Value_t key)
+{
+    if (map->count == 0)
+    {
+        return false;
+    }
+    if (map->moved)
+    {
+        map_rehash_in_place(map);
+    }
 
+    size_t index;
+    if (!map_find(map, key, hash_key(map->vm, key), &index))
+    {
+        return false;
+    }
+
+    map->deleted += clear_slot(map->ctrl, index);
+    map->count--;
+    return true;
+}
+
+
+void Map_Mark(Map_t* map)
+{
+    for (size_t i = 0; i < map->capacity; i++)
+    {
+        if (Map_IsFull(map, i))
+        {
+            GC_MarkVal(map->vm, map->keys[i]);
+            GC_MarkVal(map->vm, map->vals[i]);
+        }
+    }
+}
+
+
+uint32_t Map_HashKey(VM_t* vm, Value_t key)
+{
+    return hash_key(vm, key);
+}
+
+
+bool Map_KeyEqual(Value_t a, Value_t b)
+{
+    return key_equal(a, b);
+}
 
 
 
@@ -227,74 +369,372 @@ find_next:
 
 static void adjust_capacity(Table_t* table, size_t newcap)
 {
-    Entry_t* new_entries = ALLOCATE(table->vm, Entry_t, newcap);
+    ObjString_t** new_keys = ALLOCATE(table->vm, char, table_bytes(newcap));
+    Value_t* new_vals = (Value_t*)(new_keys + newcap);
+    uint8_t* new_ctrl = (uint8_t*)(new_vals + newcap);
     for (size_t i = 0; i < newcap; i++)
     {
-        new_entries[i].key = NULL;
-        new_entries[i].val = NIL_VAL();
+        new_keys[i] = NULL;
     }
+    memset(new_ctrl, TABLE_CTRL_EMPTY, newcap);
 
-    /* rebuild hash table with new capacity, skip tombstones and empty buckets */
+    /* rebuild hash table with new capacity, skip deleted and empty slots */
     table->count = 0;
+    table->deleted = 0;
     for (size_t i = 0; i < table->capacity; i++)
     {
-        Entry_t* entry = &table->entries[i];
-        if (NULL == entry->key)
+        if (NULL == table->keys[i])
         {
             continue;
         }
 
-        Entry_t* dest = find_entry(new_entries, newcap, entry->key);
-        dest->key = entry->key;
-        dest->val = entry->val;
+        const uint32_t hash = table->keys[i]->hash;
+        size_t dest = find_free_slot(new_ctrl, newcap, hash);
+        new_ctrl[dest] = HASH_CTRL(hash);
+        new_keys[dest] = table->keys[i];
+        new_vals[dest] = table->vals[i];
         table->count++;
     }
 
 
-    FREE_ARRAY(table->vm, Entry_t, table->entries, table->capacity);
+    FREE_ARRAY(table->vm, char, table->keys, table_bytes(table->capacity));
 
-    table->entries = new_entries;
+    table->keys = new_keys;
+    table->vals = new_vals;
+    table->ctrl = new_ctrl;
     table->capacity = newcap;
 }
 
 
-static Entry_t* find_entry(Entry_t* entries, size_t num_entries, const ObjString_t* key)
+static inline bool find_key(const Table_t* table, const ObjString_t* key, size_t* index_out)
+{
+    const size_t group_mask = table->capacity / TABLE_GROUP_WIDTH - 1;
+    const size_t group = HASH_GROUP(key->hash) & group_mask;
+    const uint8_t* ctrl = &table->ctrl[group * TABLE_GROUP_WIDTH];
+    for (uint32_t match = group_match(ctrl, HASH_CTRL(key->hash)); match; match &= match - 1)
+    {
+        const size_t index = group * TABLE_GROUP_WIDTH + __builtin_ctz(match);
+        if (table->keys[index] == key)
+            /* addr cmp is ok because keys are interned, 
+             * so there are no duplicate strs at difference addrs */
+        {
+            *index_out = index;
+            return true;
+        }
+    }
+
+    /* the key is almost always in its first group, the rest of the probe stays out of the callers */
+    return !group_match(ctrl, TABLE_CTRL_EMPTY) 
+        && find_key_probe(table, key, group, index_out);
+}
+
+
+/* goes on with the probe from the group after the first one */
+CLOX_NOINLINE static bool find_key_probe(const Table_t* table, const ObjString_t* key, size_t group, size_t* index_out)
 {
-    uint32_t index = key->hash & (num_entries - 1);
-    Entry_t* tombstone = NULL;
+    const size_t group_mask = table->capacity / TABLE_GROUP_WIDTH - 1;
 
-    /* this is not an infinite loop thanks to the load factor */
-    while (true)
+    /* this is not an infinite loop thanks to the load factor, 
+     * the triangular steps visit every group when their count is a power of 2 */
+    for (size_t step = 1; ; step++)
     {
-        Entry_t* entry = &entries[index];
-        if (entry->key == NULL)
+        group = (group + step) & group_mask;
+        const uint8_t* ctrl = &table->ctrl[group * TABLE_GROUP_WIDTH];
+        for (uint32_t match = group_match(ctrl, HASH_CTRL(key->hash)); match; match &= match - 1)
         {
-            if (IS_NIL(entry->val)) /* deleted */
-                return tombstone != NULL ? tombstone : entry;
-            else if (tombstone == NULL) /* tombstone, and not encountered tombstone b4 */
-                tombstone = entry;
+            const size_t index = group * TABLE_GROUP_WIDTH + __builtin_ctz(match);
+            if (table->keys[index] == key)
+            {
+                *index_out = index;
+                return true;
+            }
         }
-        else if (ObjStr_Equal(entry->key, key)) 
-            /* addr cmp is ok because strings are interned, 
-             * so there are no duplicate strs at difference addrs */
+
+        if (group_match(ctrl, TABLE_CTRL_EMPTY))
+        {
+            return false;
+        }
+    }
+}
+
+
+/* the first empty or deleted slot on the key's probe sequence */
+static size_t find_free_slot(const uint8_t* ctrl, size_t capacity, uint32_t hash)
+{
+    const size_t group_mask = capacity / TABLE_GROUP_WIDTH - 1;
+    size_t group = HASH_GROUP(hash) & group_mask;
+    for (size_t step = 1; ; step++)
+    {
+        uint32_t match = group_match_free(&ctrl[group * TABLE_GROUP_WIDTH]);
+        if (match)
+        {
+            return group * TABLE_GROUP_WIDTH + __builtin_ctz(match);
+        }
+        group = (group + step) & group_mask;
+    }
+}
+
+
+/* the capacity a table is rehashed to before a key goes in, 0 if it's fine as it is */
+static size_t resized_capacity(size_t count, size_t deleted, size_t capacity)
+{
+    count += 1;
+    if (count + deleted > capacity * TABLE_MAX_LOAD)
+    {
+        /* the deleted slots are taking the room, getting them back is enough */
+        if (count <= capacity * TABLE_MAX_LOAD / 2)
+            return capacity;
+        return capacity < TABLE_GROUP_WIDTH ? TABLE_GROUP_WIDTH : capacity * 2;
+    }
+
+    if (capacity > TABLE_GROUP_WIDTH && count < capacity * TABLE_MIN_LOAD)
+    {
+        size_t newcap = capacity;
+        while (newcap > TABLE_GROUP_WIDTH && count <= newcap / 2 * TABLE_MAX_LOAD / 2)
+            newcap /= 2;
+        return newcap;
+    }
+    return 0;
+}
+
+
+/* 
+ *  the probes go on past a group only when it has no empty slot, 
+ *  so a slot in a group that has one can be emptied without breaking them
+ *  \returns true if the slot had to be marked as deleted instead
+ */
+static bool clear_slot(uint8_t* ctrl, size_t index)
+{
+    const bool group_full = !group_match(&ctrl[index - index % TABLE_GROUP_WIDTH], TABLE_CTRL_EMPTY);
+    ctrl[index] = group_full ? TABLE_CTRL_DELETED : TABLE_CTRL_EMPTY;
+    return group_full;
+}
+
+
+static void remove_slot(Table_t* table, size_t index)
+{
+    table->deleted += clear_slot(table->ctrl, index);
+    table->keys[index] = NULL;
+    table->count--;
+}
+
+
+/* the number of groups that a lookup of the key in the slot looks at */
+static size_t probe_length(const Table_t* table, size_t index)
+{
+    const size_t group_mask = table->capacity / TABLE_GROUP_WIDTH - 1;
+    size_t group = HASH_GROUP(table->keys[index]->hash) & group_mask;
+    size_t len = 1;
+    for (size_t step = 1; group != index / TABLE_GROUP_WIDTH; step++, len++)
+    {
+        group = (group + step) & group_mask;
+    }
+    return len;
+}
+
+
+static void map_adjust_capacity(Map_t* map, size_t newcap)
+{
+    Value_t* new_keys = ALLOCATE(map->vm, char, map_bytes(newcap));
+    Value_t* new_vals = new_keys + newcap;
+    uint8_t* new_ctrl = (uint8_t*)(new_vals + newcap);
+    memset(new_ctrl, TABLE_CTRL_EMPTY, newcap);
+
+    map->count = 0;
+    map->deleted = 0;
+    for (size_t i = 0; i < map->capacity; i++)
+    {
+        if (!Map_IsFull(map, i))
+        {
+            continue;
+        }
+
+        const uint32_t hash = hash_key(map->vm, map->keys[i]);
+        size_t dest = find_free_slot(new_ctrl, newcap, hash);
+        new_ctrl[dest] = HASH_CTRL(hash);
+        new_keys[dest] = map->keys[i];
+        new_vals[dest] = map->vals[i];
+        map->count++;
+    }
+
+    FREE_ARRAY(map->vm, char, map->keys, map_bytes(map->capacity));
+
+    map->keys = new_keys;
+    map->vals = new_vals;
+    map->ctrl = new_ctrl;
+    map->capacity = newcap;
+}
+
+
+/* 
+ *  puts every key back where its new hash wants it without allocating, so that a lookup never collects:
+ *  the full slots are marked deleted and placed one by one, 
+ *  a key that has to go to a slot that is still marked deleted swaps places with the key in it
+ */
+static void map_rehash_in_place(Map_t* map)
+{
+    for (size_t i = 0; i < map->capacity; i++)
+    {
+        map->ctrl[i] = Map_IsFull(map, i) ? TABLE_CTRL_DELETED : TABLE_CTRL_EMPTY;
+    }
+
+    for (size_t i = 0; i < map->capacity; i++)
+    {
+        if (map->ctrl[i] != TABLE_CTRL_DELETED)
+        {
+            continue;
+        }
+
+        const uint32_t hash = hash_key(map->vm, map->keys[i]);
+        size_t dest = find_free_slot(map->ctrl, map->capacity, hash);
+
+        /* the slot's own group comes first on its probe sequence among the ones with room */
+        if (dest / TABLE_GROUP_WIDTH == i / TABLE_GROUP_WIDTH)
         {
-            return entry;
+            map->ctrl[i] = HASH_CTRL(hash);
+            continue;
         }
 
-        index += 1;
-        index &= num_entries - 1;
+        Value_t key = map->keys[i];
+        Value_t val = map->vals[i];
+        if (map->ctrl[dest] == TABLE_CTRL_EMPTY)
+        {
+            map->ctrl[i] = TABLE_CTRL_EMPTY;
+        }
+        else
+        {
+            map->keys[i] = map->keys[dest];
+            map->vals[i] = map->vals[dest];
+            i--; /* the key swapped in still needs a place */
+        }
+        map->ctrl[dest] = HASH_CTRL(hash);
+        map->keys[dest] = key;
+        map->vals[dest] = val;
     }
+
+    map->deleted = 0;
+    map->moved = false;
 }
 
 
+static bool map_find(const Map_t* map, Value_t key, uint32_t hash, size_t* index_out)
+{
+    const size_t group_mask = map->capacity / TABLE_GROUP_WIDTH - 1;
+    size_t group = HASH_GROUP(hash) & group_mask;
+    for (size_t step = 1; ; step++)
+    {
+        const uint8_t* ctrl = &map->ctrl[group * TABLE_GROUP_WIDTH];
+        for (uint32_t match = group_match(ctrl, HASH_CTRL(hash)); match; match &= match - 1)
+        {
+            const size_t index = group * TABLE_GROUP_WIDTH + __builtin_ctz(match);
+            if (key_equal(map->keys[index], key))
+            {
+                *index_out = index;
+                return true;
+            }
+        }
 
-static inline bool is_tombstone(const Entry_t* entry)
+        if (group_match(ctrl, TABLE_CTRL_EMPTY))
+        {
+            return false;
+        }
+        group = (group + step) & group_mask;
+    }
+}
+
+
+/* numbers by their value, strings and slices by their content, and the rest by their bits */
+static uint32_t hash_key(VM_t* vm, Value_t key)
 {
-    return entry->key == NULL && IS_BOOL(entry->val) && AS_BOOL(entry->val);
+    uint64_t bits;
+    if (IS_NUMBER(key))
+    {
+        double number = AS_NUMBER(key);
+        memcpy(&bits, &number, sizeof bits);
+        if (0 == (bits << 1)) /* -0 is the same key as 0 */
+            bits = 0;
+    }
+    else if (IS_STRING(key) || IS_SLICE(key))
+    {
+        return ObjStr_Hash(vm, AS_OBJ(key));
+    }
+    else if (IS_OBJ(key))
+    {
+        bits = (uint64_t)(uintptr_t)AS_OBJ(key);
+    }
+    else 
+    {
+        bits = IS_BOOL(key) ? 2 + AS_BOOL(key) : 1;
+    }
+
+    /* murmur3's finalizer, the same as the strings' hash ends with */
+    bits ^= vm->hash_seed;
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdull;
+    bits ^= bits >> 33;
+    bits *= 0xc4ceb9fe1a85ec53ull;
+    bits ^= bits >> 33;
+    return (uint32_t)bits;
 }
 
 
-static inline bool is_empty(const Entry_t* entry)
+/* the numbers are equal exactly here, not within FLT_EPSILON like Value_Equal has them */
+static inline bool key_equal(Value_t a, Value_t b)
 {
-    return entry->key == NULL && IS_NIL(entry->val);
+    if (ARE_NUMBERS(a, b))
+        return AS_NUMBER(a) == AS_NUMBER(b);
+    return Value_Equal(a, b);
 }
+
+
+static inline size_t map_bytes(size_t capacity)
+{
+    return capacity * (2 * sizeof(Value_t) + sizeof(uint8_t));
+}
+
+
+static inline size_t table_bytes(size_t capacity)
+{
+    return capacity * (sizeof(ObjString_t*) + sizeof(Value_t) + sizeof(uint8_t));
+}
+
+
+
+/* bit i of the masks is set when ctrl byte i of the group matches */
+#ifdef __SSE2__
+
+static inline uint32_t group_match(const uint8_t* group, uint8_t ctrl)
+{
+    __m128i bytes = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)ctrl)));
+}
+
+/* empty and deleted are the only ctrl bytes with the top bit set */
+static inline uint32_t group_match_free(const uint8_t* group)
+{
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+}
+
+#else /* !__SSE2__ */
+
+static inline uint32_t group_match(const uint8_t* group, uint8_t ctrl)
+{
+    uint32_t match = 0;
+    for (int i = 0; i < TABLE_GROUP_WIDTH; i++)
+    {
+        match |= (uint32_t)(group[i] == ctrl) << i;
+    }
+    return match;
+}
+
+static inline uint32_t group_match_free(const uint8_t* group)
+{
+    uint32_t match = 0;
+    for (int i = 0; i < TABLE_GROUP_WIDTH; i++)
+    {
+        match |= (uint32_t)(group[i] >> 7) << i;
+    }
+    return match;
+}
+
+#endif /* __SSE2__ */
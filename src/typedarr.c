@@ -0,0 +1,379 @@
+#include <stdint.h>
+
+#include "include/common.h"
+#include "include/object.h"
+#include "include/typedarr.h"
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif /* __SSE2__ */
+
+/* the avx2 kernels are compiled for it whatever -m flags are given, and only run if the cpu has it */
+#if defined(__SSE2__) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define TYPEDARR_AVX2
+#  include <immintrin.h>
+#  define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+
+typedef struct F64Kernels_t
+{
+    double (*sum)(const double* a, int n);
+    double (*dot)(const double* a, const double* b, int n);
+    double (*min)(const double* a, int n);
+    double (*max)(const double* a, int n);
+    void (*scale)(double* a, int n, double factor);
+    void (*add)(double* a, const double* b, int n);
+} F64Kernels_t;
+
+static const F64Kernels_t* f64_kernels(void);
+
+static double f64_sum(const double* a, int n);
+static double f64_dot(const double* a, const double* b, int n);
+static double f64_min_from(const double* a, int n, double min);
+static double f64_max_from(const double* a, int n, double max);
+static double f64_min(const double* a, int n);
+static double f64_max(const double* a, int n);
+static void f64_scale(double* a, int n, double factor);
+static void f64_add(double* a, const double* b, int n);
+
+
+
+
+double TypedArr_Sum(const ObjTypedArr_t* arr)
+{
+    if (TYPED_F64 == arr->kind)
+        return f64_kernels()->sum(TYPED_F64(arr), arr->len);
+
+    const int32_t* a = TYPED_I32(arr);
+    int64_t sum = 0;
+    for (int i = 0; i < arr->len; i++)
+        sum += a[i];
+    return (double)sum;
+}
+
+
+double TypedArr_Dot(const ObjTypedArr_t* a, const ObjTypedArr_t* b)
+{
+    if (TYPED_F64 == a->kind)
+        return f64_kernels()->dot(TYPED_F64(a), TYPED_F64(b), a->len);
+
+    const int32_t* x = TYPED_I32(a);
+    const int32_t* y = TYPED_I32(b);
+    double dot = 0;
+    for (int i = 0; i < a->len; i++)
+        dot += (double)x[i] * y[i];
+    return dot;
+}
+
+
+double TypedArr_Min(const ObjTypedArr_t* arr)
+{
+    if (TYPED_F64 == arr->kind)
+        return f64_kernels()->min(TYPED_F64(arr), arr->len);
+
+    const int32_t* a = TYPED_I32(arr);
+    int32_t min = a[0];
+    for (int i = 1; i < arr->len; i++)
+        min = a[i] < min ? a[i] : min;
+    return min;
+}
+
+
+double TypedArr_Max(const ObjTypedArr_t* arr)
+{
+    if (TYPED_F64 == arr->kind)
+        return f64_kernels()->max(TYPED_F64(arr), arr->len);
+
+    const int32_t* a = TYPED_I32(arr);
+    int32_t max = a[0];
+    for (int i = 1; i < arr->len; i++)
+        max = a[i] > max ? a[i] : max;
+    return max;
+}
+
+
+void TypedArr_Scale(ObjTypedArr_t* arr, double factor)
+{
+    if (TYPED_F64 == arr->kind)
+    {
+        f64_kernels()->scale(TYPED_F64(arr), arr->len, factor);
+        return;
+    }
+
+    int32_t* a = TYPED_I32(arr);
+    for (int i = 0; i < arr->len; i++)
+        a[i] = TypedArr_ToI32(a[i] * factor);
+}
+
+
+void TypedArr_Add(ObjTypedArr_t* a, const ObjTypedArr_t* b)
+{
+    if (TYPED_F64 == a->kind)
+    {
+        f64_kernels()->add(TYPED_F64(a), TYPED_F64(b), a->len);
+        return;
+    }
+
+    /* wraps around instead of overflowing */
+    int32_t* x = TYPED_I32(a);
+    const int32_t* y = TYPED_I32(b);
+    for (int i = 0; i < a->len; i++)
+        x[i] = (int32_t)((uint32_t)x[i] + (uint32_t)y[i]);
+}
+
+
+
+
+
+
+
+
+/* the scalar kernels, for the cpus without sse2 and for the elements left after the last vector */
+static double f64_sum(const double* a, int n)
+{
+    double sum = 0;
+    for (int i = 0; i < n; i++)
+        sum += a[i];
+    return sum;
+}
+
+static double f64_dot(const double* a, const double* b, int n)
+{
+    double dot = 0;
+    for (int i = 0; i < n; i++)
+        dot += a[i] * b[i];
+    return dot;
+}
+
+static double f64_min_from(const double* a, int n, double min)
+{
+    for (int i = 0; i < n; i++)
+        min = a[i] < min ? a[i] : min;
+    return min;
+}
+
+static double f64_max_from(const double* a, int n, double max)
+{
+    for (int i = 0; i < n; i++)
+        max = a[i] > max ? a[i] : max;
+    return max;
+}
+
+static double f64_min(const double* a, int n)
+{
+    return f64_min_from(a + 1, n - 1, a[0]);
+}
+
+static double f64_max(const double* a, int n)
+{
+    return f64_max_from(a + 1, n - 1, a[0]);
+}
+
+static void f64_scale(double* a, int n, double factor)
+{
+    for (int i = 0; i < n; i++)
+        a[i] *= factor;
+}
+
+static void f64_add(double* a, const double* b, int n)
+{
+    for (int i = 0; i < n; i++)
+        a[i] += b[i];
+}
+
+
+
+
+#ifdef __SSE2__
+
+static inline double hsum_sse2(__m128d v)
+{
+    return _mm_cvtsd_f64(v) + _mm_cvtsd_f64(_mm_unpackhi_pd(v, v));
+}
+
+/* 2 accumulators, so that an add does not wait on the one before it */
+static double f64_sum_sse2(const double* a, int n)
+{
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(a + i));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(a + i + 2));
+    }
+    return hsum_sse2(_mm_add_pd(acc0, acc1)) + f64_sum(a + i, n - i);
+}
+
+static double f64_dot_sse2(const double* a, const double* b, int n)
+{
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    return hsum_sse2(_mm_add_pd(acc0, acc1)) + f64_dot(a + i, b + i, n - i);
+}
+
+static double f64_min_sse2(const double* a, int n)
+{
+    if (n < 2)
+        return f64_min(a, n);
+
+    __m128d min = _mm_loadu_pd(a);
+    int i = 2;
+    for (; i + 2 <= n; i += 2)
+        min = _mm_min_pd(min, _mm_loadu_pd(a + i));
+    min = _mm_min_sd(min, _mm_unpackhi_pd(min, min));
+    return f64_min_from(a + i, n - i, _mm_cvtsd_f64(min));
+}
+
+static double f64_max_sse2(const double* a, int n)
+{
+    if (n < 2)
+        return f64_max(a, n);
+
+    __m128d max = _mm_loadu_pd(a);
+    int i = 2;
+    for (; i + 2 <= n; i += 2)
+        max = _mm_max_pd(max, _mm_loadu_pd(a + i));
+    max = _mm_max_sd(max, _mm_unpackhi_pd(max, max));
+    return f64_max_from(a + i, n - i, _mm_cvtsd_f64(max));
+}
+
+static void f64_scale_sse2(double* a, int n, double factor)
+{
+    __m128d by = _mm_set1_pd(factor);
+    int i = 0;
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(a + i, _mm_mul_pd(_mm_loadu_pd(a + i), by));
+    f64_scale(a + i, n - i, factor);
+}
+
+static void f64_add_sse2(double* a, const double* b, int n)
+{
+    int i = 0;
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(a + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    f64_add(a + i, b + i, n - i);
+}
+
+#endif /* __SSE2__ */
+
+
+
+
+#ifdef TYPEDARR_AVX2
+
+TARGET_AVX2 static inline double hsum_avx2(__m256d v)
+{
+    return hsum_sse2(_mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1)));
+}
+
+TARGET_AVX2 static double f64_sum_avx2(const double* a, int n)
+{
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(a + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(a + i + 4));
+    }
+    return hsum_avx2(_mm256_add_pd(acc0, acc1)) + f64_sum(a + i, n - i);
+}
+
+TARGET_AVX2 static double f64_dot_avx2(const double* a, const double* b, int n)
+{
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+    }
+    return hsum_avx2(_mm256_add_pd(acc0, acc1)) + f64_dot(a + i, b + i, n - i);
+}
+
+TARGET_AVX2 static double f64_min_avx2(const double* a, int n)
+{
+    if (n < 4)
+        return f64_min(a, n);
+
+    __m256d min4 = _mm256_loadu_pd(a);
+    int i = 4;
+    for (; i + 4 <= n; i += 4)
+        min4 = _mm256_min_pd(min4, _mm256_loadu_pd(a + i));
+    __m128d min = _mm_min_pd(_mm256_castpd256_pd128(min4), _mm256_extractf128_pd(min4, 1));
+    min = _mm_min_sd(min, _mm_unpackhi_pd(min, min));
+    return f64_min_from(a + i, n - i, _mm_cvtsd_f64(min));
+}
+
+TARGET_AVX2 static double f64_max_avx2(const double* a, int n)
+{
+    if (n < 4)
+        return f64_max(a, n);
+
+    __m256d max4 = _mm256_loadu_pd(a);
+    int i = 4;
+    for (; i + 4 <= n; i += 4)
+        max4 = _mm256_max_pd(max4, _mm256_loadu_pd(a + i));
+    __m128d max = _mm_max_pd(_mm256_castpd256_pd128(max4), _mm256_extractf128_pd(max4, 1));
+    max = _mm_max_sd(max, _mm_unpackhi_pd(max, max));
+    return f64_max_from(a + i, n - i, _mm_cvtsd_f64(max));
+}
+
+TARGET_AVX2 static void f64_scale_avx2(double* a, int n, double factor)
+{
+    __m256d by = _mm256_set1_pd(factor);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(a + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), by));
+    f64_scale(a + i, n - i, factor);
+}
+
+TARGET_AVX2 static void f64_add_avx2(double* a, const double* b, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(a + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    f64_add(a + i, b + i, n - i);
+}
+
+#endif /* TYPEDARR_AVX2 */
+
+
+
+
+static const F64Kernels_t* f64_kernels(void)
+{
+    static const F64Kernels_t* kernels = NULL;
+    if (NULL != kernels)
+        return kernels;
+
+#if defined(TYPEDARR_AVX2)
+    static const F64Kernels_t avx2 = {
+        f64_sum_avx2, f64_dot_avx2, f64_min_avx2, f64_max_avx2, f64_scale_avx2, f64_add_avx2,
+    };
+    static const F64Kernels_t sse2 = {
+        f64_sum_sse2, f64_dot_sse2, f64_min_sse2, f64_max_sse2, f64_scale_sse2, f64_add_sse2,
+    };
+    kernels = __builtin_cpu_supports("avx2") ? &avx2 : &sse2;
+#elif defined(__SSE2__)
+    static const F64Kernels_t sse2 = {
+        f64_sum_sse2, f64_dot_sse2, f64_min_sse2, f64_max_sse2, f64_scale_sse2, f64_add_sse2,
+    };
+    kernels = &sse2;
+#else
+    static const F64Kernels_t scalar = {
+        f64_sum, f64_dot, f64_min, f64_max, f64_scale, f64_add,
+    };
+    kernels = &scalar;
+#endif /* TYPEDARR_AVX2 */
+    return kernels;
+}
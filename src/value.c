@@ -11,6 +11,9 @@
 
 
 
+static inline bool num_equal(double a, double b);
+static bool str_equal(Value_t a, Value_t b);
+
 
 void ValArr_Init(ValueArr_t* valarr, VM_t* vm)
 {
@@ -43,8 +46,14 @@ void ValArr_Write(ValueArr_t* valarr, Value_t val)
 
 void ValArr_Reserve(ValueArr_t* valarr, size_t extra)
 {
+    if (valarr->size + extra <= valarr->capacity)
+        return;
+
+    /* grows geometrically, so that reserving a few more at a time does not reallocate every time */
     const size_t oldcap = valarr->capacity;
-    valarr->capacity += extra;
+    valarr->capacity = GROW_CAPACITY(valarr->capacity);
+    if (valarr->capacity < valarr->size + extra)
+        valarr->capacity = valarr->size + extra;
     valarr->vals = GROW_ARRAY(valarr->vm, Value_t,
         valarr->vals, oldcap, valarr->capacity
     );
@@ -83,7 +92,8 @@ void Value_Print(FILE* fout, Value_t val)
 	{
 	case VAL_BOOL:		fprintf(fout, AS_BOOL(val) ? "true" : "false"); break;
 	case VAL_NIL:		fprintf(fout, "nil"); break;
-	case VAL_NUMBER:	fprintf(fout, "%g", AS_NUMBER(val)); break;
+	case VAL_NUMBER:
+	case VAL_INT:		fprintf(fout, "%g", AS_NUMBER(val)); break;
 	case VAL_OBJ:		Obj_Print(fout, val); break;
     default: fprintf(fout, "%d", VALTYPE(val));break;
 	}
@@ -94,13 +104,21 @@ bool Value_Equal(Value_t a, Value_t b)
 {
 #ifdef NAN_BOXING
 
-    if (IS_NUMBER(a) && IS_NUMBER(b))
-		return (AS_NUMBER(a) - FLT_EPSILON <= AS_NUMBER(b))
-			&& (AS_NUMBER(b) <= AS_NUMBER(a) + FLT_EPSILON);
-    return a == b;
+    /* every other kind of value is equal when its bits are, that includes 2 ints */
+    if (!(IS_DOUBLE(a) | IS_DOUBLE(b)))
+        return a == b || str_equal(a, b);
+    return ARE_NUMBERS(a, b) && num_equal(AS_NUMBER(a), AS_NUMBER(b));
 
 #else /* !NAN_BOXING */
 
+	if (ARE_INTS(a, b))
+	{
+		return AS_INT(a) == AS_INT(b);
+	}
+	if (ARE_NUMBERS(a, b))
+	{
+		return num_equal(AS_NUMBER(a), AS_NUMBER(b));
+	}
 	if (a.type != b.type)
 	{
 		return false;
@@ -110,12 +128,36 @@ bool Value_Equal(Value_t a, Value_t b)
 	{
 	case VAL_BOOL:		return AS_BOOL(a) == AS_BOOL(b);
 	case VAL_NIL:		return true;
-	case VAL_NUMBER:	
-		return (AS_NUMBER(a) - FLT_EPSILON <= AS_NUMBER(b))
-			&& (AS_NUMBER(b) <= AS_NUMBER(a) + FLT_EPSILON);
-	case VAL_OBJ:       return AS_OBJ(a) == AS_OBJ(b);
+	case VAL_NUMBER:
+	case VAL_INT:		break; /* handled above */
+	case VAL_OBJ:       return AS_OBJ(a) == AS_OBJ(b) || str_equal(a, b);
 	}
     return false;
 #endif /* NAN_BOXING*/
 }
 
+
+
+
+/* the exact comparison is the common case, numbers within FLT_EPSILON of each other are still equal */
+static inline bool num_equal(double a, double b)
+{
+    return a == b
+        || ((a - FLT_EPSILON <= b) && (b <= a + FLT_EPSILON));
+}
+
+
+/* strings that are not interned, and slices, are equal by their content */
+CLOX_NOINLINE static bool str_equal(Value_t a, Value_t b)
+{
+    if (IS_STRING(a) && IS_STRING(b))
+        return ObjStr_Equal(AS_STR(a), AS_STR(b));
+    if (!(IS_STRING(a) || IS_SLICE(a)) || !(IS_STRING(b) || IS_SLICE(b)))
+        return false;
+
+    StrView_t view_a = ObjStr_View(AS_OBJ(a));
+    StrView_t view_b = ObjStr_View(AS_OBJ(b));
+    return view_a.len == view_b.len 
+        && 0 == memcmp(view_a.chars, view_b.chars, view_a.len);
+}
+
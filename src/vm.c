@@ -4,6 +4,9 @@
 #include <stdarg.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
+#include <stddef.h>
+#include <time.h>
 
 #include "include/common.h"
 #include "include/table.h"
@@ -13,17 +16,40 @@
 #include "include/object.h"
 #include "include/memory.h"
 #include "include/natives.h"
+#include "include/typedarr.h"
+#include "include/sort.h"
+#include "include/persistent.h"
 
 
 
 
 
 
-static InterpretResult_t run(VM_t* vm);
+/* what the array sort passes to its comparator calls */
+typedef struct SortCmp_t
+{
+    VM_t* vm;
+    Value_t cmp;
+    bool failed; /* the comparator ran into a runtime error */
+} SortCmp_t;
+
+/* what a persistent map's keys() passes to push_key */
+typedef struct KeyPusher_t
+{
+    VM_t* vm;
+    ObjArray_t* keys;
+} KeyPusher_t;
+
+
+static InterpretResult_t run(VM_t* vm, int base_frame);
 static void init_state(VM_t* vm, Allocator_t* alloc);
 static void stack_reset(VM_t* vm);
 static Value_t peek(const VM_t* vm, int offset);
 static bool is_falsey(const Value_t val);
+static bool is_strlike(const Value_t val);
+static void concat(VM_t* vm);
+static void flatten(VM_t* vm, int offset);
+static void unslice(VM_t* vm, int offset);
 
 static void runtime_error(VM_t* vm, const char* fmt, ...);
 static void debug_trace_execution(const VM_t* vm);
@@ -37,6 +63,7 @@ static bool call_value(VM_t* vm, Value_t callee, int argc);
 /* pushes a closure onto the call frame */
 static bool call(VM_t* vm, ObjClosure_t* closure, int argc);
 static bool call_native(VM_t* vm, ObjNativeFn_t* native, int argc);
+static bool call_from_c(VM_t* vm, int argc);
 
 
 static ObjUpval_t* capture_upval(VM_t* data, Value_t* bp);
@@ -45,11 +72,135 @@ static void close_upval(VM_t* vm, const Value_t* sp);
 
 static void define_method(VM_t* vm, ObjString_t* class_name);
 static bool bind_method(VM_t* vm, ObjClass_t* klass, ObjString_t* name);
-static bool invoke_method(VM_t* vm, const ObjString_t* method_name, int argc);
+static bool invoke_method(VM_t* vm, const ObjString_t* method_name, int argc, uint8_t* cache);
+static bool invoke_native_method(VM_t* vm, const ObjString_t* method_name, int argc, uint8_t* cache);
+static bool define_type_method(VM_t* vm, ObjType_t type, ObjString_t* name, NativeMethodFn_t fn, uint8_t arity);
 static bool invoke_class_method(VM_t* vm, ObjClass_t* klass, const ObjString_t* method_name, int argc);
 
-static Value_t* array_index(VM_t* vm, Value_t array, Value_t index);
-static bool array_method(VM_t* vm, Value_t array, const ObjString_t* name, int argc);
+static bool array_index(VM_t* vm, Value_t array, Value_t index, size_t* index_out);
+static size_t slice_bound(Value_t bound, size_t size);
+static bool sort_cmp_less(void* ctx, Value_t a, Value_t b);
+static void flatten_elems(VM_t* vm, ObjArray_t* array);
+static void map_get(VM_t* vm);
+static void map_set(VM_t* vm);
+static bool typed_index(VM_t* vm, const ObjTypedArr_t* arr, Value_t index, int* index_out);
+static bool typed_get(VM_t* vm);
+static bool typed_set(VM_t* vm);
+static bool pvec_index(VM_t* vm, const ObjPVec_t* vec, Value_t index, size_t* index_out);
+static bool pvec_get(VM_t* vm);
+static bool pmap_key(VM_t* vm, int offset);
+static bool pmap_get(VM_t* vm);
+
+static bool array_push(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool array_pop(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool array_size(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool array_slice(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool array_sort(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool array_concat(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool array_fill(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool array_index_of(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool array_reverse(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool array_insert(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool array_reserve(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool array_shrink_to_fit(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool map_has(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool map_delete(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool map_keys(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool map_size(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static ObjArray_t* map_key_array(VM_t* vm, const Map_t* map);
+static bool deque_push_front(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool deque_push_back(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool deque_pop_front(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool deque_pop_back(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool deque_front(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool deque_back(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool deque_size(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool pqueue_push(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool pqueue_pop(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool pqueue_peek(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool pqueue_size(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool set_add(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool set_has(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool set_delete(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool set_size(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool set_values(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool typed_size(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool pvec_set(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool pvec_push(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool pvec_pop(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool pvec_size(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool pvec_to_array(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool pmap_set(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool pmap_delete(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool pmap_has(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool pmap_size(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool pmap_keys(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static void push_key(void* ctx, Value_t key, Value_t val);
+static bool str_len(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool str_substr(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool str_char_at(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool str_index_of(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+static bool str_split(VM_t* vm, int argc, Value_t* args, Value_t* ret);
+
+/* the methods of the builtin types, defined by VM_Init */
+static const struct
+{
+    ObjType_t type;
+    const char* name;
+    NativeMethodFn_t fn;
+    uint8_t arity;
+} s_methods[] = 
+{
+    { OBJ_ARRAY,       "push",        array_push,          1 },
+    { OBJ_ARRAY,       "pop",         array_pop,           0 },
+    { OBJ_ARRAY,       "size",        array_size,          0 },
+    { OBJ_ARRAY,       "slice",       array_slice,         2 },
+    { OBJ_ARRAY,       "sort",        array_sort,          NATIVE_VARIADIC },
+    { OBJ_ARRAY,       "concat",      array_concat,        1 },
+    { OBJ_ARRAY,       "fill",        array_fill,          1 },
+    { OBJ_ARRAY,       "indexOf",     array_index_of,      1 },
+    { OBJ_ARRAY,       "reverse",     array_reverse,       0 },
+    { OBJ_ARRAY,       "insert",      array_insert,        2 },
+    { OBJ_ARRAY,       "reserve",     array_reserve,       1 },
+    { OBJ_ARRAY,       "shrinkToFit", array_shrink_to_fit, 0 },
+    { OBJ_MAP,         "has",         map_has,             1 },
+    { OBJ_MAP,         "delete",      map_delete,          1 },
+    { OBJ_MAP,         "keys",        map_keys,            0 },
+    { OBJ_MAP,         "size",        map_size,            0 },
+    { OBJ_DEQUE,       "pushFront",   deque_push_front,    1 },
+    { OBJ_DEQUE,       "pushBack",    deque_push_back,     1 },
+    { OBJ_DEQUE,       "popFront",    deque_pop_front,     0 },
+    { OBJ_DEQUE,       "popBack",     deque_pop_back,      0 },
+    { OBJ_DEQUE,       "front",       deque_front,         0 },
+    { OBJ_DEQUE,       "back",        deque_back,          0 },
+    { OBJ_DEQUE,       "size",        deque_size,          0 },
+    { OBJ_PQUEUE,      "push",        pqueue_push,         NATIVE_VARIADIC },
+    { OBJ_PQUEUE,      "pop",         pqueue_pop,          0 },
+    { OBJ_PQUEUE,      "peek",        pqueue_peek,         0 },
+    { OBJ_PQUEUE,      "size",        pqueue_size,         0 },
+    { OBJ_SET,         "add",         set_add,             1 },
+    { OBJ_SET,         "has",         set_has,             1 },
+    { OBJ_SET,         "delete",      set_delete,          1 },
+    { OBJ_SET,         "size",        set_size,            0 },
+    { OBJ_SET,         "values",      set_values,          0 },
+    { OBJ_TYPED_ARRAY, "size",        typed_size,          0 },
+    { OBJ_PVEC,        "set",         pvec_set,            2 },
+    { OBJ_PVEC,        "push",        pvec_push,           1 },
+    { OBJ_PVEC,        "pop",         pvec_pop,            0 },
+    { OBJ_PVEC,        "size",        pvec_size,           0 },
+    { OBJ_PVEC,        "toArray",     pvec_to_array,       0 },
+    { OBJ_PMAP,        "set",         pmap_set,            2 },
+    { OBJ_PMAP,        "delete",      pmap_delete,         1 },
+    { OBJ_PMAP,        "has",         pmap_has,            1 },
+    { OBJ_PMAP,        "size",        pmap_size,           0 },
+    { OBJ_PMAP,        "keys",        pmap_keys,           0 },
+    { OBJ_STRING,      "len",         str_len,             0 },
+    { OBJ_STRING,      "substr",      str_substr,          2 },
+    { OBJ_STRING,      "charAt",      str_char_at,         1 },
+    { OBJ_STRING,      "indexOf",     str_index_of,        1 },
+    { OBJ_STRING,      "split",       str_split,           1 },
+};
+
 
 
 
@@ -63,9 +214,6 @@ void VM_Init(VM_t* vm, Allocator_t* alloc)
     init_state(vm, alloc);
     vm->init_str = ObjStr_Copy(vm, "init", 4);
 
-    vm->native.array.push = ObjStr_Copy(vm, "push", 4);
-    vm->native.array.pop = ObjStr_Copy(vm, "pop", 3);
-    vm->native.array.size = ObjStr_Copy(vm, "size", 4);
     vm->native.array.open_bracket = ObjStr_Copy(vm, "[ ", 2);
     vm->native.array.comma = ObjStr_Copy(vm, ", ", 2);
     vm->native.array.close_bracket = ObjStr_Copy(vm, " ]", 2);
@@ -85,8 +233,32 @@ void VM_Init(VM_t* vm, Allocator_t* alloc)
 
     CLOX_ASSERT(VM_DefineNative(vm, "clock", Native_Clock, 0));
     CLOX_ASSERT(VM_DefineNative(vm, "toStr", Native_ToStr, 1));
-    CLOX_ASSERT(VM_DefineNative(vm, "Array", Native_Array, 0));
+    CLOX_ASSERT(VM_DefineNative(vm, "Array", Native_Array, NATIVE_VARIADIC));
     CLOX_ASSERT(VM_DefineNative(vm, "ArrayCpy", Native_ArrayCpy, 1));
+    CLOX_ASSERT(VM_DefineNative(vm, "Map", Native_Map, 0));
+    CLOX_ASSERT(VM_DefineNative(vm, "Deque", Native_Deque, 0));
+    CLOX_ASSERT(VM_DefineNative(vm, "PriorityQueue", Native_PriorityQueue, NATIVE_VARIADIC));
+    CLOX_ASSERT(VM_DefineNative(vm, "Set", Native_Set, 0));
+    CLOX_ASSERT(VM_DefineNative(vm, "PVector", Native_PVector, NATIVE_VARIADIC));
+    CLOX_ASSERT(VM_DefineNative(vm, "PMap", Native_PMap, NATIVE_VARIADIC));
+    CLOX_ASSERT(VM_DefineNative(vm, "Float64Array", Native_Float64Array, 1));
+    CLOX_ASSERT(VM_DefineNative(vm, "Int32Array", Native_Int32Array, 1));
+    CLOX_ASSERT(VM_DefineNative(vm, "sum", Native_Sum, 1));
+    CLOX_ASSERT(VM_DefineNative(vm, "dot", Native_Dot, 2));
+    CLOX_ASSERT(VM_DefineNative(vm, "min", Native_Min, 1));
+    CLOX_ASSERT(VM_DefineNative(vm, "max", Native_Max, 1));
+    CLOX_ASSERT(VM_DefineNative(vm, "scale", Native_Scale, 2));
+    CLOX_ASSERT(VM_DefineNative(vm, "add", Native_Add, 2));
+    CLOX_ASSERT(VM_DefineNative(vm, "substr", Native_Substr, 3));
+    CLOX_ASSERT(VM_DefineNative(vm, "charAt", Native_CharAt, 2));
+    CLOX_ASSERT(VM_DefineNative(vm, "indexOf", Native_IndexOf, 2));
+    CLOX_ASSERT(VM_DefineNative(vm, "split", Native_Split, 2));
+
+    for (size_t i = 0; i < STATIC_ARRSZ(s_methods); i++)
+    {
+        bool defined = VM_DefineMethod(vm, s_methods[i].type, s_methods[i].name, s_methods[i].fn, s_methods[i].arity);
+        CLOX_ASSERT(defined);
+    }
 }
 
 void VM_Reset(VM_t* vm)
@@ -98,25 +270,42 @@ void VM_Reset(VM_t* vm)
 
 
 
+size_t VM_StateSize(void)
+{
+    return offsetof(VM_t, stack);
+}
+
+void VM_SaveState(const VM_t* vm, void* state)
+{
+    CLOX_ASSERT(0 == vm->frame_count && NULL == vm->compiler);
+    memcpy(state, vm, VM_StateSize());
+}
+
+void VM_RestoreState(VM_t* vm, const void* state)
+{
+    memcpy(vm, state, VM_StateSize());
+    vm->compiler = NULL;
+}
+
+
+
 void VM_Free(VM_t* vm)
 {
+    GC_FinishSweep(vm);
     Allocator_Free(vm->alloc, vm->gray_stack);
+    GC_FreeThreads(vm);
     VM_FreeObjects(vm);
     Table_Free(&vm->strings);
     Table_Free(&vm->globals);
+    for (int i = 0; i < OBJ_TYPE_COUNT; i++)
+        Table_Free(&vm->methods[i]);
 
     init_state(vm, vm->alloc);
 }
 
 void VM_FreeObjects(VM_t* data)
 {
-    Obj_t* node = data->head;
-    while (NULL != node)
-    {
-        Obj_t* next = node->next;
-        Obj_Free(data, node);
-        node = next;
-    }
+    GC_FreeHeap(data);
 }
 
 
@@ -178,45 +367,55 @@ bool VM_DefineNative(VM_t* vm, const char* name, NativeFn_t fn, uint8_t argc)
 }
 
 
+void VM_NativeError(VM_t* vm, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+
+    vm->native_failed = true;
+}
+
+
+bool VM_DefineMethod(VM_t* vm, ObjType_t type, const char* name, NativeMethodFn_t fn, uint8_t arity)
+{
+    ObjString_t* method_name = ObjStr_Copy(vm, name, strlen(name));
+    if (!VM_Push(vm, OBJ_VAL(method_name)))
+    {
+        return false;
+    }
+
+    bool defined = define_type_method(vm, type, method_name, fn, arity);
+    if (OBJ_STRING == type)
+    {
+        defined = defined 
+            && define_type_method(vm, OBJ_SLICE, method_name, fn, arity)
+            && define_type_method(vm, OBJ_ROPE, method_name, fn, arity);
+    }
+
+    VM_Pop(vm);
+    return defined;
+}
+
+
 
 
 ObjString_t* VM_StrConcat(VM_t* vm, const ObjString_t* a, const ObjString_t* b)
 {
     ObjString_t* result = NULL;
-    char* buf = NULL;
     int len = a->len + b->len;
-    const ObjString_t* strs[] = { a, b };
 
     if (!VM_Push(vm, OBJ_VAL(a))) goto push_a_failed;
     if (!VM_Push(vm, OBJ_VAL(b))) goto push_b_failed;
     
 
-    
-
-#ifdef OBJSTR_FLEXIBLE_ARR
-    uint32_t hash = ObjStr_HashStrs(2, strs); 
-    result = Table_FindStrs(&vm->strings, 2, strs, hash, len);
-    if (NULL == result)
-    {
-        result = ObjStr_Reserve(vm, len);
-        buf = result->cstr;
-
-        memcpy(buf, a->cstr, a->len);
-        memcpy(buf + a->len, b->cstr, b->len);
-        buf[len] = '\0';
-
-        ObjStr_Intern(vm, result);
-    }
-#else 
-    buf = ALLOCATE(vm, char, len + 1);
-    
-    memcpy(buf, a->cstr, a->len);
-    memcpy(buf + a->len, b->cstr, b->len);
-    buf[len] = '\0';
-
-    result = ObjStr_Steal(vm, buf, len);
-#endif /* OBJSTR_FLEXIBLE_ARR */
-
+    /* not interned, most concatenations are only printed or compared */
+    result = ObjStr_Reserve(vm, len);
+    memcpy(result->cstr, a->cstr, a->len);
+    memcpy(result->cstr + a->len, b->cstr, b->len);
+    result->cstr[len] = '\0';
 
 
     VM_Pop(vm); /* b */
@@ -245,7 +444,11 @@ InterpretResult_t VM_Interpret(VM_t* vm, const char* src)
     VM_Push(vm, OBJ_VAL(script));
 
     call(vm, script, 0);
-    return run(vm);
+    InterpretResult_t result = run(vm, 0);
+
+    /* nothing outside of the vm holds on to its objects anymore */
+    GC_MaybeCompact(vm);
+    return result;
 }
 
 
@@ -264,7 +467,8 @@ InterpretResult_t VM_Interpret(VM_t* vm, const char* src)
 
 
 
-static InterpretResult_t run(VM_t* vm)
+/* runs until the frame above base_frame returns, 0 runs the whole script */
+static InterpretResult_t run(VM_t* vm, int base_frame)
 {
 
     /* these macros make me sick */
@@ -282,7 +486,7 @@ do{\
 
 #define GET_IP() (current->ip)
 #define READ_BYTE() (*GET_IP()++)
-#define READ_CONSTANT() (current->closure->fun->chunk.consts.vals[READ_BYTE()])
+#define READ_CONSTANT() (DEREF(ObjFunction_t, current->closure->fun)->chunk.consts.vals[READ_BYTE()])
 
 
 #define READ_SHORT() \
@@ -293,7 +497,7 @@ do{\
     (GET_IP() += 3, (((uint32_t)GET_IP()[-3] << 16) \
                    | ((uint32_t)GET_IP()[-2] << 8) \
                    | GET_IP()[-1]))
-#define READ_CONSTANT_LONG() (current->closure->fun->chunk.consts.vals[READ_LONG()])
+#define READ_CONSTANT_LONG() (DEREF(ObjFunction_t, current->closure->fun)->chunk.consts.vals[READ_LONG()])
 
 
 #define READ_STR() AS_STR(READ_CONSTANT())
@@ -348,8 +552,9 @@ do{\
         }\
         ObjInstance_t* inst = AS_INSTANCE(peek(vm, 1));\
         ObjString_t* name = readstr_macro();\
-        Value_t val = POP();\
+        Value_t val = peek(vm, 0); /* stays rooted while the fields grow */\
         Table_Set(&inst->fields, name, val);\
+        POP();\
         POP(); /* the instance */\
         PUSH(val);\
     } while(0)
@@ -357,7 +562,7 @@ do{\
 
 #define BINARY_OP(ValueType, op) \
 do{\
-    if (!IS_NUMBER(peek(vm, 0)) || !IS_NUMBER(peek(vm, 1))) {\
+    if (!ARE_NUMBERS(peek(vm, 0), peek(vm, 1))) {\
         runtime_error(vm, "Operands must be numbers.");\
         return INTERPRET_RUNTIME_ERROR;\
     }\
@@ -366,6 +571,17 @@ do{\
     PUSH(ValueType(a op b));\
 }while(0)
 
+/* 2 ints are computed in 64 bits, so IntType can promote the ones that overflow */
+#define INT_BINARY_OP(IntType, ValueType, op) \
+do{\
+    if (ARE_INTS(peek(vm, 0), peek(vm, 1))) {\
+        int64_t b = AS_INT(POP());\
+        int64_t a = AS_INT(POP());\
+        PUSH(IntType(a op b));\
+    }\
+    else BINARY_OP(ValueType, op);\
+}while(0)
+
 
 
 
@@ -393,35 +609,50 @@ do{\
                 runtime_error(vm, "Operand must be a number.");
                 return INTERPRET_RUNTIME_ERROR;
             }
-            PUSH(NUMBER_VAL(-AS_NUMBER(POP()))); 
+            if (IS_INT(peek(vm, 0)))
+            {
+                int64_t i = AS_INT(POP());
+                /* -0 is a double */
+                PUSH(0 == i? NUMBER_VAL(-0.0) : Value_FromInt(-i));
+            }
+            else
+            {
+                PUSH(NUMBER_VAL(-AS_NUMBER(POP()))); 
+            }
             break;
 
         case OP_NOT:        PUSH(BOOL_VAL(is_falsey(POP()))); break;
 
 
         case OP_ADD:
-            if (IS_STRING(peek(vm, 0)) && IS_STRING(peek(vm, 1)))
+            if (ARE_INTS(peek(vm, 0), peek(vm, 1)))
             {
-                const ObjString_t* b = AS_STR(POP());
-                const ObjString_t* a = AS_STR(POP());
-                PUSH(OBJ_VAL(VM_StrConcat(vm, a, b)));
+                int64_t b = AS_INT(POP());
+                int64_t a = AS_INT(POP());
+                PUSH(Value_FromInt(a + b));
             }
-            else if (IS_NUMBER(peek(vm, 0)) && IS_NUMBER(peek(vm, 1)))
+            else if (ARE_NUMBERS(peek(vm, 0), peek(vm, 1)))
             {
                 double b = AS_NUMBER(POP());
                 double a = AS_NUMBER(POP());
                 PUSH(NUMBER_VAL(a + b));
             }
+            else if (is_strlike(peek(vm, 0)) && is_strlike(peek(vm, 1)))
+            {
+                concat(vm);
+            }
             else
             {
                 runtime_error(vm, "Operands must be numbers or strings.");
                 return INTERPRET_RUNTIME_ERROR;
             }
             break;
-        case OP_SUBTRACT:   BINARY_OP(NUMBER_VAL, - ); break;
+        case OP_SUBTRACT:   INT_BINARY_OP(Value_FromInt, NUMBER_VAL, - ); break;
         case OP_MULTIPLY:   
-            if (IS_STRING(peek(vm, 1)) && IS_NUMBER(peek(vm, 0)))
+            if (is_strlike(peek(vm, 1)) && IS_NUMBER(peek(vm, 0)))
             {
+                flatten(vm, 1);
+                unslice(vm, 1);
                 unsigned padcount = AS_NUMBER(POP());
                 const ObjString_t* original = AS_STR(peek(vm, 0));
 
@@ -437,6 +668,16 @@ do{\
                 POP();
                 PUSH(OBJ_VAL(str));
             }
+            else if (ARE_INTS(peek(vm, 0), peek(vm, 1)))
+            {
+                int64_t b = AS_INT(POP());
+                int64_t a = AS_INT(POP());
+                /* 0 times a negative number is -0, which only a double can be */
+                if (a * b == 0 && (a < 0 || b < 0))
+                    PUSH(NUMBER_VAL(-0.0));
+                else
+                    PUSH(Value_FromInt(a * b));
+            }
             else 
             {
                 BINARY_OP(NUMBER_VAL, * );
@@ -447,13 +688,15 @@ do{\
 
         case OP_EQUAL:
         {
+            flatten(vm, 0);
+            flatten(vm, 1);
             Value_t b = POP();
             Value_t a = POP();
             PUSH(BOOL_VAL(Value_Equal(a, b)));
         }
         break;
-        case OP_GREATER:    BINARY_OP(BOOL_VAL, > ); break;
-        case OP_LESS:       BINARY_OP(BOOL_VAL, < ); break;
+        case OP_GREATER:    INT_BINARY_OP(BOOL_VAL, BOOL_VAL, > ); break;
+        case OP_LESS:       INT_BINARY_OP(BOOL_VAL, BOOL_VAL, < ); break;
 
 
         case OP_TRUE:       PUSH(BOOL_VAL(true)); break;
@@ -463,6 +706,7 @@ do{\
 
         case OP_PRINT:
         {
+            flatten(vm, 0);
             Value_Print(stdout, POP());
             printf("\n");
         }
@@ -545,7 +789,8 @@ do{\
         {
             ObjString_t* method = READ_STR();
             int argc = READ_BYTE();
-            if (!invoke_method(vm, method, argc))
+            uint8_t* cache = GET_IP()++;
+            if (!invoke_method(vm, method, argc, cache))
             {
                 return INTERPRET_RUNTIME_ERROR;
             }
@@ -570,14 +815,14 @@ do{\
         case OP_GET_UPVALUE:
         {
             uint8_t slot = READ_BYTE();
-            ObjUpval_t* upval = current->closure->upvals[slot];
+            ObjUpval_t* upval = DEREF(ObjUpval_t, current->closure->upvals[slot]);
             PUSH(*upval->location);
         }
         break;
         case OP_SET_UPVALUE:
         {
             uint8_t slot = READ_BYTE();
-            ObjUpval_t* upval = current->closure->upvals[slot];
+            ObjUpval_t* upval = DEREF(ObjUpval_t, current->closure->upvals[slot]);
 
             /* does not pop because this instruction is only used in assignment expressions,
              * and expressions do have return value in Lox,
@@ -617,7 +862,7 @@ do{\
 
                 if (is_local)
                 {
-                    closure->upvals[i] = capture_upval(vm, current->bp + slot);
+                    closure->upvals[i] = REF(capture_upval(vm, current->bp + slot));
                 }
                 else 
                 {
@@ -645,6 +890,8 @@ do{\
 
             vm->sp = current->bp;
             PUSH(val);
+            if (vm->frame_count == base_frame)
+                return INTERPRET_OK;
             current = CALLFRAME_POP();
         }
         break;
@@ -683,28 +930,70 @@ do{\
 
         case OP_GET_INDEX:
         {
+            if (IS_MAP(peek(vm, 1)))
+            {
+                map_get(vm);
+                break;
+            }
+            if (IS_TYPED_ARRAY(peek(vm, 1)))
+            {
+                if (!typed_get(vm))
+                    return INTERPRET_RUNTIME_ERROR;
+                break;
+            }
+            if (IS_PVEC(peek(vm, 1)))
+            {
+                if (!pvec_get(vm))
+                    return INTERPRET_RUNTIME_ERROR;
+                break;
+            }
+            if (IS_PMAP(peek(vm, 1)))
+            {
+                if (!pmap_get(vm))
+                    return INTERPRET_RUNTIME_ERROR;
+                break;
+            }
+
             Value_t index = POP();
             Value_t array = POP();
-            Value_t* val = array_index(vm, array, index);
-            if (NULL == val)
+            size_t i;
+            if (!array_index(vm, array, index, &i))
             {
                 return INTERPRET_RUNTIME_ERROR;
             }
-            PUSH(*val);
+            PUSH(ObjArr_Get(AS_ARRAY(array), i));
         }
         break;
         case OP_SET_INDEX:
         {
-            Value_t set = POP();
-            Value_t index = POP();
-            Value_t array = POP();
-            Value_t* val = array_index(vm, array, index);
-            if (NULL == val)
+            if (IS_MAP(peek(vm, 2)))
+            {
+                map_set(vm);
+                break;
+            }
+            if (IS_TYPED_ARRAY(peek(vm, 2)))
+            {
+                if (!typed_set(vm))
+                    return INTERPRET_RUNTIME_ERROR;
+                break;
+            }
+            if (IS_PVEC(peek(vm, 2)) || IS_PMAP(peek(vm, 2)))
+            {
+                runtime_error(vm, "Persistent vectors and maps can not be changed, set() gives an updated copy.");
+                return INTERPRET_RUNTIME_ERROR;
+            }
+
+            /* left on the stack, storing a value that is not a number in packed numbers allocates */
+            Value_t set = peek(vm, 0);
+            Value_t array = peek(vm, 2);
+            size_t i;
+            if (!array_index(vm, array, peek(vm, 1), &i))
             {
                 return INTERPRET_RUNTIME_ERROR;
             }
-            *val = set;
-            PUSH(set);
+            ObjArr_Set(vm, AS_ARRAY(array), i, set);
+            vm->sp -= 2;
+            vm->sp[-1] = set;
         }
         break;
 
@@ -716,9 +1005,7 @@ do{\
             ObjArray_t* obj = ObjArr_Create(vm);
             PUSH(OBJ_VAL(obj));
 
-            ValArr_Reserve(&obj->array, list_size);
-            memcpy(obj->array.vals, begin, sizeof(*begin) * list_size);
-            obj->array.size = list_size;
+            ObjArr_Append(vm, obj, begin, list_size);
 
             vm->sp -= list_size + 1;
             PUSH(OBJ_VAL(obj));
@@ -727,7 +1014,7 @@ do{\
 
         case OP_EXPONENT:
         {
-            if (!IS_NUMBER(peek(vm, 0)) || !IS_NUMBER(peek(vm, 1)))
+            if (!ARE_NUMBERS(peek(vm, 0), peek(vm, 1)))
             {
                 runtime_error(vm, "Operands must be numbers.");
                 return INTERPRET_RUNTIME_ERROR;
@@ -790,23 +1077,21 @@ do{\
 
 static void init_state(VM_t* vm, Allocator_t* alloc)
 {
-    vm->head = NULL;
+    GC_InitHeap(&vm->heap);
     vm->open_upvals = NULL;
     vm->alloc = alloc;
     vm->compiler = NULL;
     vm->frame_count = 0;
+    vm->native_failed = false;
 
     vm->init_str = NULL;
-    vm->native.array.push = NULL;
-    vm->native.array.pop = NULL;
-    vm->native.array.size = NULL;
     vm->native.array.open_bracket = NULL;
     vm->native.array.comma = NULL;
     vm->native.array.close_bracket = NULL;
 
     vm->native.str.nil = NULL;
     vm->native.str.true_ = NULL;
-    vm->native.str.true_ = NULL;
+    vm->native.str.false_ = NULL;
     vm->native.str.script = NULL;
     vm->native.str.nativefn = NULL;
     vm->native.str.array = NULL;
@@ -817,13 +1102,29 @@ static void init_state(VM_t* vm, Allocator_t* alloc)
     vm->gray_capacity = 0;
     vm->gray_stack = NULL;
 
+    vm->gc_mark_threads = GC_MARK_THREADS_DEFAULT;
+    vm->gc_worker_count = 0;
+    vm->gc_workers = NULL;
+    vm->gc_background_sweep = true;
+    vm->gc_sweeper = NULL;
+    vm->gc_compact = true;
+
     vm->bytes_allocated = 0;
-    vm->next_gc = 1024 * 1024;
+#ifdef HASH_RANDOM_SEED
+    vm->hash_seed = (uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)vm ^ (uint64_t)clock() << 32;
+#else
+    vm->hash_seed = 0;
+#endif /* HASH_RANDOM_SEED */
+    vm->next_gc = GC_MIN_NEXT_GC;
 
 
     stack_reset(vm);
     Table_Init(&vm->strings, vm);
     Table_Init(&vm->globals, vm);
+    for (int i = 0; i < OBJ_TYPE_COUNT; i++)
+        Table_Init(&vm->methods[i], vm);
+    vm->native_methods[0] = (NativeMethod_t){ .fn = NULL, .type = UINT8_MAX, .arity = 0 };
+    vm->native_method_count = 1;
 }
 
 
@@ -844,15 +1145,103 @@ static Value_t peek(const VM_t* vm, int offset)
 
 static bool is_falsey(const Value_t val)
 {
-    return
-#ifdef BLAZINGLY_FAST
-    (0 == val) /* floating point zero */
+#ifdef NAN_BOXING
+    /* 
+     * nil and false are the 2 tags before true, 
+     * and the numbers within FLT_EPSILON of 0 are the ones with the smallest magnitude bits, 
+     * every other tag is above them because it is a NaN, 
+     * so the int 0 is checked on its own
+     */
+    return (val - NIL_VAL() <= FALSE_VAL - NIL_VAL())
+        | ((val & ~SIGNBIT(double)) <= NUMBER_VAL(FLT_EPSILON))
+        | (val == INT_VAL(0));
 #else
-    0
-#endif /* BLAZINGLY_FAST */
-        || IS_NIL(val)
+    return IS_NIL(val)
         || (IS_BOOL(val) && !AS_BOOL(val))
         || (IS_NUMBER(val) && Value_Equal(val, NUMBER_VAL(0.0f)));
+#endif /* NAN_BOXING */
+}
+
+
+static bool is_strlike(const Value_t val)
+{
+    return IS_OBJ(val) 
+        && (OBJ_STRING == OBJ_TYPE(val) || OBJ_ROPE == OBJ_TYPE(val) || OBJ_SLICE == OBJ_TYPE(val));
+}
+
+
+/* 
+ * replaces the 2 strings or ropes on top of the stack by their concatenation, 
+ * a short string added to the end (or the start) of a rope is copied together with the rope's last (first) string, 
+ * so that building a string a character at a time does not make a rope per character
+ */
+static void concat(VM_t* vm)
+{
+    /* ropes only hold strings and other ropes */
+    unslice(vm, 0);
+    unslice(vm, 1);
+
+    Obj_t* b = AS_OBJ(peek(vm, 0));
+    Obj_t* a = AS_OBJ(peek(vm, 1));
+    Value_t result;
+
+    if (OBJ_STRING == a->type && OBJ_STRING == b->type)
+    {
+        ObjString_t* str_a = (ObjString_t*)a;
+        ObjString_t* str_b = (ObjString_t*)b;
+        if (0 == str_a->len) 
+            result = OBJ_VAL(b);
+        else if (0 == str_b->len) 
+            result = OBJ_VAL(a);
+        else if (str_a->len + str_b->len < ROPE_MIN_LEN)
+            result = OBJ_VAL(VM_StrConcat(vm, str_a, str_b));
+        else 
+            result = OBJ_VAL(ObjRope_Create(vm, a, b));
+    }
+    else 
+    {
+        /* the joined string takes the place of the operand it replaces on the stack */
+        Obj_t* last = OBJ_ROPE == a->type ? DEREF_NULLABLE(Obj_t, ((ObjRope_t*)a)->right) : NULL;
+        Obj_t* first = OBJ_ROPE == b->type && NULL != DEREF_NULLABLE(Obj_t, ((ObjRope_t*)b)->right)
+            ? DEREF(Obj_t, ((ObjRope_t*)b)->left) : NULL;
+
+        if (OBJ_STRING == b->type && NULL != last && OBJ_STRING == last->type
+        && ((ObjString_t*)last)->len + ((ObjString_t*)b)->len < ROPE_MIN_LEN)
+        {
+            b = (Obj_t*)VM_StrConcat(vm, (ObjString_t*)last, (ObjString_t*)b);
+            vm->sp[-1] = OBJ_VAL(b);
+            a = DEREF(Obj_t, ((ObjRope_t*)a)->left);
+        }
+        else if (OBJ_STRING == a->type && NULL != first && OBJ_STRING == first->type
+        && ((ObjString_t*)a)->len + ((ObjString_t*)first)->len < ROPE_MIN_LEN)
+        {
+            a = (Obj_t*)VM_StrConcat(vm, (ObjString_t*)a, (ObjString_t*)first);
+            vm->sp[-2] = OBJ_VAL(a);
+            b = DEREF(Obj_t, ((ObjRope_t*)b)->right);
+        }
+        result = OBJ_VAL(ObjRope_Create(vm, a, b));
+    }
+
+    vm->sp -= 1;
+    vm->sp[-1] = result;
+}
+
+
+/* replaces the rope at offset on the stack by its string */
+static void flatten(VM_t* vm, int offset)
+{
+    Value_t* slot = &vm->sp[-1 - offset];
+    if (IS_ROPE(*slot))
+        *slot = OBJ_VAL(ObjRope_Flatten(vm, AS_ROPE(*slot)));
+}
+
+
+/* replaces the slice at offset on the stack by a copy of it */
+static void unslice(VM_t* vm, int offset)
+{
+    Value_t* slot = &vm->sp[-1 - offset];
+    if (IS_SLICE(*slot))
+        *slot = OBJ_VAL(ObjSlice_Flatten(vm, AS_SLICE(*slot)));
 }
 
 
@@ -889,8 +1278,8 @@ static void debug_trace_execution(const VM_t* vm)
     VM_PrintStack(stderr, vm);
     fprintf(stderr, "\n");
     Disasm_Instruction(stderr, 
-        &current->closure->fun->chunk, 
-        current->ip - current->closure->fun->chunk.code
+        &DEREF(ObjFunction_t, current->closure->fun)->chunk, 
+        current->ip - DEREF(ObjFunction_t, current->closure->fun)->chunk.code
     );
 #else
     (void)vm;
@@ -914,7 +1303,7 @@ static void trace_cf(const VM_t* vm)
     for (int i = 0; i < vm->frame_count; i++)
     {
         const CallFrame_t* frame = &vm->frames[i];
-        const ObjFunction_t* fun = frame->closure->fun;
+        const ObjFunction_t* fun = DEREF(ObjFunction_t, frame->closure->fun);
         size_t ins = frame->ip - fun->chunk.code - 1;
         
         fprintf(stderr, "[line %d] in ",
@@ -971,7 +1360,7 @@ static bool call_value(VM_t* vm, Value_t callee, int argc)
         ObjBoundMethod_t* bound = AS_BOUND_METHOD(callee);
         /* set slot 0 as "this" for method invocation */
         vm->sp[-argc - 1] = bound->receiver;
-        return call(vm, bound->method, argc);
+        return call(vm, DEREF(ObjClosure_t, bound->method), argc);
     }
     break;
 
@@ -987,10 +1376,11 @@ error:
 
 static bool call(VM_t* vm, ObjClosure_t* closure, int argc)
 {
-    if (argc != closure->fun->arity)
+    const ObjFunction_t* fun = DEREF(ObjFunction_t, closure->fun);
+    if (argc != fun->arity)
     {
         runtime_error(vm, "Expected %d arguments, got %d instead.", 
-            closure->fun->arity, argc
+            fun->arity, argc
         );
         return false;
     }
@@ -1003,7 +1393,7 @@ static bool call(VM_t* vm, ObjClosure_t* closure, int argc)
 
     CallFrame_t* current = &vm->frames[vm->frame_count++];
     current->closure = closure;
-    current->ip = closure->fun->chunk.code;
+    current->ip = fun->chunk.code;
     current->bp = vm->sp - argc - 1;
     return true;
 }
@@ -1011,7 +1401,7 @@ static bool call(VM_t* vm, ObjClosure_t* closure, int argc)
 
 static bool call_native(VM_t* vm, ObjNativeFn_t* native, int argc)
 {
-    if (native->arity != argc)
+    if (native->arity != argc && NATIVE_VARIADIC != native->arity)
     {
         runtime_error(vm, "Expected %d arguments, got %d instead.", native->arity, argc);
         return false;
@@ -1019,6 +1409,13 @@ static bool call_native(VM_t* vm, ObjNativeFn_t* native, int argc)
 
     Value_t* argv = vm->sp - argc;
     Value_t ret = native->fn(vm, argc, argv);
+    if (vm->native_failed) /* the error was printed by VM_NativeError */
+    {
+        vm->native_failed = false;
+        trace_cf(vm);
+        stack_reset(vm);
+        return false;
+    }
     vm->sp = argv;
     vm->sp[-1] = ret;
     return true;
@@ -1026,6 +1423,19 @@ static bool call_native(VM_t* vm, ObjNativeFn_t* native, int argc)
 
 
 
+/* calls the callee below the argc arguments on top of the stack and runs it through, what it returns replaces them */
+static bool call_from_c(VM_t* vm, int argc)
+{
+    const int base_frame = vm->frame_count;
+    if (!call_value(vm, vm->sp[-argc - 1], argc))
+        return false;
+    if (vm->frame_count == base_frame) /* natives and classes without an initializer are done already */
+        return true;
+    return INTERPRET_OK == run(vm, base_frame);
+}
+
+
+
 static ObjUpval_t* capture_upval(VM_t* vm, Value_t* bp)
 {
     ObjUpval_t* prev = NULL;
@@ -1033,7 +1443,7 @@ static ObjUpval_t* capture_upval(VM_t* vm, Value_t* bp)
     while (NULL != curr && curr->location > bp)
     {
         prev = curr;
-        curr = curr->next;
+        curr = DEREF_NULLABLE(ObjUpval_t, curr->next);
     }
 
     if (NULL != curr && bp == curr->location)
@@ -1043,14 +1453,14 @@ static ObjUpval_t* capture_upval(VM_t* vm, Value_t* bp)
 
 
     ObjUpval_t* new_upval = ObjUpv_Create(vm, bp);
-    new_upval->next = curr;
+    new_upval->next = REF(curr);
     if (NULL == prev)
     {
         vm->open_upvals = new_upval;
     }
     else
     {
-        prev->next = new_upval;
+        prev->next = REF(new_upval);
     }
     return new_upval;
 }
@@ -1065,7 +1475,7 @@ static void close_upval(VM_t* vm, const Value_t* bp)
         ObjUpval_t* upval = vm->open_upvals;
         upval->closed = *upval->location;
         upval->location = &upval->closed;
-        vm->open_upvals = upval->next;
+        vm->open_upvals = DEREF_NULLABLE(ObjUpval_t, upval->next);
     }
 }
 
@@ -1102,12 +1512,12 @@ static bool bind_method(VM_t* vm, ObjClass_t* klass, ObjString_t* name)
 
 
 
-static bool invoke_method(VM_t* vm, const ObjString_t* method_name, int argc)
+static bool invoke_method(VM_t* vm, const ObjString_t* method_name, int argc, uint8_t* cache)
 {
     Value_t receiver = peek(vm, argc);
-    if (IS_ARRAY(receiver))
+    if (IS_OBJ(receiver) && !IS_INSTANCE(receiver))
     {
-        return array_method(vm, receiver, method_name, argc);
+        return invoke_native_method(vm, method_name, argc, cache);
     }
     if (!IS_INSTANCE(receiver))
     {
@@ -1140,82 +1550,931 @@ static bool invoke_class_method(VM_t* vm, ObjClass_t* klass, const ObjString_t*
 }
 
 
+/*
+ *  a call site's cache byte is the index of the builtin method it called last, 
+ *  which it calls again without looking it up as long as the receiver is of the same type
+ */
+static bool invoke_native_method(VM_t* vm, const ObjString_t* method_name, int argc, uint8_t* cache)
+{
+    Value_t* args = vm->sp - argc - 1;
+    const ObjType_t type = OBJ_TYPE(args[0]);
+    const NativeMethod_t* method = &vm->native_methods[*cache];
+
+    if (method->type != type)
+    {
+        Value_t index;
+        if (!Table_Get(&vm->methods[type], method_name, &index))
+        {
+            if (0 == vm->methods[type].count)
+                runtime_error(vm, "Only instances have methods.");
+            else
+                runtime_error(vm, "Undefined method '%s'.", method_name->cstr);
+            return false;
+        }
+        *cache = (uint8_t)AS_NUMBER(index);
+        method = &vm->native_methods[*cache];
+    }
+
+    if (argc != method->arity && NATIVE_VARIADIC != method->arity)
+    {
+        runtime_error(vm, "Expected %d arguments to '%s', got %d instead.", 
+            method->arity, method_name->cstr, argc
+        );
+        return false;
+    }
+
+    Value_t ret;
+    if (!method->fn(vm, argc, args, &ret))
+        return false;
+    vm->sp = args + 1;
+    args[0] = ret;
+    return true;
+}
+
+
+/* index 0 of the native methods is none, so that an empty cache byte matches no type */
+static bool define_type_method(VM_t* vm, ObjType_t type, ObjString_t* name, NativeMethodFn_t fn, uint8_t arity)
+{
+    if (vm->native_method_count >= VM_NATIVE_METHODS_MAX)
+        return false;
+
+    NativeMethod_t* method = &vm->native_methods[vm->native_method_count];
+    method->fn = fn;
+    method->type = type;
+    method->arity = arity;
+    Table_Set(&vm->methods[type], name, Value_FromInt(vm->native_method_count));
+    vm->native_method_count++;
+    return true;
+}
+
 
-static Value_t* array_index(VM_t* vm, Value_t array, Value_t index)
+
+static bool array_index(VM_t* vm, Value_t array, Value_t index, size_t* index_out)
 {
     if (!IS_OBJ(array) || !IS_ARRAY(array))
     {
-        runtime_error(vm, "Indexed value is not an array.");
-        return NULL;
+        runtime_error(vm, "Indexed value is not an array, a typed array or a map.");
+        return false;
     }
 
     if (!IS_NUMBER(index))
     {
         runtime_error(vm, "Indexing value is not a number.");
-        return NULL;
+        return false;
     }
 
 
-    ValueArr_t* arr = &(AS_ARRAY(array)->array);
-    uint64_t i = AS_NUMBER(index);
+    const ObjArray_t* arr = AS_ARRAY(array);
+    /* a negative int wraps around to an index that is out of bound */
+    uint64_t i = IS_INT(index)? (uint64_t)(int64_t)AS_INT(index) : (uint64_t)AS_NUMBER(index);
     if (i >= arr->size)
     {
         runtime_error(vm, 
             "Index out of bound: %"PRIu64" >= array size: %"PRIu64" elements.", 
-            i, arr->size
+            i, (uint64_t)arr->size
         );
-        return NULL;
+        return false;
     }
 
-    return &arr->vals[i];
+    *index_out = i;
+    return true;
+}
+
+
+
+static bool array_push(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    ObjArray_t* array = AS_ARRAY(args[0]);
+    ObjArr_Push(vm, array, args[1]);
+    *ret = ObjArr_Get(array, array->size - 1);
+    return true;
 }
 
 
+static bool array_pop(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    ObjArray_t* array = AS_ARRAY(args[0]);
+    *ret = 0 == array->size? NIL_VAL() : ObjArr_Pop(vm, array);
+    return true;
+}
+
 
-static bool array_method(VM_t* vm, Value_t value, const ObjString_t* method_name, int argc)
+static bool array_size(VM_t* vm, int argc, Value_t* args, Value_t* ret)
 {
-    ValueArr_t* array = &AS_ARRAY(value)->array;
-    Value_t retval = NIL_VAL();
-    int expect_argc = 0;
+    (void)vm, (void)argc;
+    *ret = Value_FromInt(AS_ARRAY(args[0])->size);
+    return true;
+}
+
 
-    if (ObjStr_Equal(vm->native.array.push, method_name))
+static bool array_slice(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    ObjArray_t* array = AS_ARRAY(args[0]);
+    if (!IS_NUMBER(args[1]) || !IS_NUMBER(args[2]))
     {
-        expect_argc = 1;
-        if (argc != expect_argc) goto error_argc;
+        runtime_error(vm, "Slice bounds must be numbers.");
+        return false;
+    }
+
+    /* the bounds are clamped to the array, the array is still on the stack */
+    size_t start = slice_bound(args[1], array->size);
+    size_t end = slice_bound(args[2], array->size);
+    if (end < start)
+        end = start;
+    *ret = OBJ_VAL(ObjArr_Slice(vm, array, start, end));
+    return true;
+}
 
-        ValArr_Write(array, peek(vm, 0));
-        retval = array->vals[array->size - 1];
+
+/* numbers or strings unless a comparator is given */
+static bool array_sort(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    ObjArray_t* array = AS_ARRAY(args[0]);
+    *ret = args[0];
+    if (argc > 1)
+    {
+        runtime_error(vm, "Expected 0 or 1 arguments to sort, got %d instead.", argc);
+        return false;
     }
-    else if (ObjStr_Equal(vm->native.array.pop, method_name))
+
+    if (0 == argc)
     {
-        if (argc != expect_argc) goto error_argc;
+        if (ObjArr_IsShared(array))
+            ObjArr_Own(vm, array);
+        if (ELEMS_NUMBERS == array->kind)
+        {
+            Sort_Numbers(array->as.nums, array->size);
+            return true;
+        }
 
-        if (array->size != 0)
+        flatten_elems(vm, array);
+        bool numbers = true, strings = true;
+        for (size_t i = 0; i < array->size; i++)
+        {
+            Value_t elem = array->as.vals[i];
+            numbers = numbers && IS_NUMBER(elem);
+            strings = strings && (IS_STRING(elem) || IS_SLICE(elem));
+        }
+        if (!numbers && !strings)
         {
-            retval = array->vals[array->size - 1];
-            array->size -= 1;
+            runtime_error(vm, "Can only sort numbers or strings without a comparator.");
+            return false;
         }
+        Sort_Values(array->as.vals, array->size, numbers? Sort_NumLess : Sort_StrLess, NULL);
+        return true;
     }
-    else if (ObjStr_Equal(vm->native.array.size, method_name)) 
+
+
+    /* 
+     *  the comparator could do anything to the array, 
+     *  so a copy that only the stack sees is sorted, then it trades its elements for the array's,
+     *  unless the array no longer has the elements of another copy (which shares them, or is small)
+     */
+    ObjArray_t* before = ObjArr_Copy(vm, array);
+    VM_Push(vm, OBJ_VAL(before));
+    ObjArray_t* sorted = ObjArr_Copy(vm, array);
+    VM_Push(vm, OBJ_VAL(sorted));
+    if (ObjArr_IsShared(sorted))
+        ObjArr_Own(vm, sorted);
+
+    SortCmp_t cmp = { .vm = vm, .cmp = args[1], .failed = false };
+    if (ELEMS_NUMBERS == sorted->kind)
+        Sort_NumbersBy(sorted->as.nums, sorted->size, sort_cmp_less, &cmp);
+    else 
+        Sort_Values(sorted->as.vals, sorted->size, sort_cmp_less, &cmp);
+    if (cmp.failed) /* the error reset the stack */
+        return false;
+    if (!ObjArr_SameElems(array, before))
     {
-        if (argc != expect_argc) goto error_argc;
-        retval = NUMBER_VAL(array->size);
+        runtime_error(vm, "Can not change an array from its sort comparator.");
+        return false;
     }
-    else 
+
+    ObjArr_SwapElems(array, sorted);
+    VM_Pop(vm);
+    VM_Pop(vm);
+    return true;
+}
+
+
+static bool array_concat(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    if (!IS_ARRAY(args[1]))
     {
-        runtime_error(vm, "Undefined array method: %s", method_name->cstr);
+        runtime_error(vm, "Can only concat an array to an array.");
         return false;
     }
+    *ret = OBJ_VAL(ObjArr_Concat(vm, AS_ARRAY(args[0]), AS_ARRAY(args[1])));
+    return true;
+}
+
 
-    vm->sp -= argc + 1;
-    VM_Push(vm, retval);
+static bool array_fill(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    flatten(vm, 0);
+    ObjArr_Fill(vm, AS_ARRAY(args[0]), args[1]);
+    *ret = args[0];
     return true;
+}
 
-error_argc:
-    runtime_error(vm, "Expected %d arguments to array method, got %d instead.", 
-        argc, expect_argc
-    );
+
+static bool array_index_of(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    ObjArray_t* array = AS_ARRAY(args[0]);
+    flatten(vm, 0);
+    if (is_strlike(args[1]))
+        flatten_elems(vm, array);
+    *ret = Value_FromInt(ObjArr_IndexOf(array, args[1]));
+    return true;
+}
+
+
+static bool array_reverse(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    ObjArr_Reverse(vm, AS_ARRAY(args[0]));
+    *ret = args[0];
+    return true;
+}
+
+
+static bool array_insert(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    ObjArray_t* array = AS_ARRAY(args[0]);
+
+    /* the end of the array is where push inserts */
+    double i = IS_NUMBER(args[1])? AS_NUMBER(args[1]) : -1;
+    if (!(0 <= i && i <= (double)array->size))
+    {
+        runtime_error(vm, "Insertion index is not a number within the array's size.");
+        return false;
+    }
+    ObjArr_Insert(vm, array, (size_t)i, args[2]);
+    *ret = args[2];
+    return true;
+}
+
+
+static bool array_reserve(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    ObjArray_t* array = AS_ARRAY(args[0]);
+    double count = IS_NUMBER(args[1])? AS_NUMBER(args[1]) : NAN;
+    if (!(count < 0x1p53))
+    {
+        runtime_error(vm, "Can only reserve a number of elements.");
+        return false;
+    }
+
+    /* room for that many elements in all, not that many more */
+    if (count > (double)array->size)
+        ObjArr_Reserve(vm, array, (size_t)count - array->size);
+    *ret = args[0];
+    return true;
+}
+
+
+static bool array_shrink_to_fit(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    ObjArr_ShrinkToFit(vm, AS_ARRAY(args[0]));
+    *ret = args[0];
+    return true;
+}
+
+
+/* a comparator returns a negative number or true when its first argument goes before its second */
+static bool sort_cmp_less(void* ctx, Value_t a, Value_t b)
+{
+    SortCmp_t* cmp = ctx;
+    VM_t* vm = cmp->vm;
+    if (cmp->failed)
+        return false;
+
+    if (!VM_Push(vm, cmp->cmp) || !VM_Push(vm, a) || !VM_Push(vm, b) || !call_from_c(vm, 2))
+    {
+        cmp->failed = true;
+        return false;
+    }
+
+    Value_t order = VM_Pop(vm);
+    if (IS_NUMBER(order))
+        return AS_NUMBER(order) < 0;
+    if (IS_BOOL(order))
+        return AS_BOOL(order);
+
+    runtime_error(vm, "A comparator returns a number or a bool.");
+    cmp->failed = true;
     return false;
 }
 
 
+/* replaces the ropes in the array by their strings, so that their characters can be compared */
+static void flatten_elems(VM_t* vm, ObjArray_t* array)
+{
+    if (ELEMS_NUMBERS == array->kind)
+        return;
+    for (size_t i = 0; i < array->size; i++)
+    {
+        if (IS_ROPE(array->as.vals[i]))
+            ObjArr_Set(vm, array, i, OBJ_VAL(ObjRope_Flatten(vm, AS_ROPE(array->as.vals[i]))));
+    }
+}
+
+
+/* a slice's bound clamped to [0, size] */
+static size_t slice_bound(Value_t bound, size_t size)
+{
+    double n = IS_INT(bound)? (double)AS_INT(bound) : AS_NUMBER(bound);
+    if (!(n > 0))
+        return 0;
+    if (n >= (double)size)
+        return size;
+    return (size_t)n;
+}
+
+
+
+/* replaces the map and the key on top of the stack by the key's value, nil if the map does not have it */
+static void map_get(VM_t* vm)
+{
+    flatten(vm, 0);
+
+    Value_t val;
+    if (!Map_Get(&AS_MAP(peek(vm, 1))->map, peek(vm, 0), &val))
+    {
+        val = NIL_VAL();
+    }
+    vm->sp -= 1;
+    vm->sp[-1] = val;
+}
+
+
+/* replaces the map, the key and the value on top of the stack by the value, once it is set */
+static void map_set(VM_t* vm)
+{
+    flatten(vm, 1);
+
+    Value_t val = peek(vm, 0);
+    Map_Set(&AS_MAP(peek(vm, 2))->map, peek(vm, 1), val);
+    vm->sp -= 2;
+    vm->sp[-1] = val;
+}
+
+
+static bool map_has(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    flatten(vm, 0);
+    Value_t val;
+    *ret = BOOL_VAL(Map_Get(&AS_MAP(args[0])->map, args[1], &val));
+    return true;
+}
+
+
+static bool map_delete(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    flatten(vm, 0);
+    *ret = BOOL_VAL(Map_Delete(&AS_MAP(args[0])->map, args[1]));
+    return true;
+}
+
+
+static bool map_keys(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    *ret = OBJ_VAL(map_key_array(vm, &AS_MAP(args[0])->map));
+    return true;
+}
+
+
+static bool map_size(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)vm, (void)argc;
+    *ret = Value_FromInt(AS_MAP(args[0])->map.count);
+    return true;
+}
+
+
+/* the map is kept where the gc sees it by the caller */
+static ObjArray_t* map_key_array(VM_t* vm, const Map_t* map)
+{
+    ObjArray_t* keys = ObjArr_Create(vm);
+    VM_Push(vm, OBJ_VAL(keys));
+    ObjArr_Reserve(vm, keys, map->count);
+    for (size_t i = 0; i < map->capacity; i++)
+    {
+        if (Map_IsFull(map, i))
+            ObjArr_Push(vm, keys, map->keys[i]);
+    }
+    VM_Pop(vm);
+    return keys;
+}
+
+
+
+
+static bool deque_push_front(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    ObjDeque_PushFront(vm, AS_DEQUE(args[0]), args[1]);
+    *ret = args[1];
+    return true;
+}
+
+
+static bool deque_push_back(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    ObjDeque_PushBack(vm, AS_DEQUE(args[0]), args[1]);
+    *ret = args[1];
+    return true;
+}
+
+
+static bool deque_pop_front(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)vm, (void)argc;
+    *ret = ObjDeque_PopFront(AS_DEQUE(args[0]));
+    return true;
+}
+
+
+static bool deque_pop_back(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)vm, (void)argc;
+    *ret = ObjDeque_PopBack(AS_DEQUE(args[0]));
+    return true;
+}
+
+
+static bool deque_front(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)vm, (void)argc;
+    const ObjDeque_t* deque = AS_DEQUE(args[0]);
+    *ret = 0 == deque->count? NIL_VAL() : ObjDeque_Get(deque, 0);
+    return true;
+}
+
+
+static bool deque_back(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)vm, (void)argc;
+    const ObjDeque_t* deque = AS_DEQUE(args[0]);
+    *ret = 0 == deque->count? NIL_VAL() : ObjDeque_Get(deque, deque->count - 1);
+    return true;
+}
+
+
+static bool deque_size(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)vm, (void)argc;
+    *ret = Value_FromInt(AS_DEQUE(args[0])->count);
+    return true;
+}
+
+
+
+
+/* 
+ *  push(val, key) onto a queue ordered by number keys, push(val) onto one with a comparator,
+ *  which is called the same way as sort's and must not push onto or pop from the queue itself
+ */
+static bool pqueue_push(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    ObjPQueue_t* pq = AS_PQUEUE(args[0]);
+    const bool keyed = IS_NIL(pq->cmp);
+    if (argc != (keyed? 2 : 1))
+    {
+        runtime_error(vm, "Expected %d arguments to push, got %d instead.", keyed? 2 : 1, argc);
+        return false;
+    }
+    if (keyed && !IS_NUMBER(args[2]))
+    {
+        runtime_error(vm, "A priority queue's keys must be numbers.");
+        return false;
+    }
+    if (pq->busy)
+    {
+        runtime_error(vm, "Can not push onto a priority queue from its comparator.");
+        return false;
+    }
+
+    *ret = args[1];
+    if (keyed)
+    {
+        ObjPQueue_Push(vm, pq, args[1], AS_NUMBER(args[2]), NULL, NULL);
+        return true;
+    }
+
+    SortCmp_t cmp = { .vm = vm, .cmp = pq->cmp, .failed = false };
+    pq->busy = true;
+    ObjPQueue_Push(vm, pq, args[1], 0, sort_cmp_less, &cmp);
+    pq->busy = false;
+    return !cmp.failed;
+}
+
+
+static bool pqueue_pop(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    ObjPQueue_t* pq = AS_PQUEUE(args[0]);
+    if (pq->busy)
+    {
+        runtime_error(vm, "Can not pop from a priority queue from its comparator.");
+        return false;
+    }
+    if (0 == pq->count)
+    {
+        *ret = NIL_VAL();
+        return true;
+    }
+
+    *ret = pq->entries[0].val;
+    if (IS_NIL(pq->cmp))
+    {
+        ObjPQueue_Pop(pq, NULL, NULL);
+        return true;
+    }
+
+    /* the value that is out of the queue stays on the stack while the comparator runs */
+    SortCmp_t cmp = { .vm = vm, .cmp = pq->cmp, .failed = false };
+    VM_Push(vm, *ret);
+    pq->busy = true;
+    ObjPQueue_Pop(pq, sort_cmp_less, &cmp);
+    pq->busy = false;
+    if (cmp.failed) /* the error reset the stack */
+        return false;
+    VM_Pop(vm);
+    return true;
+}
+
+
+static bool pqueue_peek(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)vm, (void)argc;
+    const ObjPQueue_t* pq = AS_PQUEUE(args[0]);
+    *ret = 0 == pq->count? NIL_VAL() : pq->entries[0].val;
+    return true;
+}
+
+
+static bool pqueue_size(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)vm, (void)argc;
+    *ret = Value_FromInt(AS_PQUEUE(args[0])->count);
+    return true;
+}
+
+
+
+
+/* a set's elements are the keys of its map, they are compared the same way */
+static bool set_add(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    flatten(vm, 0);
+    *ret = BOOL_VAL(Map_Set(&AS_SET(args[0])->map, args[1], NIL_VAL()));
+    return true;
+}
+
+
+static bool set_has(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    flatten(vm, 0);
+    Value_t val;
+    *ret = BOOL_VAL(Map_Get(&AS_SET(args[0])->map, args[1], &val));
+    return true;
+}
+
+
+static bool set_delete(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    flatten(vm, 0);
+    *ret = BOOL_VAL(Map_Delete(&AS_SET(args[0])->map, args[1]));
+    return true;
+}
+
+
+static bool set_size(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)vm, (void)argc;
+    *ret = Value_FromInt(AS_SET(args[0])->map.count);
+    return true;
+}
+
+
+static bool set_values(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    *ret = OBJ_VAL(map_key_array(vm, &AS_SET(args[0])->map));
+    return true;
+}
+
+
+
+
+static bool typed_index(VM_t* vm, const ObjTypedArr_t* arr, Value_t index, int* index_out)
+{
+    if (!IS_NUMBER(index))
+    {
+        runtime_error(vm, "Indexing value is not a number.");
+        return false;
+    }
+
+    /* a negative int wraps around to an index that is out of bound */
+    uint64_t i = IS_INT(index)? (uint64_t)(int64_t)AS_INT(index) : (uint64_t)AS_NUMBER(index);
+    if (i >= (uint64_t)arr->len)
+    {
+        runtime_error(vm, 
+            "Index out of bound: %"PRIu64" >= array size: %d elements.", 
+            i, arr->len
+        );
+        return false;
+    }
+
+    *index_out = (int)i;
+    return true;
+}
+
+
+/* replaces the typed array and the index on top of the stack by the element */
+static bool typed_get(VM_t* vm)
+{
+    const ObjTypedArr_t* arr = AS_TYPED_ARRAY(peek(vm, 1));
+    int i;
+    if (!typed_index(vm, arr, peek(vm, 0), &i))
+        return false;
+
+    vm->sp -= 1;
+    vm->sp[-1] = TypedArr_Get(arr, i);
+    return true;
+}
+
+
+/* replaces the typed array, the index and the number on top of the stack by the number, once it is set */
+static bool typed_set(VM_t* vm)
+{
+    ObjTypedArr_t* arr = AS_TYPED_ARRAY(peek(vm, 2));
+    Value_t val = peek(vm, 0);
+    int i;
+    if (!typed_index(vm, arr, peek(vm, 1), &i))
+        return false;
+    if (!IS_NUMBER(val))
+    {
+        runtime_error(vm, "Only numbers can be stored in a typed array.");
+        return false;
+    }
+
+    TypedArr_Set(arr, i, AS_NUMBER(val));
+    vm->sp -= 2;
+    vm->sp[-1] = val;
+    return true;
+}
+
+
+/* a typed array's size is fixed, it only has size() */
+static bool typed_size(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)vm, (void)argc;
+    *ret = INT_VAL(AS_TYPED_ARRAY(args[0])->len);
+    return true;
+}
+
+
+
+
+static bool pvec_index(VM_t* vm, const ObjPVec_t* vec, Value_t index, size_t* index_out)
+{
+    if (!IS_NUMBER(index))
+    {
+        runtime_error(vm, "Indexing value is not a number.");
+        return false;
+    }
+
+    /* a negative int wraps around to an index that is out of bound */
+    uint64_t i = IS_INT(index)? (uint64_t)(int64_t)AS_INT(index) : (uint64_t)AS_NUMBER(index);
+    if (i >= vec->count)
+    {
+        runtime_error(vm, 
+            "Index out of bound: %"PRIu64" >= vector size: %"PRIu64" elements.", 
+            i, (uint64_t)vec->count
+        );
+        return false;
+    }
+
+    *index_out = i;
+    return true;
+}
+
+
+/* replaces the vector and the index on top of the stack by the element */
+static bool pvec_get(VM_t* vm)
+{
+    const ObjPVec_t* vec = AS_PVEC(peek(vm, 1));
+    size_t i;
+    if (!pvec_index(vm, vec, peek(vm, 0), &i))
+        return false;
+
+    vm->sp -= 1;
+    vm->sp[-1] = PVec_Get(vec, i);
+    return true;
+}
+
+
+/* the updates give a new vector, the one they are called on stays as it was */
+static bool pvec_set(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    ObjPVec_t* vec = AS_PVEC(args[0]);
+    size_t i;
+    if (!pvec_index(vm, vec, args[1], &i))
+        return false;
+    *ret = OBJ_VAL(PVec_Set(vm, vec, i, args[2]));
+    return true;
+}
+
+
+static bool pvec_push(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    *ret = OBJ_VAL(PVec_Push(vm, AS_PVEC(args[0]), args[1]));
+    return true;
+}
+
+
+/* the last element is v[v.size() - 1], an empty vector pops to itself */
+static bool pvec_pop(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    ObjPVec_t* vec = AS_PVEC(args[0]);
+    *ret = 0 == vec->count ? args[0] : OBJ_VAL(PVec_Pop(vm, vec));
+    return true;
+}
+
+
+static bool pvec_size(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)vm, (void)argc;
+    *ret = Value_FromInt(AS_PVEC(args[0])->count);
+    return true;
+}
+
+
+static bool pvec_to_array(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    const ObjPVec_t* vec = AS_PVEC(args[0]);
+    ObjArray_t* array = ObjArr_Create(vm);
+    VM_Push(vm, OBJ_VAL(array));
+    ObjArr_Reserve(vm, array, vec->count);
+    for (size_t i = 0; i < vec->count; i++)
+    {
+        ObjArr_Push(vm, array, PVec_Get(vec, i));
+    }
+    VM_Pop(vm);
+    *ret = OBJ_VAL(array);
+    return true;
+}
+
+
+
+
+/* flattens the key at offset on the stack, which must be one that a persistent map can have */
+static bool pmap_key(VM_t* vm, int offset)
+{
+    flatten(vm, offset);
+    if (!PMap_IsKey(peek(vm, offset)))
+    {
+        runtime_error(vm, "A persistent map's keys are numbers, strings, bools or nil.");
+        return false;
+    }
+    return true;
+}
+
+
+/* replaces the map and the key on top of the stack by the key's value, nil if the map does not have it */
+static bool pmap_get(VM_t* vm)
+{
+    if (!pmap_key(vm, 0))
+        return false;
+
+    Value_t val;
+    if (!PMap_Get(vm, AS_PMAP(peek(vm, 1)), peek(vm, 0), &val))
+    {
+        val = NIL_VAL();
+    }
+    vm->sp -= 1;
+    vm->sp[-1] = val;
+    return true;
+}
+
+
+static bool pmap_set(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    if (!pmap_key(vm, 1))
+        return false;
+    *ret = OBJ_VAL(PMap_Set(vm, AS_PMAP(args[0]), args[1], args[2]));
+    return true;
+}
+
+
+static bool pmap_delete(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    if (!pmap_key(vm, 0))
+        return false;
+    *ret = OBJ_VAL(PMap_Delete(vm, AS_PMAP(args[0]), args[1]));
+    return true;
+}
+
+
+static bool pmap_has(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    if (!pmap_key(vm, 0))
+        return false;
+    Value_t val;
+    *ret = BOOL_VAL(PMap_Get(vm, AS_PMAP(args[0]), args[1], &val));
+    return true;
+}
+
+
+static bool pmap_size(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)vm, (void)argc;
+    *ret = Value_FromInt(AS_PMAP(args[0])->count);
+    return true;
+}
+
+
+static bool pmap_keys(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    const ObjPMap_t* map = AS_PMAP(args[0]);
+    KeyPusher_t pusher = { .vm = vm, .keys = ObjArr_Create(vm) };
+    VM_Push(vm, OBJ_VAL(pusher.keys));
+    ObjArr_Reserve(vm, pusher.keys, map->count);
+    PMap_Each(map, push_key, &pusher);
+    VM_Pop(vm);
+    *ret = OBJ_VAL(pusher.keys);
+    return true;
+}
+
+
+static void push_key(void* ctx, Value_t key, Value_t val)
+{
+    (void)val;
+    KeyPusher_t* pusher = ctx;
+    ObjArr_Push(pusher->vm, pusher->keys, key);
+}
+
+
+
+/* the methods of strings, slices and ropes, most of them are the natives of the same name */
+static bool str_len(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    (void)argc;
+    flatten(vm, 0);
+    *ret = Value_FromInt(ObjStr_View(AS_OBJ(args[0])).len);
+    return true;
+}
+
+
+static bool str_substr(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    *ret = Native_Substr(vm, argc + 1, args);
+    return true;
+}
+
+
+static bool str_char_at(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    *ret = Native_CharAt(vm, argc + 1, args);
+    return true;
+}
+
+
+static bool str_index_of(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    *ret = Native_IndexOf(vm, argc + 1, args);
+    return true;
+}
+
+
+static bool str_split(VM_t* vm, int argc, Value_t* args, Value_t* ret)
+{
+    *ret = Native_Split(vm, argc + 1, args);
+    return true;
+}